@@ -0,0 +1,35 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.cpp
+//
+// Identification: src/buffer/buffer_access_strategy.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_access_strategy.h"
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+BufferAccessStrategy::BufferAccessStrategy(BufferPoolManager *bpm, size_t ring_size)
+    : bpm_(bpm), ring_size_(ring_size) {
+  BUSTUB_ASSERT(ring_size > 0, "ring of a buffer access strategy cannot be empty");
+}
+
+void BufferAccessStrategy::RecordLoad(page_id_t page_id) {
+  ring_.push_back(page_id);
+  // 环满了就把最老的页面扔出缓冲池，它的帧回到freelist供下一次缺页使用
+  // 还被pin住或者已经变脏的页面说明有别人在用，留在共享缓冲池中，只是不再归这个环管
+  while (ring_.size() > ring_size_) {
+    bpm_->DiscardPage(ring_.front());
+    ring_.pop_front();
+  }
+}
+
+}  // namespace bustub
@@ -12,41 +12,159 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/logger.h"
 #include "common/macros.h"
 
 namespace bustub {
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager)
-    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager) {}
+                                                     LogManager *log_manager, ReplacerType replacer_type,
+                                                     int numa_node, size_t max_pool_size)
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager, replacer_type, numa_node, max_pool_size) {
+}
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                                                     DiskManager *disk_manager, LogManager *log_manager)
+                                                     DiskManager *disk_manager, LogManager *log_manager,
+                                                     ReplacerType replacer_type, int numa_node,
+                                                     size_t max_pool_size)
     : pool_size_(pool_size),
+      max_pool_size_(std::max(pool_size, max_pool_size)),
       num_instances_(num_instances),
       instance_index_(instance_index),
       next_page_id_(static_cast<page_id_t>(instance_index)),
+      frames_(max_pool_size_, numa_node),
       disk_manager_(disk_manager),
       log_manager_(log_manager) {
   BUSTUB_ASSERT(num_instances > 0, "If BPI is not part of a pool, then the pool size should just be 1");
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
+  // 重启后从文件中已有的页之后开始分配，否则会和空闲页表中记下的页重复
+  page_id_t num_allocated_pages = disk_manager_->GetNumAllocatedPages();
+  next_page_id_ = num_allocated_pages + static_cast<page_id_t>((instance_index + num_instances -
+                                                                num_allocated_pages % num_instances) % num_instances);
   // We allocate a consecutive memory space for the buffer pool.
-  pages_ = new Page[pool_size_];
-  replacer_ = new LRUReplacer(pool_size);
+  // 页面的元数据和数据分开存放，数据在frames_中，已经清零
+  // 元数据按最大容量分配，扩容时不需要移动已经交给调用者的Page
+  pages_ = new Page[max_pool_size_];
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    pages_[i].data_ = frames_.GetFrameData(static_cast<frame_id_t>(i));
+  }
+  switch (replacer_type) {
+    case ReplacerType::LRU:
+      replacer_ = new LRUReplacer(max_pool_size_);
+      break;
+    case ReplacerType::LRU_K:
+      replacer_ = new LRUKReplacer(max_pool_size_);
+      break;
+    case ReplacerType::CLOCK:
+      replacer_ = new ClockReplacer(max_pool_size_);
+      break;
+  }
 
   // Initially, every page is in the free list.
-  for (size_t i = 0; i < pool_size_; ++i) {
+  for (size_t i = 0; i < pool_size; ++i) {
     free_list_.emplace_back(static_cast<int>(i));
   }
+  // 超出当前容量的帧先退役，扩容时再放进freelist
+  frame_retired_.resize(max_pool_size_, false);
+  for (size_t i = pool_size; i < max_pool_size_; ++i) {
+    frame_retired_[i] = true;
+  }
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
+  StopBackgroundFlushThread();
+  StopPrefetchThread();
+  // 后台写回完成时会回调本对象，等它们都结束
+  while (num_inflight_writebacks_ > 0) {
+    std::this_thread::yield();
+  }
   delete[] pages_;
   delete replacer_;
 }
 
+bool BufferPoolManagerInstance::Resize(size_t pool_size) {
+  std::scoped_lock resize_lock{resize_latch_};
+  if (pool_size == 0 || pool_size > max_pool_size_) {
+    return false;
+  }
+  size_t old_pool_size = pool_size_;
+  if (pool_size >= old_pool_size) {
+    // 扩容：把新的帧放进freelist就可以用了，内存在第一次访问时才真正分配
+    auto free_list_lock = LockFreeList();
+    pool_size_ = pool_size;
+    for (size_t i = old_pool_size; i < pool_size; ++i) {
+      frame_retired_[i] = false;
+      free_list_.emplace_back(static_cast<frame_id_t>(i));
+    }
+    return true;
+  }
+
+  // 缩容：先降低容量，此后被释放或者被换出的超出容量的帧都会直接退役，不再使用
+  {
+    auto free_list_lock = LockFreeList();
+    pool_size_ = pool_size;
+  }
+  auto deadline = std::chrono::steady_clock::now() + resize_timeout;
+  while (true) {
+    // freelist中的帧直接退役
+    {
+      auto free_list_lock = LockFreeList();
+      free_list_.remove_if([this](frame_id_t frame_id) { return RetireFrameIfRemoved(frame_id); });
+    }
+    // 仍然装着页面的帧主动换出，脏页会先写回。被pin住的要等用完了才能换出
+    size_t num_busy = 0;
+    for (size_t i = pool_size; i < old_pool_size; ++i) {
+      auto frame_id = static_cast<frame_id_t>(i);
+      {
+        auto free_list_lock = LockFreeList();
+        if (frame_retired_[i]) {
+          continue;
+        }
+      }
+      if (EvictFrame(frame_id)) {
+        auto free_list_lock = LockFreeList();
+        frame_retired_[i] = true;
+      } else {
+        num_busy++;
+      }
+    }
+    if (num_busy == 0) {
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      // 等不到被pin住的页面释放，撤销缩容：恢复容量，已经退役的帧还没有释放内存，放回freelist即可
+      auto free_list_lock = LockFreeList();
+      pool_size_ = old_pool_size;
+      for (size_t i = pool_size; i < old_pool_size; ++i) {
+        if (frame_retired_[i]) {
+          frame_retired_[i] = false;
+          free_list_.emplace_back(static_cast<frame_id_t>(i));
+        }
+      }
+      LOG_WARN("Resize: %zu pinned frames were not released in time, the pool keeps %zu frames", num_busy,
+               old_pool_size);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // 退役的帧不会再被访问，把内存还给操作系统
+  frames_.ReleaseFrames(static_cast<frame_id_t>(pool_size), old_pool_size - pool_size);
+  return true;
+}
+
 /**
  * Flushes the target page to disk.
  * 刷新目标页到磁盘
@@ -55,20 +173,34 @@ BufferPoolManagerInstance::~BufferPoolManagerInstance() {
  */
 bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
-  std::scoped_lock lock{latch_};
   if (page_id == INVALID_PAGE_ID) {
     return false;
   }
-  auto iter = page_table_.find(page_id);
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  auto iter = shard.page_table_.find(page_id);
   // 如果page不在页表中
-  if (iter == page_table_.end()) {
+  if (iter == shard.page_table_.end()) {
     return false;
   }
-  // 在页表中找到frameid，然后根据他获取Page对象
+  // 只读映射的数据库文件写不了，页面也只能是从文件里借来的，没有什么要写回的
+  if (disk_manager_->GetBackend() == DiskIOBackend::MMAP) {
+    return true;
+  }
+  // 先pin住该页防止写盘期间被换出，然后放锁写盘
   frame_id_t frame_id = iter->second;
-  Page *page = &pages_[frame_id];
+  Page *page = PinResidentPage(&shard, &lock, frame_id);
+  // 等待的读盘失败了，页面已经不在缓冲池中
+  if (page == nullptr) {
+    return false;
+  }
+  page->is_dirty_ = false;  // 刷新之后重置dirty状态，写盘期间再被修改的话会重新置为dirty
+  lock.unlock();
   disk_manager_->WritePage(page_id, page->GetData());
-  page->is_dirty_ = false;  // 刷新之后重置dirty状态
+  lock.lock();
+  if (--page->pin_count_ == 0) {
+    replacer_->Unpin(frame_id);
+  }
   return true;
 }
 
@@ -78,14 +210,59 @@ bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
  */
 void BufferPoolManagerInstance::FlushAllPgsImp() {
   // You can do it!
-  std::scoped_lock lock{latch_};
-  auto iter = page_table_.begin();
-  while (iter != page_table_.end()) {
-    page_id_t page_id = iter->first;
-    frame_id_t frame_id = iter->second;
-    Page *page = &pages_[frame_id];
-    disk_manager_->WritePage(page_id, page->GetData());
-    iter++;
+  // 只读映射的数据库文件写不了，和FlushPgImp一样什么都不做
+  if (disk_manager_->GetBackend() == DiskIOBackend::MMAP) {
+    return;
+  }
+  // 先拷贝出所有页面，顺便收集还没写完的换出写回，写盘时不持有shard的锁
+  std::vector<std::pair<page_id_t, frame_id_t>> resident;
+  std::vector<std::shared_future<void>> writebacks;
+  for (PageTableShard &shard : page_table_) {
+    auto lock = LockShard(&shard);
+    for (const auto &entry : shard.page_table_) {
+      resident.emplace_back(entry);
+    }
+    for (const auto &entry : shard.writebacks_) {
+      writebacks.push_back(entry.second);
+    }
+  }
+  for (auto &writeback : writebacks) {
+    writeback.wait();
+  }
+
+  // 按page id排序后分批写，每批合并相邻的页面并只同步一次；分批是为了不会一次pin住整个缓冲池
+  std::sort(resident.begin(), resident.end());
+  for (size_t begin = 0; begin < resident.size(); begin += WRITE_BATCH_SIZE) {
+    size_t end = std::min(resident.size(), begin + WRITE_BATCH_SIZE);
+    std::vector<std::pair<page_id_t, frame_id_t>> batch;
+    for (size_t i = begin; i < end; i++) {
+      auto [page_id, frame_id] = resident[i];
+      PageTableShard &shard = GetShard(page_id);
+      auto lock = LockShard(&shard);
+      auto iter = shard.page_table_.find(page_id);
+      // 拷贝之后被换出或者还在读盘的页面跳过，后者和磁盘上的内容一样；干净的页面也和磁盘上一样，不用写
+      if (iter == shard.page_table_.end() || iter->second != frame_id || shard.io_pending_.count(frame_id) > 0 ||
+          !pages_[frame_id].is_dirty_) {
+        continue;
+      }
+      // 和CleanFrame一样只增加pin count，不改变该帧在replacer中的位置
+      pages_[frame_id].pin_count_++;
+      pages_[frame_id].is_dirty_ = false;
+      batch.emplace_back(page_id, frame_id);
+    }
+    std::vector<std::pair<page_id_t, const char *>> writes;
+    writes.reserve(batch.size());
+    for (auto [page_id, frame_id] : batch) {
+      writes.emplace_back(page_id, pages_[frame_id].GetData());
+    }
+    disk_manager_->WritePages(std::move(writes));
+    for (auto [page_id, frame_id] : batch) {
+      PageTableShard &shard = GetShard(page_id);
+      auto lock = LockShard(&shard);
+      if (--pages_[frame_id].pin_count_ == 0) {
+        replacer_->Unpin(frame_id);
+      }
+    }
   }
 }
 
@@ -101,37 +278,23 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
   // 3.   Update P's metadata, zero out memory and add P to the page table.
   // 4.   Set the page ID output parameter. Return a pointer to P.
-  std::scoped_lock lock{latch_};
   // 优先从freelist里获取空页，没有就去replacer中找一个，如果都找不到就返回nullptr
   frame_id_t frame_id = -1;
-  Page *page = nullptr;
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    page = &pages_[frame_id];
-  } else if (replacer_->Victim(&frame_id)) {
-    page = &pages_[frame_id];
-    // 从replacer中找到的页面要从pagetable中先删除
-    if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
-    }
-    page_table_.erase(page->GetPageId());
-  } else {
+  if (!AcquireFrame(&frame_id)) {
     return nullptr;
   }
 
-  // 重置状态，清空内存
   page_id_t new_page_id = AllocatePage();
-  page->page_id_ = new_page_id;
-  page->pin_count_ = 1;
-  page->is_dirty_ = false;
-  page->ResetMemory();
-
-  // 添加到pagetable，Pin该页面并返回数据
-  page_table_[new_page_id] = frame_id;
   *page_id = new_page_id;
-  replacer_->Pin(frame_id);
-  return page;
+  return InstallNewPage(frame_id, new_page_id);
+}
+
+Page *BufferPoolManagerInstance::NewPageWithId(page_id_t page_id) {
+  frame_id_t frame_id = -1;
+  if (!AcquireFrame(&frame_id)) {
+    return nullptr;
+  }
+  return InstallNewPage(frame_id, page_id);
 }
 
 /**
@@ -140,7 +303,16 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
  * @param page_id id of page to be fetched
  * @return the requested page
  */
-Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
+Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) { return FetchPgImp(page_id, nullptr); }
+
+/**
+ * Fetch the requested page from the buffer pool, reporting a read from disk to the access strategy.
+ * 从缓冲池中获取请求的页面，如果需要读盘则告知批量读取的环形缓冲区
+ * @param page_id id of page to be fetched
+ * @param strategy the ring of a bulk reader, may be nullptr
+ * @return the requested page
+ */
+Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
   // 1.     Search the page table for the requested page (P).
   // 1.1    If P exists, pin it and return it immediately.
   // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
@@ -148,45 +320,76 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  std::scoped_lock lock{latch_};
-  auto iter = page_table_.find(page_id);
-  // 如果存在，即Page在缓冲池中
-  if (iter != page_table_.end()) {
-    // 找到这个页面，Pin它并返回它
-    frame_id_t frame_id = iter->second;
-    Page *page = &pages_[frame_id];
-    page->pin_count_++;
-    replacer_->Pin(frame_id);
-    return page;
+  PageTableShard &shard = GetShard(page_id);
+  {
+    auto lock = LockShard(&shard);
+    auto iter = shard.page_table_.find(page_id);
+    // 如果存在，即Page在缓冲池中，Pin它并返回它
+    if (iter != shard.page_table_.end()) {
+      replacer_->RecordAccess(iter->second);
+      num_hits_++;
+      Page *page = PinResidentPage(&shard, &lock, iter->second);
+      if (page != nullptr) {
+        return page;
+      }
+      // 等待的读盘失败了，页面已经不在页表中，自己再读一次
+    }
   }
+
   // 不存在，即Page在磁盘中
   // 优先从freelist里获取空页，没有就去replacer中找一个，如果都找不到就返回nullptr
+  auto miss_start = std::chrono::steady_clock::now();
   frame_id_t frame_id = -1;
-  Page *page = nullptr;
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    page = &pages_[frame_id];
-  } else if (replacer_->Victim(&frame_id)) {
-    page = &pages_[frame_id];
-    // 从replacer中找到的页面要从pagetable中先删除
-    if (page->IsDirty()) {
-      disk_manager_->WritePage(page->GetPageId(), page->GetData());
-    }
-    page_table_.erase(page->GetPageId());
-  } else {
+  if (!AcquireFrame(&frame_id)) {
     return nullptr;
   }
+  Page *page = &pages_[frame_id];
+  {
+    auto lock = LockShard(&shard);
+    auto iter = shard.page_table_.find(page_id);
+    // 找空闲帧期间其他线程已经装载（或正在装载）了该页，把帧还回去，直接用它的
+    if (iter != shard.page_table_.end()) {
+      ReleaseFrame(frame_id);
+      replacer_->RecordAccess(iter->second);
+      num_hits_++;
+      Page *resident_page = PinResidentPage(&shard, &lock, iter->second);
+      if (resident_page != nullptr) {
+        return resident_page;
+      }
+      lock.unlock();
+      return FetchPgImp(page_id, strategy);
+    }
+    // 先占住页表中的位置并标记为正在读盘，同一页的其他Fetch会等待这次读取而不是再读一次
+    page->page_id_ = page_id;
+    page->pin_count_ = 1;
+    page->is_dirty_ = false;
+    shard.page_table_[page_id] = frame_id;
+    shard.io_pending_.insert(frame_id);
+    replacer_->RecordAccess(frame_id);
+    num_misses_++;
+  }
 
-  // 重置状态
-  page->page_id_ = page_id;
-  page->pin_count_ = 1;
-  page->is_dirty_ = false;
-  // 填充Page内容
-  disk_manager_->ReadPage(page_id, page->GetData());
-  // 添加到pagetable，Pin该页面并返回数据
-  page_table_[page_id] = frame_id;
-  replacer_->Pin(frame_id);
+  // 填充Page内容，读盘期间不持有任何锁
+  WaitForWriteBack(page_id);
+  if (!BorrowPageData(frame_id, page_id)) {
+    try {
+      disk_manager_->ReadPage(page_id, page->GetData());
+    } catch (...) {
+      // 校验和不对等读盘失败，撤销对页表的修改，否则等待读盘的Fetch永远醒不过来，帧也不会再被释放
+      AbortRead(page_id, frame_id);
+      throw;
+    }
+  }
+  {
+    auto lock = LockShard(&shard);
+    shard.io_pending_.erase(frame_id);
+  }
+  shard.io_done_.notify_all();
+  miss_latency_.Record(ElapsedNanos(miss_start));
+  // 不持有任何锁时再交给环形缓冲区，它可能会回调DiscardPage
+  if (strategy != nullptr) {
+    strategy->RecordLoad(page_id);
+  }
   return page;
 }
 
@@ -202,34 +405,33 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
   // 1.   If P does not exist, return true.
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
-  std::scoped_lock lock{latch_};
-  DeallocatePage(page_id);
-  auto iter = page_table_.find(page_id);
-  // 如果不存在，即Page在磁盘中，直接返回成功
-  if (iter == page_table_.end()) {
-    // DeallocatePage(page_id);
-    return true;
-  }
-  // 如果存在，即Page在缓冲池中
-  frame_id_t frame_id = iter->second;
-  Page *page = &pages_[frame_id];
-  // 如果PinCount不为0，则说明有人在用，返回失败
-  if (page->GetPinCount() > 0) {
-    return false;
-  }
-  // 清理，更新元数据，删除pagetable，返还至freelist
-  if (page->IsDirty()) {
-    disk_manager_->WritePage(page->GetPageId(), page->GetData());
+  PageTableShard &shard = GetShard(page_id);
+  {
+    auto lock = LockShard(&shard);
+    auto iter = shard.page_table_.find(page_id);
+    // 如果存在，即Page在缓冲池中；不存在则Page在磁盘中，直接释放
+    if (iter != shard.page_table_.end()) {
+      frame_id_t frame_id = iter->second;
+      Page *page = &pages_[frame_id];
+      // 如果PinCount不为0，则说明有人在用，返回失败
+      if (page->GetPinCount() > 0) {
+        return false;
+      }
+      // 清理，更新元数据，删除pagetable，返还至freelist
+      // 页面已被删除，内容不再需要，脏页也不用写回
+      replacer_->Remove(frame_id);
+      shard.page_table_.erase(iter);
+      page->is_dirty_ = false;
+      page->pin_count_ = 0;
+      page->page_id_ = INVALID_PAGE_ID;
+      page->data_ = frames_.GetFrameData(frame_id);
+      page->ResetMemory();
+      ReleaseFrame(frame_id);
+    }
   }
-  replacer_->Pin(frame_id);
-  page_table_.erase(page->page_id_);
-  page->is_dirty_ = false;
-  page->pin_count_ = 0;
-  page->page_id_ = INVALID_PAGE_ID;
-  page->ResetMemory();
-  free_list_.push_back(frame_id);
-  // DeallocatePage(page_id);
-  return true;
+  // 换出时还没写完的旧内容要先落盘，否则可能覆盖页面被重用后写入的内容
+  WaitForWriteBack(page_id);
+  return DeallocatePage(page_id);
 }
 
 /**
@@ -240,10 +442,452 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
  * @return false if the page pin count is <= 0 before this call, true otherwise
  */
 bool BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) {
-  std::scoped_lock lock{latch_};
-  auto iter = page_table_.find(page_id);
-  // 如果不存在，即Page在磁盘中，直接返回true
-  if (iter == page_table_.end()) {
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  return UnpinResidentPage(&shard, page_id, is_dirty);
+}
+
+/**
+ * Drop an unpinned, clean page from the buffer pool and return its frame to the free list.
+ * 把一个没有被pin住的干净页面立即移出缓冲池，帧还给freelist
+ * @param page_id id of page to be discarded
+ * @return false if the page is not resident, pinned or dirty, true otherwise
+ */
+bool BufferPoolManagerInstance::DiscardPgImp(page_id_t page_id) {
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  auto iter = shard.page_table_.find(page_id);
+  if (iter == shard.page_table_.end()) {
+    return false;
+  }
+  frame_id_t frame_id = iter->second;
+  Page *page = &pages_[frame_id];
+  // 有人在用或者被改过的页面留给replacer正常处理，这里不负责写盘
+  if (page->GetPinCount() > 0 || page->IsDirty()) {
+    return false;
+  }
+  replacer_->Remove(frame_id);
+  shard.page_table_.erase(iter);
+  page->page_id_ = INVALID_PAGE_ID;
+  num_evictions_++;
+  ReleaseFrame(frame_id);
+  return true;
+}
+
+/**
+ * Start reading a page into the buffer pool in the background.
+ * 在后台把一个页面读入缓冲池，不替调用者pin住它
+ * @param page_id id of page to be prefetched
+ * @param strategy the ring of a bulk reader the page is read for, may be nullptr
+ * @return false if no frame could be found for the page, true if it is resident or being read
+ */
+bool BufferPoolManagerInstance::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  PageTableShard &shard = GetShard(page_id);
+  {
+    auto lock = LockShard(&shard);
+    if (shard.page_table_.count(page_id) > 0) {
+      return true;
+    }
+  }
+
+  frame_id_t frame_id = -1;
+  if (!AcquireFrame(&frame_id)) {
+    return false;
+  }
+  Page *page = &pages_[frame_id];
+  {
+    auto lock = LockShard(&shard);
+    // 找空闲帧期间其他线程已经装载了该页，把帧还回去
+    if (shard.page_table_.count(page_id) > 0) {
+      ReleaseFrame(frame_id);
+      return true;
+    }
+    // 和FetchPgImp一样占住页表中的位置，读盘期间由预读线程持有这个pin
+    page->page_id_ = page_id;
+    page->pin_count_ = 1;
+    page->is_dirty_ = false;
+    shard.page_table_[page_id] = frame_id;
+    shard.io_pending_.insert(frame_id);
+    replacer_->RecordAccess(frame_id);
+    num_prefetches_++;
+  }
+
+  {
+    std::scoped_lock lock{prefetch_latch_};
+    if (prefetch_thread_ == nullptr) {
+      prefetch_thread_running_ = true;
+      prefetch_thread_ = new std::thread(&BufferPoolManagerInstance::BackgroundPrefetch, this);
+    }
+    prefetch_queue_.emplace_back(page_id, frame_id);
+  }
+  prefetch_cv_.notify_one();
+  if (strategy != nullptr) {
+    strategy->RecordLoad(page_id);
+  }
+  return true;
+}
+
+/**
+ * Pin the requested page only if it is resident and fully read.
+ * 只有页面已经在缓冲池中且读盘完成时才pin住并返回它，不会等待磁盘I/O
+ * @param page_id id of page to be fetched
+ * @return the requested page, nullptr if it is not resident or its read is still in flight
+ */
+Page *BufferPoolManagerInstance::FetchResidentPgImp(page_id_t page_id) {
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  auto iter = shard.page_table_.find(page_id);
+  if (iter == shard.page_table_.end() || shard.io_pending_.count(iter->second) > 0) {
+    return nullptr;
+  }
+  // 调用者只是顺便看一眼页面（比如预读时沿着链表找下一页），不算作一次访问
+  return PinResidentPage(&shard, &lock, iter->second);
+}
+
+/**
+ * Fetch several pages from the buffer pool.
+ * 批量获取页面：每个shard只加一次锁，缺页先全部占好位置再一起读盘
+ * @param page_ids ids of pages to be fetched
+ * @return the requested pages in the order of page_ids, nullptr for each page no frame could be found for
+ */
+std::vector<Page *> BufferPoolManagerInstance::FetchPgsImp(const std::vector<page_id_t> &page_ids) {
+  std::vector<Page *> pages(page_ids.size(), nullptr);
+  // 按shard分组。重复的page id只处理第一次出现的那个，其余的留到最后再单独Fetch
+  std::array<std::vector<size_t>, PAGE_TABLE_SHARD_NUM> shard_requests;
+  std::vector<size_t> deferred;
+  std::unordered_set<page_id_t> requested;
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    if (!requested.insert(page_ids[i]).second) {
+      deferred.push_back(i);
+      continue;
+    }
+    shard_requests[GetShardIndex(page_ids[i])].push_back(i);
+  }
+
+  // 1. 在缓冲池中的页面直接pin住，其余的记为缺页。此时自己还没有标记任何读盘中的帧，可以放心等待其他线程的读盘
+  std::vector<size_t> misses;
+  for (size_t shard_index = 0; shard_index < PAGE_TABLE_SHARD_NUM; shard_index++) {
+    if (shard_requests[shard_index].empty()) {
+      continue;
+    }
+    PageTableShard &shard = page_table_[shard_index];
+    auto lock = LockShard(&shard);
+    for (size_t i : shard_requests[shard_index]) {
+      auto iter = shard.page_table_.find(page_ids[i]);
+      if (iter != shard.page_table_.end()) {
+        replacer_->RecordAccess(iter->second);
+        num_hits_++;
+        pages[i] = PinResidentPage(&shard, &lock, iter->second);
+      }
+      // 等待的读盘失败时页面也不在页表中了，和缺页一样自己去读
+      if (pages[i] == nullptr) {
+        misses.push_back(i);
+      }
+    }
+  }
+
+  // 2. 为缺页找空闲帧，freelist只加一次锁，不够的再去replacer中换出。找不到帧的缺页返回nullptr
+  auto miss_start = std::chrono::steady_clock::now();
+  std::vector<frame_id_t> frame_ids;
+  {
+    auto free_list_lock = LockFreeList();
+    while (frame_ids.size() < misses.size() && !free_list_.empty()) {
+      frame_id_t free_frame_id = free_list_.front();
+      free_list_.pop_front();
+      if (!RetireFrameIfRemoved(free_frame_id)) {
+        frame_ids.push_back(free_frame_id);
+      }
+    }
+  }
+  frame_id_t frame_id = -1;
+  while (frame_ids.size() < misses.size() && AcquireFrame(&frame_id)) {
+    frame_ids.push_back(frame_id);
+  }
+  misses.resize(frame_ids.size());
+
+  // 3. 在页表中占住位置并标记为正在读盘。misses是按shard顺序排列的，每个shard同样只加一次锁
+  std::vector<std::pair<page_id_t, frame_id_t>> reads;
+  std::vector<frame_id_t> unused_frame_ids;
+  for (size_t begin = 0, end; begin < misses.size(); begin = end) {
+    size_t shard_index = GetShardIndex(page_ids[misses[begin]]);
+    end = begin;
+    while (end < misses.size() && GetShardIndex(page_ids[misses[end]]) == shard_index) {
+      end++;
+    }
+    PageTableShard &shard = page_table_[shard_index];
+    auto lock = LockShard(&shard);
+    for (size_t j = begin; j < end; j++) {
+      page_id_t page_id = page_ids[misses[j]];
+      // 找空闲帧期间其他线程装载了该页。它可能也在等我们标记的帧读完，这里不能等它，留到最后再Fetch
+      if (shard.page_table_.count(page_id) > 0) {
+        unused_frame_ids.push_back(frame_ids[j]);
+        deferred.push_back(misses[j]);
+        continue;
+      }
+      Page *page = &pages_[frame_ids[j]];
+      page->page_id_ = page_id;
+      page->pin_count_ = 1;
+      page->is_dirty_ = false;
+      shard.page_table_[page_id] = frame_ids[j];
+      shard.io_pending_.insert(frame_ids[j]);
+      replacer_->RecordAccess(frame_ids[j]);
+      num_misses_++;
+      pages[misses[j]] = page;
+      reads.emplace_back(page_id, frame_ids[j]);
+    }
+  }
+  for (frame_id_t unused_frame_id : unused_frame_ids) {
+    ReleaseFrame(unused_frame_id);
+  }
+
+  // 4. 按page id排序，连续的页面合并成一次读盘，读盘期间不持有任何锁
+  // 前面的各段交给I/O线程同时去读，最后一段在本线程读
+  std::sort(reads.begin(), reads.end());
+  std::vector<std::pair<page_id_t, frame_id_t>> disk_reads;
+  for (const auto &read : reads) {
+    WaitForWriteBack(read.first);
+    if (!BorrowPageData(read.second, read.first)) {
+      disk_reads.push_back(read);
+    }
+  }
+  std::vector<std::pair<size_t, size_t>> runs;
+  std::vector<std::future<void>> run_reads;
+  std::vector<std::exception_ptr> run_errors;
+  for (size_t begin = 0, end; begin < disk_reads.size(); begin = end) {
+    std::vector<char *> pages_data{pages_[disk_reads[begin].second].GetData()};
+    end = begin + 1;
+    while (end < disk_reads.size() && disk_reads[end].first == disk_reads[end - 1].first + 1) {
+      pages_data.push_back(pages_[disk_reads[end].second].GetData());
+      end++;
+    }
+    runs.emplace_back(begin, end);
+    run_errors.emplace_back(nullptr);
+    if (end < disk_reads.size()) {
+      run_reads.push_back(disk_manager_->ReadPagesAsync(disk_reads[begin].first, std::move(pages_data)));
+    } else {
+      try {
+        disk_manager_->ReadPages(disk_reads[begin].first, pages_data);
+      } catch (...) {
+        run_errors.back() = std::current_exception();
+      }
+    }
+  }
+  for (size_t r = 0; r < run_reads.size(); r++) {
+    try {
+      run_reads[r].get();
+    } catch (...) {
+      run_errors[r] = std::current_exception();
+    }
+  }
+  // 读盘失败的段整段撤销，和FetchPgImp一样
+  std::exception_ptr read_error;
+  std::unordered_set<page_id_t> failed_page_ids;
+  for (size_t r = 0; r < runs.size(); r++) {
+    if (run_errors[r] == nullptr) {
+      continue;
+    }
+    read_error = read_error == nullptr ? run_errors[r] : read_error;
+    for (size_t j = runs[r].first; j < runs[r].second; j++) {
+      failed_page_ids.insert(disk_reads[j].first);
+      AbortRead(disk_reads[j].first, disk_reads[j].second);
+    }
+  }
+  std::array<std::vector<frame_id_t>, PAGE_TABLE_SHARD_NUM> shard_reads;
+  for (const auto &[page_id, read_frame_id] : reads) {
+    if (failed_page_ids.count(page_id) == 0) {
+      shard_reads[GetShardIndex(page_id)].push_back(read_frame_id);
+    }
+  }
+  for (size_t shard_index = 0; shard_index < PAGE_TABLE_SHARD_NUM; shard_index++) {
+    if (shard_reads[shard_index].empty()) {
+      continue;
+    }
+    PageTableShard &shard = page_table_[shard_index];
+    {
+      auto lock = LockShard(&shard);
+      for (frame_id_t read_frame_id : shard_reads[shard_index]) {
+        shard.io_pending_.erase(read_frame_id);
+      }
+    }
+    shard.io_done_.notify_all();
+  }
+  // 整批一起读，每个缺页的延迟都算到整批读完为止
+  uint64_t miss_latency = ElapsedNanos(miss_start);
+  for (size_t i = 0; i < reads.size(); i++) {
+    miss_latency_.Record(miss_latency);
+  }
+  // 读盘失败时放掉这次pin住的其他页面，把异常交给调用者
+  auto unpin_pages = [this, &page_ids, &pages] {
+    for (size_t i = 0; i < page_ids.size(); i++) {
+      if (pages[i] != nullptr) {
+        UnpinPgImp(page_ids[i], false);
+      }
+    }
+  };
+  if (read_error != nullptr) {
+    for (size_t i = 0; i < page_ids.size(); i++) {
+      if (failed_page_ids.count(page_ids[i]) > 0) {
+        pages[i] = nullptr;
+      }
+    }
+    unpin_pages();
+    std::rethrow_exception(read_error);
+  }
+
+  // 5. 自己的读盘都完成了，再处理重复的和被其他线程抢先装载的页面
+  for (size_t i : deferred) {
+    try {
+      pages[i] = FetchPgImp(page_ids[i]);
+    } catch (...) {
+      unpin_pages();
+      throw;
+    }
+  }
+  return pages;
+}
+
+/**
+ * Unpin several pages from the buffer pool.
+ * 批量Unpin页面，每个shard只加一次锁
+ * @param pages (page id, is dirty) pairs of the pages to be unpinned
+ * @return false if the pin count of any of the pages is <= 0 before this call, true otherwise
+ */
+bool BufferPoolManagerInstance::UnpinPgsImp(const std::vector<std::pair<page_id_t, bool>> &pages) {
+  std::array<std::vector<size_t>, PAGE_TABLE_SHARD_NUM> shard_requests;
+  for (size_t i = 0; i < pages.size(); i++) {
+    shard_requests[GetShardIndex(pages[i].first)].push_back(i);
+  }
+  bool result = true;
+  for (size_t shard_index = 0; shard_index < PAGE_TABLE_SHARD_NUM; shard_index++) {
+    if (shard_requests[shard_index].empty()) {
+      continue;
+    }
+    PageTableShard &shard = page_table_[shard_index];
+    auto lock = LockShard(&shard);
+    for (size_t i : shard_requests[shard_index]) {
+      result = UnpinResidentPage(&shard, pages[i].first, pages[i].second) && result;
+    }
+  }
+  return result;
+}
+
+Page *BufferPoolManagerInstance::InstallNewPage(frame_id_t frame_id, page_id_t page_id) {
+  // 重置状态，清空内存。此时该帧只属于当前线程，不需要加锁
+  Page *page = &pages_[frame_id];
+  page->data_ = frames_.GetFrameData(frame_id);
+  page->ResetMemory();
+
+  // 添加到pagetable，Pin该页面并返回数据
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  page->page_id_ = page_id;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  shard.page_table_[page_id] = frame_id;
+  replacer_->RecordAccess(frame_id);
+  return page;
+}
+
+bool BufferPoolManagerInstance::BorrowPageData(frame_id_t frame_id, page_id_t page_id) {
+  // 只读映射的数据库文件不用复制，帧直接指向映射里的页面；否则帧用回自己的内存，它之前可能借用过别的页面
+  Page *page = &pages_[frame_id];
+  const char *borrowed = disk_manager_->BorrowPage(page_id);
+  page->data_ = borrowed != nullptr ? const_cast<char *>(borrowed) : frames_.GetFrameData(frame_id);  // NOLINT
+  return borrowed != nullptr;
+}
+
+BufferPoolManagerInstance::PageTableShard &BufferPoolManagerInstance::GetShard(page_id_t page_id) {
+  return page_table_[GetShardIndex(page_id)];
+}
+
+size_t BufferPoolManagerInstance::GetShardIndex(page_id_t page_id) const {
+  // 同一个BPI中的page id模num_instances_同余，先除掉再取模，否则并行BPM下所有页都会落到同一个shard
+  return (static_cast<size_t>(page_id) / num_instances_) % PAGE_TABLE_SHARD_NUM;
+}
+
+std::unique_lock<std::mutex> BufferPoolManagerInstance::LockShard(PageTableShard *shard) {
+  return LockLatch(&shard->latch_);
+}
+
+std::unique_lock<std::mutex> BufferPoolManagerInstance::LockFreeList() { return LockLatch(&latch_); }
+
+std::unique_lock<std::mutex> BufferPoolManagerInstance::LockLatch(std::mutex *latch) {
+  // 先试一下，拿不到锁说明和其他线程撞上了，记下来再阻塞等待。只有撞上时才计时，不撞的时候没有额外开销
+  std::unique_lock lock{*latch, std::try_to_lock};
+  if (!lock.owns_lock()) {
+    num_latch_contentions_++;
+    auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    latch_wait_ns_ += ElapsedNanos(start);
+  }
+  return lock;
+}
+
+uint64_t BufferPoolManagerInstance::ElapsedNanos(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+BufferPoolStats BufferPoolManagerInstance::GetStats() const {
+  BufferPoolStats stats;
+  stats.num_hits_ = num_hits_;
+  stats.num_misses_ = num_misses_;
+  stats.num_evictions_ = num_evictions_;
+  stats.num_foreground_writes_ = num_foreground_writes_;
+  stats.num_background_writes_ = num_background_writes_;
+  stats.num_prefetches_ = num_prefetches_;
+  stats.num_latch_contentions_ = num_latch_contentions_;
+  stats.latch_wait_ns_ = latch_wait_ns_;
+  stats.miss_latency_ = miss_latency_.GetSnapshot();
+  stats.victim_latency_ = victim_latency_.GetSnapshot();
+  return stats;
+}
+
+Page *BufferPoolManagerInstance::PinResidentPage(PageTableShard *shard, std::unique_lock<std::mutex> *lock,
+                                                 frame_id_t frame_id) {
+  Page *page = &pages_[frame_id];
+  page->pin_count_++;
+  replacer_->Pin(frame_id);
+  // 该页可能还在被其他线程从磁盘读入，等待读取完成
+  shard->io_done_.wait(*lock, [shard, frame_id] { return shard->io_pending_.count(frame_id) == 0; });
+  // 读盘失败，页面已经从页表中去掉了。我们的pin还挡着帧的释放，放掉它
+  if (page->page_id_ == INVALID_PAGE_ID) {
+    ReleaseAbortedPin(frame_id);
+    return nullptr;
+  }
+  return page;
+}
+
+void BufferPoolManagerInstance::AbortRead(page_id_t page_id, frame_id_t frame_id) {
+  PageTableShard &shard = GetShard(page_id);
+  {
+    auto lock = LockShard(&shard);
+    shard.page_table_.erase(page_id);
+    shard.io_pending_.erase(frame_id);
+    pages_[frame_id].page_id_ = INVALID_PAGE_ID;
+    ReleaseAbortedPin(frame_id);
+  }
+  shard.io_done_.notify_all();
+}
+
+void BufferPoolManagerInstance::ReleaseAbortedPin(frame_id_t frame_id) {
+  Page *page = &pages_[frame_id];
+  if (--page->pin_count_ > 0) {
+    return;
+  }
+  replacer_->Remove(frame_id);
+  page->is_dirty_ = false;
+  page->data_ = frames_.GetFrameData(frame_id);
+  page->ResetMemory();
+  ReleaseFrame(frame_id);
+}
+
+bool BufferPoolManagerInstance::UnpinResidentPage(PageTableShard *shard, page_id_t page_id, bool is_dirty) {
+  auto iter = shard->page_table_.find(page_id);
+  // 如果不存在，即Page在磁盘中，直接返回false
+  if (iter == shard->page_table_.end()) {
     return false;
   }
   // 如果存在，即Page在缓冲池中
@@ -262,10 +906,248 @@ bool BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) {
   return true;
 }
 
+void BufferPoolManagerInstance::ReleaseFrame(frame_id_t frame_id) {
+  auto free_list_lock = LockFreeList();
+  if (!RetireFrameIfRemoved(frame_id)) {
+    free_list_.push_back(frame_id);
+  }
+}
+
+bool BufferPoolManagerInstance::RetireFrameIfRemoved(frame_id_t frame_id) {
+  if (static_cast<size_t>(frame_id) < pool_size_) {
+    return false;
+  }
+  frame_retired_[frame_id] = true;
+  return true;
+}
+
+bool BufferPoolManagerInstance::AcquireFrame(frame_id_t *frame_id) {
+  {
+    auto free_list_lock = LockFreeList();
+    while (!free_list_.empty()) {
+      frame_id_t free_frame_id = free_list_.front();
+      free_list_.pop_front();
+      // 缩容时超出新容量的帧不再使用
+      if (!RetireFrameIfRemoved(free_frame_id)) {
+        *frame_id = free_frame_id;
+        return true;
+      }
+    }
+  }
+  // replacer给出的victim可能在加锁前又被pin住，换不出去就继续找下一个
+  auto start = std::chrono::steady_clock::now();
+  frame_id_t victim;
+  while (replacer_->Victim(&victim)) {
+    if (EvictFrame(victim)) {
+      {
+        auto free_list_lock = LockFreeList();
+        if (RetireFrameIfRemoved(victim)) {
+          continue;
+        }
+      }
+      *frame_id = victim;
+      victim_latency_.Record(ElapsedNanos(start));
+      return true;
+    }
+  }
+  victim_latency_.Record(ElapsedNanos(start));
+  return false;
+}
+
+bool BufferPoolManagerInstance::EvictFrame(frame_id_t frame_id) {
+  Page *page = &pages_[frame_id];
+  // 帧的page_id_只会被独占该帧的线程修改，这里不加锁读取，下面持有shard锁之后再校验
+  page_id_t page_id = page->page_id_;
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  auto iter = shard.page_table_.find(page_id);
+  if (iter == shard.page_table_.end() || iter->second != frame_id || page->pin_count_ > 0) {
+    return false;
+  }
+
+  if (page->IsDirty()) {
+    // 脏页复制一份交给I/O线程写回，帧马上就可以给调用者读入新页，写回和读盘重叠进行
+    // 写完之前该页的读盘要先等写回完成，见WaitForWriteBack
+    std::shared_ptr<char> data(static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, PAGE_SIZE)), std::free);
+    memcpy(data.get(), page->GetData(), PAGE_SIZE);
+    num_inflight_writebacks_++;
+    auto on_written = [this, &shard, page_id, data] {
+      // 要拿shard锁，所以一定在下面登记写回之后才会执行
+      {
+        auto lock = LockShard(&shard);
+        shard.writebacks_.erase(page_id);
+      }
+      num_inflight_writebacks_--;
+    };
+    shard.writebacks_[page_id] = disk_manager_->WritePageAsync(page_id, data.get(), on_written).share();
+    num_foreground_writes_++;
+    // 前台换出还得自己写盘，说明后台刷得不够快，叫醒它
+    flush_cv_.notify_one();
+  }
+
+  // 该帧可能在Victim之后被pin又unpin，重新回到了replacer中，这里要确保把它移除
+  replacer_->Remove(frame_id);
+  shard.page_table_.erase(page_id);
+  page->page_id_ = INVALID_PAGE_ID;
+  num_evictions_++;
+  return true;
+}
+
+void BufferPoolManagerInstance::WaitForWriteBack(page_id_t page_id) {
+  if (num_inflight_writebacks_ == 0) {
+    return;
+  }
+  std::shared_future<void> writeback;
+  {
+    PageTableShard &shard = GetShard(page_id);
+    auto lock = LockShard(&shard);
+    auto iter = shard.writebacks_.find(page_id);
+    if (iter == shard.writebacks_.end()) {
+      return;
+    }
+    writeback = iter->second;
+  }
+  writeback.wait();
+}
+
+bool BufferPoolManagerInstance::CleanFrame(frame_id_t frame_id) {
+  Page *page = &pages_[frame_id];
+  page_id_t page_id = page->page_id_;
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  PageTableShard &shard = GetShard(page_id);
+  auto lock = LockShard(&shard);
+  auto iter = shard.page_table_.find(page_id);
+  if (iter == shard.page_table_.end() || iter->second != frame_id || page->pin_count_ > 0 || !page->IsDirty()) {
+    return false;
+  }
+  // 只增加pin count而不调用replacer的Pin，这样写完之后该帧仍然留在replacer的尾部，能被优先换出
+  page->pin_count_++;
+  page->is_dirty_ = false;
+  lock.unlock();
+  disk_manager_->WritePage(page_id, page->GetData());
+  num_background_writes_++;
+  lock.lock();
+  // 写盘期间该帧可能被Victim取走后又放弃了，这时要重新放回replacer；仍在replacer中的话Unpin不会改变它的位置
+  if (--page->pin_count_ == 0) {
+    replacer_->Unpin(frame_id);
+  }
+  return true;
+}
+
+void BufferPoolManagerInstance::RunBackgroundFlushThread(double clean_ratio) {
+  std::scoped_lock lock{flush_latch_};
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  flush_clean_ratio_ = clean_ratio;
+  flush_thread_running_ = true;
+  flush_thread_ = new std::thread(&BufferPoolManagerInstance::BackgroundFlush, this);
+}
+
+void BufferPoolManagerInstance::StopBackgroundFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::scoped_lock lock{flush_latch_};
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    flush_thread_running_ = false;
+    flush_thread = flush_thread_;
+    flush_thread_ = nullptr;
+  }
+  flush_cv_.notify_all();
+  flush_thread->join();
+  delete flush_thread;
+}
+
+void BufferPoolManagerInstance::BackgroundFlush() {
+  FrameAllocator::BindThreadToNumaNode(frames_.GetNumaNode());
+  std::unique_lock lock{flush_latch_};
+  while (flush_thread_running_) {
+    flush_cv_.wait_for(lock, background_flush_interval);
+    if (!flush_thread_running_) {
+      break;
+    }
+    auto num_frames = static_cast<size_t>(flush_clean_ratio_ * static_cast<double>(pool_size_.load()));
+    lock.unlock();
+    // 把replacer尾部（即最先被换出的）num_frames个帧中的脏页写回
+    for (frame_id_t frame_id : replacer_->PeekVictims(num_frames)) {
+      CleanFrame(frame_id);
+    }
+    lock.lock();
+  }
+}
+
+void BufferPoolManagerInstance::StopPrefetchThread() {
+  std::thread *prefetch_thread;
+  {
+    std::scoped_lock lock{prefetch_latch_};
+    if (prefetch_thread_ == nullptr) {
+      return;
+    }
+    prefetch_thread_running_ = false;
+    prefetch_thread = prefetch_thread_;
+    prefetch_thread_ = nullptr;
+  }
+  prefetch_cv_.notify_all();
+  prefetch_thread->join();
+  delete prefetch_thread;
+}
+
+void BufferPoolManagerInstance::BackgroundPrefetch() {
+  FrameAllocator::BindThreadToNumaNode(frames_.GetNumaNode());
+  std::unique_lock lock{prefetch_latch_};
+  while (true) {
+    prefetch_cv_.wait(lock, [this] { return !prefetch_thread_running_ || !prefetch_queue_.empty(); });
+    // 队列里的帧都被pin住并且标记为正在读盘，必须读完才能退出，否则等待它们的Fetch永远醒不过来
+    if (prefetch_queue_.empty()) {
+      break;
+    }
+    auto [page_id, frame_id] = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+    lock.unlock();
+
+    Page *page = &pages_[frame_id];
+    WaitForWriteBack(page_id);
+    if (!BorrowPageData(frame_id, page_id)) {
+      try {
+        disk_manager_->ReadPage(page_id, page->GetData());
+      } catch (const Exception &e) {
+        // 预读失败不影响调用者，撤销之后真正Fetch时会再读一次，把异常交给它
+        LOG_WARN("prefetch of page %d failed: %s", page_id, e.what());
+        AbortRead(page_id, frame_id);
+        lock.lock();
+        continue;
+      }
+    }
+    PageTableShard &shard = GetShard(page_id);
+    {
+      auto shard_lock = LockShard(&shard);
+      shard.io_pending_.erase(frame_id);
+      if (--page->pin_count_ == 0) {
+        replacer_->Unpin(frame_id);
+      }
+    }
+    shard.io_done_.notify_all();
+    lock.lock();
+  }
+}
+
 page_id_t BufferPoolManagerInstance::AllocatePage() {
-  const page_id_t next_page_id = next_page_id_;
-  next_page_id_ += num_instances_;
+  // 先重用删除过的页面，没有才让文件增长
+  page_id_t free_page_id = disk_manager_->AllocateFreePage(num_instances_, instance_index_);
+  if (free_page_id != INVALID_PAGE_ID) {
+    ValidatePageId(free_page_id);
+    return free_page_id;
+  }
+  const page_id_t next_page_id = next_page_id_.fetch_add(num_instances_);
   ValidatePageId(next_page_id);
+  disk_manager_->MarkPageAllocated(next_page_id);
   return next_page_id;
 }
 
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.cpp
+//
+// Identification: src/buffer/buffer_pool_stats.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_stats.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace bustub {
+
+void LatencyHistogram::Record(uint64_t value) {
+  // 第i个桶放(2^(i-1), 2^i]，用前导零的个数算出桶号
+  size_t bucket = value <= 1 ? 0 : 64 - __builtin_clzll(value - 1);
+  bucket = std::min(bucket, NUM_BUCKETS - 1);
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+  Snapshot snapshot;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    snapshot.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  snapshot.count_ = count_.load(std::memory_order_relaxed);
+  snapshot.sum_ = sum_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+LatencyHistogram::Snapshot &LatencyHistogram::Snapshot::operator+=(const Snapshot &other) {
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  return *this;
+}
+
+double LatencyHistogram::Snapshot::Mean() const {
+  return count_ == 0 ? 0 : static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+uint64_t LatencyHistogram::Snapshot::Percentile(double percentile) const {
+  // 各个桶是分别读出来的，总数以桶为准而不是count_
+  uint64_t total = 0;
+  for (uint64_t bucket : buckets_) {
+    total += bucket;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(percentile / 100 * static_cast<double>(total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    seen += buckets_[i];
+    if (seen > rank || seen == total) {
+      return BucketUpperBound(i);
+    }
+  }
+  return BucketUpperBound(NUM_BUCKETS - 1);
+}
+
+BufferPoolStats &BufferPoolStats::operator+=(const BufferPoolStats &other) {
+  num_hits_ += other.num_hits_;
+  num_misses_ += other.num_misses_;
+  num_evictions_ += other.num_evictions_;
+  num_foreground_writes_ += other.num_foreground_writes_;
+  num_background_writes_ += other.num_background_writes_;
+  num_prefetches_ += other.num_prefetches_;
+  num_latch_contentions_ += other.num_latch_contentions_;
+  latch_wait_ns_ += other.latch_wait_ns_;
+  miss_latency_ += other.miss_latency_;
+  victim_latency_ += other.victim_latency_;
+  return *this;
+}
+
+double BufferPoolStats::HitRatio() const {
+  uint64_t num_fetches = num_hits_ + num_misses_;
+  return num_fetches == 0 ? 0 : static_cast<double>(num_hits_) / static_cast<double>(num_fetches);
+}
+
+namespace {
+
+void DumpCounter(std::ostringstream *out, const std::vector<BufferPoolStats> &stats, const std::string &name,
+                 const std::string &help, uint64_t BufferPoolStats::*counter) {
+  *out << "# HELP " << name << " " << help << "\n";
+  *out << "# TYPE " << name << " counter\n";
+  for (size_t i = 0; i < stats.size(); i++) {
+    *out << name << "{instance=\"" << i << "\"} " << stats[i].*counter << "\n";
+  }
+}
+
+void DumpHistogram(std::ostringstream *out, const std::vector<BufferPoolStats> &stats, const std::string &name,
+                   const std::string &help, LatencyHistogram::Snapshot BufferPoolStats::*histogram) {
+  *out << "# HELP " << name << " " << help << "\n";
+  *out << "# TYPE " << name << " histogram\n";
+  for (size_t i = 0; i < stats.size(); i++) {
+    const LatencyHistogram::Snapshot &snapshot = stats[i].*histogram;
+    // Prometheus的桶是累计的，最后一个桶同时装了更大的值，所以输出为+Inf
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket + 1 < LatencyHistogram::NUM_BUCKETS; bucket++) {
+      cumulative += snapshot.buckets_[bucket];
+      *out << name << "_bucket{instance=\"" << i << "\",le=\"" << LatencyHistogram::BucketUpperBound(bucket)
+           << "\"} " << cumulative << "\n";
+    }
+    cumulative += snapshot.buckets_[LatencyHistogram::NUM_BUCKETS - 1];
+    *out << name << "_bucket{instance=\"" << i << "\",le=\"+Inf\"} " << cumulative << "\n";
+    *out << name << "_sum{instance=\"" << i << "\"} " << snapshot.sum_ << "\n";
+    *out << name << "_count{instance=\"" << i << "\"} " << cumulative << "\n";
+  }
+}
+
+}  // namespace
+
+std::string DumpBufferPoolStats(const std::vector<BufferPoolStats> &stats) {
+  std::ostringstream out;
+  DumpCounter(&out, stats, "bustub_buffer_pool_hits_total", "Fetches that found their page resident.",
+              &BufferPoolStats::num_hits_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_misses_total", "Fetches that had to read their page from disk.",
+              &BufferPoolStats::num_misses_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_evictions_total", "Frames evicted to make room for another page.",
+              &BufferPoolStats::num_evictions_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_dirty_evictions_total",
+              "Dirty pages a foreground eviction had to write back itself.", &BufferPoolStats::num_foreground_writes_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_background_writes_total",
+              "Dirty pages written back by the background flush thread.", &BufferPoolStats::num_background_writes_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_prefetches_total", "Background reads issued by prefetches.",
+              &BufferPoolStats::num_prefetches_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_latch_contentions_total",
+              "Times a thread had to wait for a latch held by another thread.",
+              &BufferPoolStats::num_latch_contentions_);
+  DumpCounter(&out, stats, "bustub_buffer_pool_latch_wait_nanoseconds_total",
+              "Time spent waiting for latches held by other threads.", &BufferPoolStats::latch_wait_ns_);
+
+  out << "# HELP bustub_buffer_pool_hit_ratio Fraction of fetches that found their page resident.\n";
+  out << "# TYPE bustub_buffer_pool_hit_ratio gauge\n";
+  for (size_t i = 0; i < stats.size(); i++) {
+    out << "bustub_buffer_pool_hit_ratio{instance=\"" << i << "\"} " << stats[i].HitRatio() << "\n";
+  }
+
+  DumpHistogram(&out, stats, "bustub_buffer_pool_miss_latency_nanoseconds",
+                "Time from a fetch missing the pool until its page has been read.", &BufferPoolStats::miss_latency_);
+  DumpHistogram(&out, stats, "bustub_buffer_pool_victim_latency_nanoseconds",
+                "Time spent finding a victim frame when the free list is empty.", &BufferPoolStats::victim_latency_);
+  return out.str();
+}
+
+}  // namespace bustub
@@ -14,16 +14,89 @@
 
 namespace bustub {
 
-ClockReplacer::ClockReplacer(size_t num_pages) {}
+ClockReplacer::ClockReplacer(size_t num_pages) : num_pages_(num_pages), state_(num_pages), hand_(0), size_(0) {}
 
 ClockReplacer::~ClockReplacer() = default;
 
-bool ClockReplacer::Victim(frame_id_t *frame_id) { return false; }
+// 使用CLOCK策略删除一个victim frame
+// 指针扫过的帧如果引用位为1就清零并跳过，直到找到一个引用位为0的帧
+// @param[out] *frame_id 在指针中写入被删除的id
+// @return 如果删除成功返回true，否则返回false
+bool ClockReplacer::Victim(frame_id_t *frame_id) {
+  // 只有被pin过的帧才会重新置上引用位，所以每转两圈至少有一个帧会被选中，不会一直转下去
+  while (size_.load() > 0) {
+    size_t frame = AdvanceHand();
+    uint8_t state = state_[frame].load();
+    if ((state & IN_REPLACER) == 0) {
+      continue;
+    }
+    if ((state & REFERENCED) != 0) {
+      // 给它第二次机会。CAS失败说明期间被Pin/Unpin了，留给下一圈处理
+      state_[frame].compare_exchange_strong(state, IN_REPLACER);
+      continue;
+    }
+    // 用CAS抢占该帧，失败说明被其他线程Pin了或者被其他Victim抢走了
+    if (state_[frame].compare_exchange_strong(state, 0)) {
+      size_--;
+      *frame_id = static_cast<frame_id_t>(frame);
+      return true;
+    }
+  }
+  return false;
+}
 
-void ClockReplacer::Pin(frame_id_t frame_id) {}
+// 固定一个frame, 表明它不应该成为victim（即在replacer中移除该frame_id）
+// @param frame_id 被固定的ID
+void ClockReplacer::Pin(frame_id_t frame_id) {
+  uint8_t state = state_[frame_id].exchange(0);
+  if ((state & IN_REPLACER) != 0) {
+    size_--;
+  }
+}
 
-void ClockReplacer::Unpin(frame_id_t frame_id) {}
+// 取消固定一个frame，表明它可以成为victim，并置上引用位
+// @param frame_id 取消固定的ID
+void ClockReplacer::Unpin(frame_id_t frame_id) {
+  // 先加计数再置位：置位之后Victim随时可能抢走该帧并减计数，size_必须不小于能被抢占的帧数，
+  // 否则别的Victim会看到0而失败，Pin也可能把计数减到溢出。原来就在replacer中的话再减回去
+  size_++;
+  uint8_t state = state_[frame_id].fetch_or(IN_REPLACER | REFERENCED);
+  if ((state & IN_REPLACER) != 0) {
+    size_--;
+  }
+}
 
-size_t ClockReplacer::Size() { return 0; }
+// @return replacer中能够victim的数量
+size_t ClockReplacer::Size() { return size_.load(); }
+
+// 从当前指针位置开始看一圈，引用位为0的帧会在这一圈被换出，排在前面；其余的帧要等到下一圈
+std::vector<frame_id_t> ClockReplacer::PeekVictims(size_t max_frames) {
+  std::vector<frame_id_t> frames;
+  std::vector<frame_id_t> referenced_frames;
+  size_t hand = hand_.load();
+  for (size_t i = 0; i < num_pages_ && frames.size() < max_frames; i++) {
+    size_t frame = (hand + i) % num_pages_;
+    uint8_t state = state_[frame].load();
+    if ((state & IN_REPLACER) == 0) {
+      continue;
+    }
+    if ((state & REFERENCED) != 0) {
+      referenced_frames.push_back(static_cast<frame_id_t>(frame));
+    } else {
+      frames.push_back(static_cast<frame_id_t>(frame));
+    }
+  }
+  for (size_t i = 0; i < referenced_frames.size() && frames.size() < max_frames; i++) {
+    frames.push_back(referenced_frames[i]);
+  }
+  return frames;
+}
+
+size_t ClockReplacer::AdvanceHand() {
+  size_t hand = hand_.load();
+  while (!hand_.compare_exchange_weak(hand, (hand + 1) % num_pages_)) {
+  }
+  return hand;
+}
 
 }  // namespace bustub
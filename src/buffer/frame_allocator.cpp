@@ -0,0 +1,164 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_allocator.cpp
+//
+// Identification: src/buffer/frame_allocator.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/frame_allocator.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+#include "common/exception.h"
+
+namespace bustub {
+
+namespace {
+
+#ifdef __linux__
+/** 和numaif.h中的定义一致，直接使用系统调用，避免依赖libnuma */
+constexpr int MPOL_PREFERRED_MODE = 1;
+
+/**
+ * 解析/sys中"0-3,8-11"格式的CPU或节点列表，对其中的每个编号调用func
+ */
+template <typename Func>
+void ForEachInList(const std::string &list, Func func) {
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    if (!range.empty()) {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int i = first; i <= last; i++) {
+        func(i);
+      }
+    }
+    pos = end + 1;
+  }
+}
+
+/** @return the first line of a file, empty if it cannot be read */
+std::string ReadLine(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+#endif
+
+}  // namespace
+
+FrameAllocator::FrameAllocator(size_t num_frames, int numa_node) {
+  size_t size = num_frames * PAGE_SIZE;
+  // 小于一个大页的缓冲池用大页只会浪费内存，按普通页映射即可
+  bool use_huge_page = size >= static_cast<size_t>(HUGE_PAGE_SIZE);
+  if (use_huge_page) {
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  }
+  size_t map_size = use_huge_page ? size + HUGE_PAGE_SIZE : size;
+  if (map_size == 0) {
+    return;
+  }
+  void *addr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "cannot map the frames of the buffer pool");
+  }
+  auto *begin = static_cast<char *>(addr);
+  char *data = begin;
+  if (use_huge_page) {
+    // 多映射一个大页，然后把头尾多余的部分还回去，使数据按大页对齐
+    auto misalignment = reinterpret_cast<uintptr_t>(begin) % HUGE_PAGE_SIZE;
+    data = misalignment == 0 ? begin : begin + (HUGE_PAGE_SIZE - misalignment);
+    if (data != begin) {
+      munmap(begin, data - begin);
+    }
+    size_t tail = (begin + map_size) - (data + size);
+    if (tail > 0) {
+      munmap(data + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    huge_page_advised_ = madvise(data, size, MADV_HUGEPAGE) == 0;
+#endif
+  }
+  data_ = data;
+  size_ = size;
+
+#ifdef __linux__
+  // 在第一次访问之前设置内存策略，之后缺页时才会在指定节点上分配
+  if (numa_node >= 0 && numa_node < GetNumNumaNodes() && numa_node < static_cast<int>(sizeof(uint64_t) * 8)) {
+    uint64_t node_mask = 1ULL << numa_node;
+    if (syscall(SYS_mbind, data_, size_, MPOL_PREFERRED_MODE, &node_mask, sizeof(node_mask) * 8, 0) == 0) {
+      numa_node_ = numa_node;
+    }
+  }
+#endif
+}
+
+FrameAllocator::~FrameAllocator() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+void FrameAllocator::ReleaseFrames(frame_id_t first, size_t num_frames) {
+  if (data_ == nullptr || num_frames == 0) {
+    return;
+  }
+  // madvise要求起始地址按系统页对齐，PAGE_SIZE是系统页的整数倍所以帧的起始地址一定对齐
+  madvise(GetFrameData(first), num_frames * PAGE_SIZE, MADV_DONTNEED);
+}
+
+int FrameAllocator::GetNumNumaNodes() {
+#ifdef __linux__
+  int num_nodes = 0;
+  ForEachInList(ReadLine("/sys/devices/system/node/online"), [&num_nodes](int node) { num_nodes = node + 1; });
+  return num_nodes > 0 ? num_nodes : 1;
+#else
+  return 1;
+#endif
+}
+
+void FrameAllocator::BindThreadToNumaNode(int numa_node) {
+#ifdef __linux__
+  if (numa_node < 0) {
+    return;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  bool has_cpu = false;
+  ForEachInList(ReadLine("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist"),
+                [&cpu_set, &has_cpu](int cpu) {
+                  if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &cpu_set);
+                    has_cpu = true;
+                  }
+                });
+  if (has_cpu) {
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  }
+#endif
+}
+
+}  // namespace bustub
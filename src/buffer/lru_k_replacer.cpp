@@ -0,0 +1,105 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.cpp
+//
+// Identification: src/buffer/lru_k_replacer.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/lru_k_replacer.h"
+
+namespace bustub {
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k) : k_(k), history_(num_pages), evictable_(num_pages, false) {}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+// 先从访问次数不足k次的frame中选，都没有的话再选backward k-distance最大的
+bool LRUKReplacer::Victim(frame_id_t *frame_id) {
+  std::scoped_lock lock{mutex_};
+  std::set<EvictionKey> *candidates = infinite_distance_.empty() ? &finite_distance_ : &infinite_distance_;
+  if (candidates->empty()) {
+    return false;
+  }
+  *frame_id = candidates->begin()->second;
+  candidates->erase(candidates->begin());
+  // 访问历史保留到buffer pool确认换出并调用Remove为止，换出被放弃时该页仍保有原来的历史
+  evictable_[*frame_id] = false;
+  return true;
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  std::scoped_lock lock{mutex_};
+  if (!evictable_[frame_id]) {
+    return;
+  }
+  EvictableSet(frame_id)->erase(GetEvictionKey(frame_id));
+  evictable_[frame_id] = false;
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  std::scoped_lock lock{mutex_};
+  // 避免重复添加
+  if (evictable_[frame_id]) {
+    return;
+  }
+  EvictableSet(frame_id)->insert(GetEvictionKey(frame_id));
+  evictable_[frame_id] = true;
+}
+
+size_t LRUKReplacer::Size() {
+  std::scoped_lock lock{mutex_};
+  return infinite_distance_.size() + finite_distance_.size();
+}
+
+std::vector<frame_id_t> LRUKReplacer::PeekVictims(size_t max_frames) {
+  std::scoped_lock lock{mutex_};
+  std::vector<frame_id_t> frames;
+  for (const std::set<EvictionKey> *candidates : {&infinite_distance_, &finite_distance_}) {
+    for (auto iter = candidates->begin(); iter != candidates->end() && frames.size() < max_frames; ++iter) {
+      frames.push_back(iter->second);
+    }
+  }
+  return frames;
+}
+
+void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
+  std::scoped_lock lock{mutex_};
+  // 可victim的frame的key会随着访问改变，先从集合中拿出来，更新完再放回去
+  if (evictable_[frame_id]) {
+    EvictableSet(frame_id)->erase(GetEvictionKey(frame_id));
+  }
+  std::list<size_t> &history = history_[frame_id];
+  history.push_back(current_timestamp_++);
+  if (history.size() > k_) {
+    history.pop_front();
+  }
+  if (evictable_[frame_id]) {
+    EvictableSet(frame_id)->insert(GetEvictionKey(frame_id));
+  }
+}
+
+void LRUKReplacer::Remove(frame_id_t frame_id) {
+  std::scoped_lock lock{mutex_};
+  if (evictable_[frame_id]) {
+    EvictableSet(frame_id)->erase(GetEvictionKey(frame_id));
+    evictable_[frame_id] = false;
+  }
+  history_[frame_id].clear();
+}
+
+std::set<LRUKReplacer::EvictionKey> *LRUKReplacer::EvictableSet(frame_id_t frame_id) {
+  return history_[frame_id].size() < k_ ? &infinite_distance_ : &finite_distance_;
+}
+
+LRUKReplacer::EvictionKey LRUKReplacer::GetEvictionKey(frame_id_t frame_id) const {
+  // 历史中只保留最近k次访问，表头即第k近的访问；不足k次时表头是最早的访问。没有访问记录的frame最先被换出
+  const std::list<size_t> &history = history_[frame_id];
+  return {history.empty() ? 0 : history.front(), frame_id};
+}
+
+}  // namespace bustub
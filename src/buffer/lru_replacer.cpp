@@ -12,6 +12,8 @@
 
 #include "buffer/lru_replacer.h"
 
+#include <algorithm>
+
 namespace bustub {
 
 LRUReplacer::LRUReplacer(size_t num_pages) { max_size_ = num_pages; }
@@ -66,4 +68,15 @@ size_t LRUReplacer::Size() {
   return lru_list_.size();
 }
 
+// 从链表尾部开始返回最多max_frames个即将被victim的frame，不移除它们
+std::vector<frame_id_t> LRUReplacer::PeekVictims(size_t max_frames) {
+  std::scoped_lock lock{mutex_};
+  std::vector<frame_id_t> frames;
+  frames.reserve(std::min(max_frames, lru_list_.size()));
+  for (auto iter = lru_list_.rbegin(); iter != lru_list_.rend() && frames.size() < max_frames; ++iter) {
+    frames.push_back(*iter);
+  }
+  return frames;
+}
+
 }  // namespace bustub
@@ -15,14 +15,23 @@
 namespace bustub {
 
 ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager) {
+                                                     LogManager *log_manager, ReplacerType replacer_type,
+                                                     InstanceRouting routing, size_t max_pool_size) {
   // Allocate and create individual BufferPoolManagerInstances
   num_instances_ = num_instances;
   pool_size_ = pool_size;
+  disk_manager_ = disk_manager;
+  routing_ = routing;
   next_instance_ = 0;
+  // 和实例一样，重启后从已经分配过的页之后开始
+  next_page_id_ = disk_manager_->GetNumAllocatedPages();
   // managers_ = new BufferPoolManager *[static_cast<int>(num_instances)];
+  // 多个NUMA节点时把各个实例的内存轮流放到不同节点上
+  int num_numa_nodes = FrameAllocator::GetNumNumaNodes();
   for (size_t i = 0; i < num_instances_; i++) {
-    managers_.push_back(new BufferPoolManagerInstance(pool_size, num_instances_, i, disk_manager, log_manager));
+    int numa_node = num_numa_nodes > 1 ? static_cast<int>(i % num_numa_nodes) : -1;
+    managers_.push_back(new BufferPoolManagerInstance(pool_size, num_instances_, i, disk_manager, log_manager,
+                                                      replacer_type, numa_node, max_pool_size));
     // BufferPoolManagerInstance *manager =
     //     new BufferPoolManagerInstance(pool_size, num_instances, i, disk_manager, log_manager);
     // *(managers_ + i) = manager;
@@ -42,17 +51,138 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return num_instances_ * pool_size_;
 }
 
+bool ParallelBufferPoolManager::Resize(size_t pool_size) {
+  if (pool_size == 0 || pool_size > managers_[0]->GetMaxPoolSize()) {
+    return false;
+  }
+  // 并发的Resize串行执行，否则回滚时的旧容量可能已经被别的Resize改掉了
+  std::scoped_lock resize_lock{resize_latch_};
+  size_t old_pool_size = pool_size_;
+  // 各实例依次调整，调整期间各实例的容量可能暂时不一致
+  for (size_t i = 0; i < num_instances_; i++) {
+    if (!managers_[i]->Resize(pool_size)) {
+      // 只有缩容会因为超时失败，把已经缩容的实例扩回原来的容量。扩容不会失败
+      for (size_t j = 0; j < i; j++) {
+        managers_[j]->Resize(old_pool_size);
+      }
+      return false;
+    }
+  }
+  pool_size_ = pool_size;
+  return true;
+}
+
+void ParallelBufferPoolManager::RunBackgroundFlushThread(double clean_ratio) {
+  for (BufferPoolManagerInstance *manager : managers_) {
+    manager->RunBackgroundFlushThread(clean_ratio);
+  }
+}
+
+void ParallelBufferPoolManager::StopBackgroundFlushThread() {
+  for (BufferPoolManagerInstance *manager : managers_) {
+    manager->StopBackgroundFlushThread();
+  }
+}
+
+uint64_t ParallelBufferPoolManager::GetNumHits() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumHits();
+  }
+  return num;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumMisses() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumMisses();
+  }
+  return num;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumEvictions() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumEvictions();
+  }
+  return num;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumForegroundWrites() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumForegroundWrites();
+  }
+  return num;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumBackgroundWrites() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumBackgroundWrites();
+  }
+  return num;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumPrefetches() const {
+  uint64_t num = 0;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    num += manager->GetNumPrefetches();
+  }
+  return num;
+}
+
+BufferPoolStats ParallelBufferPoolManager::GetStats() const {
+  BufferPoolStats stats;
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    stats += manager->GetStats();
+  }
+  return stats;
+}
+
+std::vector<BufferPoolStats> ParallelBufferPoolManager::GetInstanceStats() const {
+  std::vector<BufferPoolStats> stats;
+  stats.reserve(num_instances_);
+  for (const BufferPoolManagerInstance *manager : managers_) {
+    stats.push_back(manager->GetStats());
+  }
+  return stats;
+}
+
+int ParallelBufferPoolManager::GetNumaNode(page_id_t page_id) const {
+  return managers_[GetInstanceIndex(page_id)]->GetNumaNode();
+}
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
-  return managers_[page_id % num_instances_];
+  return managers_[GetInstanceIndex(page_id)];
   // return *(managers_ + page_id % num_instances_);
 }
 
+size_t ParallelBufferPoolManager::GetInstanceIndex(page_id_t page_id) const {
+  if (routing_ == InstanceRouting::MODULO) {
+    return page_id % num_instances_;
+  }
+  // murmur3的fmix32，相邻的page id会被打散到不同的实例上
+  auto hash = static_cast<uint32_t>(page_id);
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+  return hash % num_instances_;
+}
+
 Page *ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) {
   // Fetch page for page_id from responsible BufferPoolManagerInstance
   return GetBufferPoolManager(page_id)->FetchPage(page_id);
 }
 
+Page *ParallelBufferPoolManager::FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
+  // 环形缓冲区绑定的是并行BPM本身，实例读盘之后通过它换出页面，不会路由错
+  return GetBufferPoolManager(page_id)->FetchPageWithStrategy(page_id, strategy);
+}
+
 bool ParallelBufferPoolManager::UnpinPgImp(page_id_t page_id, bool is_dirty) {
   // Unpin page_id from responsible BufferPoolManagerInstance
   return GetBufferPoolManager(page_id)->UnpinPage(page_id, is_dirty);
@@ -70,12 +200,35 @@ Page *ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) {
   // starting index and return nullptr
   // 2.   Bump the starting index (mod number of instances) to start search at a different BPMI each time this function
   // is called
-  std::scoped_lock lock{latch_};
+  if (routing_ == InstanceRouting::HASH) {
+    // page id决定了实例，实例满了就换一个id再试；删除过的页面优先重用，用不上的还回去
+    bool reuse = true;
+    for (size_t i = 0; i < num_instances_; i++) {
+      page_id_t new_page_id = reuse ? disk_manager_->AllocateFreePage() : INVALID_PAGE_ID;
+      bool reused = new_page_id != INVALID_PAGE_ID;
+      if (!reused) {
+        new_page_id = next_page_id_.fetch_add(1);
+        disk_manager_->MarkPageAllocated(new_page_id);
+      }
+      Page *page = managers_[GetInstanceIndex(new_page_id)]->NewPageWithId(new_page_id);
+      if (page != nullptr) {
+        *page_id = new_page_id;
+        return page;
+      }
+      // 还回去之后再取还是同一页，后面只用新的id
+      if (reused) {
+        disk_manager_->DeallocatePage(new_page_id);
+        reuse = false;
+      }
+    }
+    return nullptr;
+  }
+  // 每次调用只需要原子地取一个起始位置，不再用全局锁串行化所有的NewPage
+  size_t start = next_instance_.fetch_add(1) % num_instances_;
   for (size_t i = 0; i < num_instances_; i++) {
     // BufferPoolManager *manager = *(managers_ + next_instance_);
-    BufferPoolManager *manager = managers_[next_instance_];
+    BufferPoolManager *manager = managers_[(start + i) % num_instances_];
     Page *page = manager->NewPage(page_id);
-    next_instance_ = (next_instance_ + 1) % num_instances_;
     if (page != nullptr) {
       return page;
     }
@@ -88,12 +241,66 @@ bool ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) {
   return GetBufferPoolManager(page_id)->DeletePage(page_id);
 }
 
+bool ParallelBufferPoolManager::DiscardPgImp(page_id_t page_id) {
+  // Discard page_id from responsible BufferPoolManagerInstance
+  return GetBufferPoolManager(page_id)->DiscardPage(page_id);
+}
+
+bool ParallelBufferPoolManager::PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) {
+  // Prefetch page_id from responsible BufferPoolManagerInstance
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  return GetBufferPoolManager(page_id)->PrefetchPage(page_id, strategy);
+}
+
+Page *ParallelBufferPoolManager::FetchResidentPgImp(page_id_t page_id) {
+  // Fetch page_id from responsible BufferPoolManagerInstance if it is resident
+  return GetBufferPoolManager(page_id)->FetchPageIfResident(page_id);
+}
+
+std::vector<Page *> ParallelBufferPoolManager::FetchPgsImp(const std::vector<page_id_t> &page_ids) {
+  // 按实例拆成若干批，每个实例只调用一次
+  std::vector<std::vector<size_t>> instance_requests(num_instances_);
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    instance_requests[GetInstanceIndex(page_ids[i])].push_back(i);
+  }
+  std::vector<Page *> pages(page_ids.size(), nullptr);
+  for (size_t instance_index = 0; instance_index < num_instances_; instance_index++) {
+    if (instance_requests[instance_index].empty()) {
+      continue;
+    }
+    std::vector<page_id_t> instance_page_ids;
+    instance_page_ids.reserve(instance_requests[instance_index].size());
+    for (size_t i : instance_requests[instance_index]) {
+      instance_page_ids.push_back(page_ids[i]);
+    }
+    std::vector<Page *> instance_pages = managers_[instance_index]->FetchPages(instance_page_ids);
+    for (size_t j = 0; j < instance_pages.size(); j++) {
+      pages[instance_requests[instance_index][j]] = instance_pages[j];
+    }
+  }
+  return pages;
+}
+
+bool ParallelBufferPoolManager::UnpinPgsImp(const std::vector<std::pair<page_id_t, bool>> &pages) {
+  std::vector<std::vector<std::pair<page_id_t, bool>>> instance_requests(num_instances_);
+  for (const auto &request : pages) {
+    instance_requests[GetInstanceIndex(request.first)].push_back(request);
+  }
+  bool result = true;
+  for (size_t instance_index = 0; instance_index < num_instances_; instance_index++) {
+    if (!instance_requests[instance_index].empty()) {
+      result = managers_[instance_index]->UnpinPages(instance_requests[instance_index]) && result;
+    }
+  }
+  return result;
+}
+
 void ParallelBufferPoolManager::FlushAllPgsImp() {
   // flush all pages from all BufferPoolManagerInstances
   for (size_t i = 0; i < num_instances_; i++) {
-    // BufferPoolManager *manager = *(managers_ + i);
-    // manager->FlushAllPages();
-    delete managers_[i];
+    managers_[i]->FlushAllPages();
   }
 }
 
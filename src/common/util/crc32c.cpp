@@ -0,0 +1,97 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// crc32c.cpp
+//
+// Identification: src/common/util/crc32c.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace bustub {
+
+namespace {
+
+/** CRC-32C多项式的反转表示 */
+constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+/** 逐字节查表用的表，编译期生成 */
+constexpr std::array<uint32_t, 256> MakeTable() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) != 0 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC32C_TABLE = MakeTable();
+
+uint32_t ExtendSoftware(uint32_t crc, const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    crc = CRC32C_TABLE[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+/** 只有这个函数用SSE4.2编译，其余代码仍然可以在没有SSE4.2的CPU上运行 */
+__attribute__((target("sse4.2"))) uint32_t ExtendHardware(uint32_t crc, const char *data, size_t size) {
+  uint64_t crc64 = crc;
+  // 每条指令处理8个字节，剩下的逐字节处理
+  while (size >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += sizeof(word);
+    size -= sizeof(word);
+  }
+  auto crc32 = static_cast<uint32_t>(crc64);
+  while (size > 0) {
+    crc32 = _mm_crc32_u8(crc32, static_cast<uint8_t>(*data));
+    data++;
+    size--;
+  }
+  return crc32;
+}
+
+bool DetectHardwareCrc32c() {
+  // 静态初始化时可能还没有初始化CPU特性信息，先手动初始化
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+const bool HAS_HARDWARE_CRC32C = DetectHardwareCrc32c();
+#else
+const bool HAS_HARDWARE_CRC32C = false;
+#endif
+
+}  // namespace
+
+uint32_t Crc32c::Extend(uint32_t crc, const char *data, size_t size) {
+  crc = ~crc;
+#if defined(__x86_64__)
+  if (HAS_HARDWARE_CRC32C) {
+    return ~ExtendHardware(crc, data, size);
+  }
+#endif
+  return ~ExtendSoftware(crc, data, size);
+}
+
+bool Crc32c::IsHardwareAccelerated() { return HAS_HARDWARE_CRC32C; }
+
+}  // namespace bustub
@@ -0,0 +1,168 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lz_compressor.cpp
+//
+// Identification: src/common/util/lz_compressor.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/lz_compressor.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace bustub {
+
+namespace {
+
+constexpr size_t HASH_BITS = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr uint8_t NIBBLE_MAX = 15;
+
+/** 4个字节的乘法哈希 */
+inline uint32_t HashOf(const char *data) {
+  uint32_t word;
+  memcpy(&word, data, sizeof(word));
+  return (word * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/** 长度的半字节放不下时，超出的部分写成若干个255和一个小于255的字节 */
+inline bool PutLength(size_t length, char **out, const char *end) {
+  for (; length >= 255; length -= 255) {
+    if (*out == end) {
+      return false;
+    }
+    *(*out)++ = static_cast<char>(255);
+  }
+  if (*out == end) {
+    return false;
+  }
+  *(*out)++ = static_cast<char>(length);
+  return true;
+}
+
+inline bool GetLength(size_t *length, const uint8_t **in, const uint8_t *end) {
+  uint8_t byte;
+  do {
+    if (*in == end) {
+      return false;
+    }
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/** 写出一个token：literals之后跟一个match，match_length为0表示最后一个只有literals的token */
+bool PutSequence(const char *literals, size_t num_literals, size_t offset, size_t match_length, char **out,
+                 const char *end) {
+  if (*out == end) {
+    return false;
+  }
+  char *token = (*out)++;
+  size_t literal_nibble = num_literals < NIBBLE_MAX ? num_literals : NIBBLE_MAX;
+  size_t match_nibble = 0;
+  if (match_length > 0) {
+    match_nibble = match_length - LzCompressor::MIN_MATCH;
+    match_nibble = match_nibble < NIBBLE_MAX ? match_nibble : NIBBLE_MAX;
+  }
+  *token = static_cast<char>(literal_nibble << 4 | match_nibble);
+  if (literal_nibble == NIBBLE_MAX && !PutLength(num_literals - NIBBLE_MAX, out, end)) {
+    return false;
+  }
+  if (static_cast<size_t>(end - *out) < num_literals) {
+    return false;
+  }
+  memcpy(*out, literals, num_literals);
+  *out += num_literals;
+  if (match_length == 0) {
+    return true;
+  }
+  if (end - *out < 2) {
+    return false;
+  }
+  *(*out)++ = static_cast<char>(offset & 0xFF);
+  *(*out)++ = static_cast<char>(offset >> 8);
+  return match_nibble != NIBBLE_MAX || PutLength(match_length - LzCompressor::MIN_MATCH - NIBBLE_MAX, out, end);
+}
+
+}  // namespace
+
+size_t LzCompressor::Compress(const char *src, size_t size, char *dst, size_t capacity) {
+  // 哈希表记录每个4字节前缀最近出现的位置，只探测一次，贪心地取最长匹配
+  std::vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+  char *out = dst;
+  const char *end = dst + capacity;
+  size_t anchor = 0;
+  size_t pos = 0;
+  while (pos + MIN_MATCH <= size) {
+    uint32_t hash = HashOf(src + pos);
+    size_t candidate = table[hash];
+    table[hash] = static_cast<uint32_t>(pos);
+    if (candidate == UINT32_MAX || pos - candidate > MAX_OFFSET || memcmp(src + candidate, src + pos, MIN_MATCH) != 0) {
+      pos++;
+      continue;
+    }
+    size_t match_length = MIN_MATCH;
+    while (pos + match_length < size && src[candidate + match_length] == src[pos + match_length]) {
+      match_length++;
+    }
+    if (!PutSequence(src + anchor, pos - anchor, pos - candidate, match_length, &out, end)) {
+      return 0;
+    }
+    pos += match_length;
+    anchor = pos;
+  }
+  if (!PutSequence(src + anchor, size - anchor, 0, 0, &out, end)) {
+    return 0;
+  }
+  return out - dst;
+}
+
+bool LzCompressor::Decompress(const char *src, size_t size, char *dst, size_t dst_size) {
+  // 输入来自磁盘，可能已经损坏，每一步都要检查边界
+  const auto *in = reinterpret_cast<const uint8_t *>(src);
+  const uint8_t *in_end = in + size;
+  size_t out = 0;
+  while (in != in_end) {
+    uint8_t token = *in++;
+    size_t num_literals = token >> 4;
+    if (num_literals == NIBBLE_MAX && !GetLength(&num_literals, &in, in_end)) {
+      return false;
+    }
+    if (static_cast<size_t>(in_end - in) < num_literals || dst_size - out < num_literals) {
+      return false;
+    }
+    memcpy(dst + out, in, num_literals);
+    in += num_literals;
+    out += num_literals;
+    if (in == in_end) {
+      break;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+    in += 2;
+    size_t match_length = token & NIBBLE_MAX;
+    if (match_length == NIBBLE_MAX && !GetLength(&match_length, &in, in_end)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > out || dst_size - out < match_length) {
+      return false;
+    }
+    // match可能和自己重叠(比如一串重复的字节)，只能逐字节复制
+    for (size_t i = 0; i < match_length; i++, out++) {
+      dst[out] = dst[out - offset];
+    }
+  }
+  return out == dst_size;
+}
+
+}  // namespace bustub
@@ -10,8 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <string>
 #include <utility>
 #include <vector>
@@ -23,12 +25,25 @@
 
 namespace bustub {
 
+namespace {
+
+/** @return the bits of value in reverse order, bit 0 becomes bit 31 */
+uint32_t ReverseBits(uint32_t value) {
+  uint32_t reversed = 0;
+  for (int i = 0; i < 32; i++) {
+    reversed = (reversed << 1) | ((value >> i) & 1);
+  }
+  return reversed;
+}
+
+}  // namespace
+
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                      const KeyComparator &comparator, HashFunction<KeyType> hash_fn)
     : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
   //  implement me!
-  directory_page_id_ = INVALID_PAGE_ID;
+  header_page_id_ = INVALID_PAGE_ID;
   // std::ifstream file("/autograder/bustub/test/container/grading_hash_table_concurrent_test.cpp");
   // std::string str;
   // while (file.good()) {
@@ -37,6 +52,14 @@ HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager
   // }
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
+                                     const KeyComparator &comparator, HashFunction<KeyType> hash_fn,
+                                     const std::vector<std::pair<KeyType, ValueType>> &entries)
+    : ExtendibleHashTable(name, buffer_pool_manager, comparator, std::move(hash_fn)) {
+  std::call_once(directory_init_, [this, &entries] { BulkLoad(entries); });
+}
+
 /*****************************************************************************
  * HELPERS
  *****************************************************************************/
@@ -65,66 +88,181 @@ uint32_t HASH_TABLE_TYPE::Hash(KeyType key) {
  * representation.
  *
  * @param key the key to use for lookup
- * @param dir_page to use for lookup of global depth
+ * @param directory to use for lookup of global depth
  * @return the directory index
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-uint32_t HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectoryPage *dir_page) {
+uint32_t HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectory *directory) {
   // 参考注释，直接用掩码做与运算即可
-  return Hash(key) & dir_page->GetGlobalDepthMask();
+  return Hash(key) & directory->GetGlobalDepthMask();
 }
 
 /**
  * Get the bucket page_id corresponding to a key.
  *
  * @param key the key for lookup
- * @param dir_page a pointer to the hash table's directory page
+ * @param directory the hash table's directory
  * @return the bucket page_id corresponding to the input key
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-page_id_t HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page) {
+page_id_t HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectory *directory) {
   // 调用现有函数即可
-  return dir_page->GetBucketPageId(KeyToDirectoryIndex(key, dir_page));
+  return directory->GetBucketPageId(KeyToDirectoryIndex(key, directory));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::OptimisticKeyToPageId(Page *header_page, uint64_t header_version, uint32_t hash,
+                                            page_id_t *bucket_page_id) {
+  HashTableDirectoryHeaderPage *header = GetHeaderPageData(header_page);
+  // 验证之前读到的global depth可能是撕裂的，先限制一下，保证下标不越界
+  uint32_t global_depth = std::min<uint32_t>(header->GetGlobalDepth(), MAX_GLOBAL_DEPTH);
+  uint32_t directory_index = hash & ((1U << global_depth) - 1);
+  page_id_t directory_page_id = header->GetDirectoryPageId(directory_index >> MAX_BUCKET_DEPTH);
+  // directory page id必须先验证，否则可能拿着一个撕裂的page id去缓冲池取页
+  if (!header_page->ValidateOptimisticRead(header_version)) {
+    return false;
+  }
+  Page *directory_page = buffer_pool_manager_->FetchPage(directory_page_id);
+  assert(directory_page != nullptr);
+  *bucket_page_id = GetDirectoryPageData(directory_page)->GetBucketPageId(directory_index & (DIRECTORY_ARRAY_SIZE - 1));
+  UnpinPage(directory_page_id, false);
+  // directory page只在header的写锁下修改，header没变说明读到的bucket page id也没变
+  return header_page->ValidateOptimisticRead(header_version);
 }
 
-/**
- * Fetches the directory page from the buffer pool manager.
- * 从BufferPoolManager中得到directory所在的Page，Page中是一个Directory对象
- * 如果还没有directory的话，那就创建一个
- *
- * @return a pointer to the directory page
- */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-HashTableDirectoryPage *HASH_TABLE_TYPE::FetchDirectoryPage() {
-  HashTableDirectoryPage *ret;
-  // 如果不可用，则创建一个
-  driectory_lock_.lock();
-  if (directory_page_id_ == INVALID_PAGE_ID) {
-    // 先创建DirectoryPage
+void HASH_TABLE_TYPE::BulkLoad(const std::vector<std::pair<KeyType, ValueType>> &entries) {
+  // directory下标取的是hash的低位。把hash的位反转之后排序，低位相同的entry就挨在一起，
+  // 每个bucket对应排序后的一段连续区间
+  std::vector<std::pair<uint32_t, size_t>> order(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    order[i] = {ReverseBits(Hash(entries[i].first)), i};
+  }
+  std::sort(order.begin(), order.end());
+
+  // 区间内的entry放不进一个bucket就按下一位分成两半，直到放得下，这就是每个bucket最终的local depth
+  // 先处理低半区，得到的bucket按区间的顺序排列
+  struct Partition {
+    uint32_t prefix_;
+    uint32_t depth_;
+    size_t begin_;
+    size_t end_;
+  };
+  std::vector<Partition> partitions;
+  std::vector<Partition> stack{{0, 0, 0, order.size()}};
+  uint32_t global_depth = 0;
+  while (!stack.empty()) {
+    Partition partition = stack.back();
+    stack.pop_back();
+    // 到了最大深度还放不下，多出来的和Insert一样插不进去
+    // 区间内hash全都相同的话再怎么分也分不开，不用白白把directory撑大
+    if (partition.end_ - partition.begin_ <= BUCKET_ARRAY_SIZE || partition.depth_ == MAX_GLOBAL_DEPTH ||
+        order[partition.begin_].first == order[partition.end_ - 1].first) {
+      partitions.push_back(partition);
+      global_depth = std::max(global_depth, partition.depth_);
+      continue;
+    }
+    uint32_t bit = 1U << (31 - partition.depth_);
+    auto is_low_half = [bit](const std::pair<uint32_t, size_t> &entry) { return (entry.first & bit) == 0; };
+    auto mid = std::partition_point(order.begin() + partition.begin_, order.begin() + partition.end_, is_low_half);
+    auto mid_index = static_cast<size_t>(mid - order.begin());
+    stack.push_back({partition.prefix_ | (1U << partition.depth_), partition.depth_ + 1, mid_index, partition.end_});
+    stack.push_back({partition.prefix_, partition.depth_ + 1, partition.begin_, mid_index});
+  }
+
+  // 按顺序写出所有bucket，同时在内存中填好directory
+  uint32_t directory_size = 1U << global_depth;
+  std::vector<page_id_t> bucket_page_ids(directory_size);
+  std::vector<uint8_t> local_depths(directory_size);
+  size_t num_duplicates = 0;
+  size_t num_overflows = 0;
+  for (const Partition &partition : partitions) {
+    page_id_t bucket_page_id;
+    Page *page = buffer_pool_manager_->NewPage(&bucket_page_id);
+    assert(page != nullptr);
+    HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(page);
+    for (size_t i = partition.begin_; i < partition.end_; i++) {
+      const auto &[key, value] = entries[order[i].second];
+      // 和Insert一样：bucket满了的丢掉，重复的pair只留一份
+      if (bucket->IsFull()) {
+        num_overflows++;
+      } else if (!bucket->Insert(key, value, ReverseBits(order[i].first), comparator_)) {
+        num_duplicates++;
+      }
+    }
+    UnpinPage(bucket_page_id, true);
+    for (uint32_t i = partition.prefix_; i < directory_size; i += 1U << partition.depth_) {
+      bucket_page_ids[i] = bucket_page_id;
+      local_depths[i] = partition.depth_;
+    }
+  }
+
+  if (num_overflows > 0) {
+    LOG_WARN("BulkLoad: dropped %zu entries that did not fit their bucket and %zu duplicate entries", num_overflows,
+             num_duplicates);
+  } else if (num_duplicates > 0) {
+    LOG_DEBUG("BulkLoad: dropped %zu duplicate entries", num_duplicates);
+  }
+
+  // 然后是directory page，每页DIRECTORY_ARRAY_SIZE个下标
+  std::vector<page_id_t> directory_page_ids;
+  for (uint32_t first = 0; first < directory_size; first += DIRECTORY_ARRAY_SIZE) {
     page_id_t new_page_id_dir;
     Page *page = buffer_pool_manager_->NewPage(&new_page_id_dir);
     assert(page != nullptr);
-    ret = reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
-    directory_page_id_ = new_page_id_dir;
-    ret->SetPageId(directory_page_id_);
-    // 然后创建为空的directory创建第一个bucket
-    page_id_t new_page_id_buc;
-    page = nullptr;
-    page = buffer_pool_manager_->NewPage(&new_page_id_buc);
-    assert(page != nullptr);
-    ret->SetBucketPageId(0, new_page_id_buc);
-    // 最后Unpin这两个页面
-    assert(buffer_pool_manager_->UnpinPage(new_page_id_dir, true));
-    assert(buffer_pool_manager_->UnpinPage(new_page_id_buc, true));
+    HashTableDirectoryPage *dir_page = GetDirectoryPageData(page);
+    dir_page->SetPageId(new_page_id_dir);
+    dir_page->SetGlobalDepth(global_depth);
+    for (uint32_t slot = 0; slot < DIRECTORY_ARRAY_SIZE && first + slot < directory_size; slot++) {
+      dir_page->SetLocalDepth(slot, local_depths[first + slot]);
+      dir_page->SetBucketPageId(slot, bucket_page_ids[first + slot]);
+    }
+    UnpinPage(new_page_id_dir, true);
+    directory_page_ids.push_back(new_page_id_dir);
+  }
+
+  // 最后是header
+  page_id_t new_page_id_header;
+  Page *page = buffer_pool_manager_->NewPage(&new_page_id_header);
+  assert(page != nullptr);
+  HashTableDirectoryHeaderPage *header = GetHeaderPageData(page);
+  header->SetPageId(new_page_id_header);
+  header->SetGlobalDepth(global_depth);
+  for (uint32_t i = 0; i < DIRECTORY_HEADER_ARRAY_SIZE; i++) {
+    header->SetDirectoryPageId(i, i < directory_page_ids.size() ? directory_page_ids[i] : INVALID_PAGE_ID);
   }
-  driectory_lock_.unlock();
+  UnpinPage(new_page_id_header, true);
+  header_page_id_ = new_page_id_header;
+}
+
+/**
+ * Fetches the header page of the directory from the buffer pool manager.
+ * 从BufferPoolManager中得到directory的header所在的Page，header中记录了每个directory page
+ * 如果还没有directory的话，那就创建一个
+ *
+ * @return the pinned header page of the directory
+ */
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *HASH_TABLE_TYPE::FetchHeaderPage() {
+  // 只在第一次调用时创建directory，之后每次调用只是一次原子读，不再加锁
+  // 空的表就是bulk load了0个entry：一个header，一个directory page和一个空bucket
+  std::call_once(directory_init_, [this] { BulkLoad({}); });
 
   // 从buffer中获取页面
-  assert(directory_page_id_ != INVALID_PAGE_ID);
-  Page *page = buffer_pool_manager_->FetchPage(directory_page_id_);
+  assert(header_page_id_ != INVALID_PAGE_ID);
+  Page *page = buffer_pool_manager_->FetchPage(header_page_id_);
   assert(page != nullptr);
-  ret = reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
-  return ret;
+  return page;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HashTableDirectoryHeaderPage *HASH_TABLE_TYPE::GetHeaderPageData(Page *page) {
+  return reinterpret_cast<HashTableDirectoryHeaderPage *>(page->GetData());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HashTableDirectoryPage *HASH_TABLE_TYPE::GetDirectoryPageData(Page *page) {
+  return reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
 }
 
 /**
@@ -160,81 +298,244 @@ HASH_TABLE_BUCKET_TYPE *HASH_TABLE_TYPE::GetBucketPageData(Page *page) {
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
-  Page *bucket_page = FetchBucketPage(bucket_page_id);
-  bucket_page->RLatch();
+  // 先乐观读，和写者冲突太多次再老老实实加锁
+  uint32_t hash = Hash(key);
+  bool found;
+  for (int i = 0; i < OPTIMISTIC_READ_RETRIES; i++) {
+    if (OptimisticGetValue(key, hash, result, &found)) {
+      return found;
+    }
+  }
+
+  Page *bucket_page = LatchBucketPage(hash, false);
   HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
 
   // 读取数据
-  bool ret = bucket->GetValue(key, comparator_, result);
+  bool ret = bucket->GetValue(key, hash, comparator_, result);
   bucket_page->RUnlatch();
 
   // 记得Unpin
-  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-
-  table_latch_.RUnlock();
+  UnpinPage(bucket_page->GetPageId(), false);
   return ret;
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *HASH_TABLE_TYPE::LatchBucketPage(uint32_t hash, bool exclusive) {
+  Page *header_page = FetchHeaderPage();
+  // 先乐观地读directory。拿到bucket的锁之后directory仍然没变，说明此刻key确实属于这个bucket，
+  // 之后的分裂和合并要先拿到这个bucket的锁才能移动它的数据，所以放掉directory也是安全的
+  for (int i = 0; i < OPTIMISTIC_READ_RETRIES; i++) {
+    uint64_t header_version;
+    page_id_t bucket_page_id;
+    if (!header_page->TryOptimisticRead(&header_version) ||
+        !OptimisticKeyToPageId(header_page, header_version, hash, &bucket_page_id)) {
+      continue;
+    }
+    Page *bucket_page = FetchBucketPage(bucket_page_id);
+    exclusive ? bucket_page->WLatch() : bucket_page->RLatch();
+    if (header_page->ValidateOptimisticRead(header_version)) {
+      UnpinPage(header_page_id_, false);
+      return bucket_page;
+    }
+    exclusive ? bucket_page->WUnlatch() : bucket_page->RUnlatch();
+    UnpinPage(bucket_page_id, false);
+  }
+
+  // 和分裂合并冲突太多次，加header的读锁，拿到bucket的锁之后再放掉
+  header_page->RLatch();
+  Page *bucket_page;
+  {
+    HashTableDirectory directory(buffer_pool_manager_, header_page);
+    bucket_page = FetchBucketPage(directory.GetBucketPageId(hash & directory.GetGlobalDepthMask()));
+  }
+  exclusive ? bucket_page->WLatch() : bucket_page->RLatch();
+  header_page->RUnlatch();
+  UnpinPage(header_page_id_, false);
+  return bucket_page;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::OptimisticGetValue(const KeyType &key, uint32_t hash, std::vector<ValueType> *result,
+                                         bool *found) {
+  Page *header_page = FetchHeaderPage();
+  uint64_t header_version;
+  page_id_t bucket_page_id;
+  if (!header_page->TryOptimisticRead(&header_version) ||
+      !OptimisticKeyToPageId(header_page, header_version, hash, &bucket_page_id)) {
+    UnpinPage(header_page_id_, false);
+    return false;
+  }
+
+  Page *bucket_page = FetchBucketPage(bucket_page_id);
+  HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
+  uint64_t bucket_version;
+  bool valid = bucket_page->TryOptimisticRead(&bucket_version);
+  std::vector<ValueType> values;
+  if (valid) {
+    *found = bucket->GetValue(key, hash, comparator_, &values);
+    // bucket没被改过还不够，directory也不能变，否则key可能在这期间被分裂到了另一个bucket中
+    valid = bucket_page->ValidateOptimisticRead(bucket_version) && header_page->ValidateOptimisticRead(header_version);
+  }
+  UnpinPage(bucket_page_id, false);
+  UnpinPage(header_page_id_, false);
+  if (valid) {
+    result->insert(result->end(), values.begin(), values.end());
+  }
+  return valid;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+size_t HASH_TABLE_TYPE::GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                                  std::vector<std::vector<ValueType>> *results) {
+  results->assign(keys.size(), std::vector<ValueType>());
+  // 先把所有key的hash算好，之后分组和重新分组都不用再算
+  std::vector<uint32_t> hashes(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    hashes[i] = Hash(keys[i]);
+  }
+  std::vector<size_t> pending(keys.size());
+  std::iota(pending.begin(), pending.end(), 0);
+
+  Page *header_page = FetchHeaderPage();
+  size_t found = 0;
+  for (int round = 0; !pending.empty() && round < OPTIMISTIC_READ_RETRIES; round++) {
+    std::vector<page_id_t> bucket_page_ids;
+    uint64_t header_version = GroupByBucket(header_page, hashes, &pending, &bucket_page_ids);
+    // 分组之后directory变了，这一组和之后所有组的分组都不再可信，留到下一轮重新分组
+    std::vector<size_t> retry;
+    for (size_t begin = 0, end; begin < pending.size(); begin = end) {
+      page_id_t bucket_page_id = bucket_page_ids[begin];
+      end = begin + 1;
+      while (end < pending.size() && bucket_page_ids[end] == bucket_page_id) {
+        end++;
+      }
+      if (!retry.empty()) {
+        retry.insert(retry.end(), pending.begin() + begin, pending.begin() + end);
+        continue;
+      }
+      // 读这个bucket的同时，让缓冲池在后台把下一个bucket读进来
+      if (end < pending.size()) {
+        buffer_pool_manager_->PrefetchPage(bucket_page_ids[end]);
+      }
+      Page *bucket_page = FetchBucketPage(bucket_page_id);
+      bucket_page->RLatch();
+      if (!header_page->ValidateOptimisticRead(header_version)) {
+        bucket_page->RUnlatch();
+        UnpinPage(bucket_page_id, false);
+        retry.insert(retry.end(), pending.begin() + begin, pending.begin() + end);
+        continue;
+      }
+      HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
+      for (size_t i = begin; i < end; i++) {
+        found += bucket->GetValue(keys[pending[i]], hashes[pending[i]], comparator_, &(*results)[pending[i]]) ? 1 : 0;
+      }
+      bucket_page->RUnlatch();
+      UnpinPage(bucket_page_id, false);
+    }
+    pending = std::move(retry);
+  }
+  UnpinPage(header_page_id_, false);
+
+  // 和分裂合并冲突太多次，剩下的逐个查
+  for (size_t idx : pending) {
+    found += GetValue(transaction, keys[idx], &(*results)[idx]) ? 1 : 0;
+  }
+  return found;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint64_t HASH_TABLE_TYPE::GroupByBucket(Page *header_page, const std::vector<uint32_t> &hashes,
+                                        std::vector<size_t> *pending, std::vector<page_id_t> *bucket_page_ids) {
+  std::vector<std::pair<page_id_t, size_t>> grouped;
+  grouped.reserve(pending->size());
+  header_page->RLatch();
+  // 持有读锁时没有写者，这里一定成功
+  uint64_t header_version;
+  header_page->TryOptimisticRead(&header_version);
+  {
+    HashTableDirectory directory(buffer_pool_manager_, header_page);
+    uint32_t mask = directory.GetGlobalDepthMask();
+    // 按directory下标的顺序查，跨directory page的时候每页只取一次
+    std::sort(pending->begin(), pending->end(), [&hashes, mask](size_t a, size_t b) {
+      return std::make_pair(hashes[a] & mask, a) < std::make_pair(hashes[b] & mask, b);
+    });
+    for (size_t idx : *pending) {
+      grouped.emplace_back(directory.GetBucketPageId(hashes[idx] & mask), idx);
+    }
+  }
+  header_page->RUnlatch();
+
+  // 再按bucket page分组，同一个bucket内保持原来的顺序
+  std::sort(grouped.begin(), grouped.end());
+  bucket_page_ids->resize(grouped.size());
+  for (size_t i = 0; i < grouped.size(); i++) {
+    (*bucket_page_ids)[i] = grouped[i].first;
+    (*pending)[i] = grouped[i].second;
+  }
+  return header_version;
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
-  Page *bucket_page = FetchBucketPage(bucket_page_id);
-  bucket_page->WLatch();
+  // 不分裂的插入只锁bucket，不同bucket的插入互不影响
+  uint32_t hash = Hash(key);
+  Page *bucket_page = LatchBucketPage(hash, true);
+  page_id_t bucket_page_id = bucket_page->GetPageId();
   HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
 
   // 如果bucket没满，直接插入即可
   if (!bucket->IsFull()) {
-    bool ret = bucket->Insert(key, value, comparator_);
+    bool ret = bucket->Insert(key, value, hash, comparator_);
     bucket_page->WUnlatch();
-    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.RUnlock();
+    UnpinPage(bucket_page_id, true);
     return ret;
   }
   // 满了要扩容
   bucket_page->WUnlatch();
-  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, false));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-  table_latch_.RUnlock();
+  UnpinPage(bucket_page_id, false);
   return SplitInsert(transaction, key, value);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  table_latch_.WLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  int64_t split_bucket_index = KeyToDirectoryIndex(key, dir_page);
-  uint32_t split_bucket_depth = dir_page->GetLocalDepth(split_bucket_index);
+  // 分裂要独占directory，同时也让乐观读的版本号失效
+  Page *header_page = FetchHeaderPage();
+  header_page->WLatch();
+  // 顺便重试之前没删掉的页面
+  DeletePages({});
+  HashTableDirectory directory(buffer_pool_manager_, header_page);
+  uint32_t hash = Hash(key);
+  uint32_t split_bucket_index = hash & directory.GetGlobalDepthMask();
+  uint32_t split_bucket_depth = directory.GetLocalDepth(split_bucket_index);
+  page_id_t split_bucket_page_id = directory.GetBucketPageId(split_bucket_index);
+  Page *split_bucket_page = FetchBucketPage(split_bucket_page_id);
+  split_bucket_page->WLatch();
+  HASH_TABLE_BUCKET_TYPE *split_bucket = GetBucketPageData(split_bucket_page);
 
+  // 放锁之后等directory写锁期间，别的线程可能已经分裂过或者删掉了数据，这时直接插入
   // 容量满了，不能扩了
-  if (split_bucket_depth >= MAX_BUCKET_DEPTH) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
-    return false;
+  if (!split_bucket->IsFull() || split_bucket_depth >= MAX_GLOBAL_DEPTH) {
+    bool ret = !split_bucket->IsFull() && split_bucket->Insert(key, value, hash, comparator_);
+    split_bucket_page->WUnlatch();
+    header_page->WUnlatch();
+    UnpinPage(split_bucket_page_id, ret);
+    UnpinPage(header_page_id_, false);
+    return ret;
   }
 
   // 看看Directory需不需要扩容
-  if (split_bucket_depth == dir_page->GetGlobalDepth()) {
-    dir_page->IncrGlobalDepth();
+  if (split_bucket_depth == directory.GetGlobalDepth()) {
+    directory.IncrGlobalDepth();
   }
 
   // 增加local depth
-  dir_page->IncrLocalDepth(split_bucket_index);
+  directory.IncrLocalDepth(split_bucket_index);
+  uint32_t local_depth = directory.GetLocalDepth(split_bucket_index);
 
-  // 获取当前bucket，先将数据保存下来，然后重新初始化它
-  page_id_t split_bucket_page_id = KeyToPageId(key, dir_page);
-  Page *split_bucket_page = FetchBucketPage(split_bucket_page_id);
-  split_bucket_page->WLatch();
-  HASH_TABLE_BUCKET_TYPE *split_bucket = GetBucketPageData(split_bucket_page);
+  // 先将当前bucket的数据保存下来，然后重新初始化它
   uint32_t origin_array_size = split_bucket->NumReadable();
   MappingType *origin_array = split_bucket->GetArrayCopy();
   split_bucket->Reset();
@@ -245,86 +546,124 @@ bool HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
   assert(image_bucket_page != nullptr);
   image_bucket_page->WLatch();
   HASH_TABLE_BUCKET_TYPE *image_bucket = GetBucketPageData(image_bucket_page);
-  uint32_t split_image_bucket_index = dir_page->GetSplitImageIndex(split_bucket_index);
-  dir_page->SetLocalDepth(split_image_bucket_index, dir_page->GetLocalDepth(split_bucket_index));
-  dir_page->SetBucketPageId(split_image_bucket_index, image_bucket_page_id);
+  uint32_t split_image_bucket_index = directory.GetSplitImageIndex(split_bucket_index);
 
   // 重新插入数据
+  // 两个bucket只差第local_depth - 1位，和split bucket这一位相同的留下，不同的去image bucket
+  uint32_t high_bit = 1 << (local_depth - 1);
   for (uint32_t i = 0; i < origin_array_size; i++) {
-    uint32_t target_bucket_index = Hash(origin_array[i].first) & dir_page->GetLocalDepthMask(split_bucket_index);
-    page_id_t target_bucket_index_page = dir_page->GetBucketPageId(target_bucket_index);
-    assert(target_bucket_index_page == split_bucket_page_id || target_bucket_index_page == image_bucket_page_id);
-    // 这里根据新计算的hash结果决定插入哪个bucket
-    if (target_bucket_index_page == split_bucket_page_id) {
-      assert(split_bucket->Insert(origin_array[i].first, origin_array[i].second, comparator_));
-    } else {
-      assert(image_bucket->Insert(origin_array[i].first, origin_array[i].second, comparator_));
-    }
+    const auto &[origin_key, origin_value] = origin_array[i];
+    uint32_t origin_hash = Hash(origin_key);
+    HASH_TABLE_BUCKET_TYPE *bucket =
+        (origin_hash & high_bit) == (split_bucket_index & high_bit) ? split_bucket : image_bucket;
+    [[maybe_unused]] bool inserted = bucket->Insert(origin_key, origin_value, origin_hash, comparator_);
+    assert(inserted);
   }
   delete[] origin_array;
 
   // 将所有同一级的bucket设置为相同的local depth和page
-  uint32_t diff = 1 << dir_page->GetLocalDepth(split_bucket_index);
-  for (uint32_t i = split_bucket_index; i >= diff; i -= diff) {
-    dir_page->SetBucketPageId(i, split_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
-  }
-  for (uint32_t i = split_bucket_index; i < dir_page->Size(); i += diff) {
-    dir_page->SetBucketPageId(i, split_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
-  }
-  for (uint32_t i = split_image_bucket_index; i >= diff; i -= diff) {
-    dir_page->SetBucketPageId(i, image_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
+  // 下标按顺序递增，跨directory page时每页只取一次
+  uint32_t diff = 1 << local_depth;
+  for (uint32_t i = split_bucket_index & (diff - 1); i < directory.Size(); i += diff) {
+    directory.SetBucketPageId(i, split_bucket_page_id);
+    directory.SetLocalDepth(i, local_depth);
   }
-  for (uint32_t i = split_image_bucket_index; i < dir_page->Size(); i += diff) {
-    dir_page->SetBucketPageId(i, image_bucket_page_id);
-    dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(split_bucket_index));
+  for (uint32_t i = split_image_bucket_index & (diff - 1); i < directory.Size(); i += diff) {
+    directory.SetBucketPageId(i, image_bucket_page_id);
+    directory.SetLocalDepth(i, local_depth);
   }
 
   split_bucket_page->WUnlatch();
   image_bucket_page->WUnlatch();
-  // Unpin
-  assert(buffer_pool_manager_->UnpinPage(split_bucket_page_id, true));
-  assert(buffer_pool_manager_->UnpinPage(image_bucket_page_id, true));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), true));
+  header_page->WUnlatch();
+  // Unpin，三个页面一起放
+  [[maybe_unused]] bool unpinned = buffer_pool_manager_->UnpinPages(
+      {{split_bucket_page_id, true}, {image_bucket_page_id, true}, {header_page_id_, true}});
+  assert(unpinned);
 
-  table_latch_.WUnlock();
   // 最后重新尝试插入
   return Insert(transaction, key, value);
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+size_t HASH_TABLE_TYPE::InsertBatch(Transaction *transaction,
+                                    const std::vector<std::pair<KeyType, ValueType>> &entries) {
+  std::vector<uint32_t> hashes(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    hashes[i] = Hash(entries[i].first);
+  }
+  std::vector<size_t> pending(entries.size());
+  std::iota(pending.begin(), pending.end(), 0);
+
+  Page *header_page = FetchHeaderPage();
+  size_t inserted = 0;
+  // 不限制轮数：只有directory变了才会重新分组，而directory变了说明有分裂或合并完成了
+  while (!pending.empty()) {
+    std::vector<page_id_t> bucket_page_ids;
+    uint64_t header_version = GroupByBucket(header_page, hashes, &pending, &bucket_page_ids);
+    std::vector<size_t> retry;
+    for (size_t begin = 0, end; begin < pending.size(); begin = end) {
+      page_id_t bucket_page_id = bucket_page_ids[begin];
+      end = begin + 1;
+      while (end < pending.size() && bucket_page_ids[end] == bucket_page_id) {
+        end++;
+      }
+      if (!retry.empty()) {
+        retry.insert(retry.end(), pending.begin() + begin, pending.begin() + end);
+        continue;
+      }
+      if (end < pending.size()) {
+        buffer_pool_manager_->PrefetchPage(bucket_page_ids[end]);
+      }
+      Page *bucket_page = FetchBucketPage(bucket_page_id);
+      bucket_page->WLatch();
+      if (!header_page->ValidateOptimisticRead(header_version)) {
+        bucket_page->WUnlatch();
+        UnpinPage(bucket_page_id, false);
+        retry.insert(retry.end(), pending.begin() + begin, pending.begin() + end);
+        continue;
+      }
+      HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
+      size_t i = begin;
+      for (; i < end && !bucket->IsFull(); i++) {
+        const auto &[key, value] = entries[pending[i]];
+        inserted += bucket->Insert(key, value, hashes[pending[i]], comparator_) ? 1 : 0;
+      }
+      bucket_page->WUnlatch();
+      UnpinPage(bucket_page_id, i > begin);
+      if (i < end) {
+        // bucket满了，这一个走分裂的路径。分裂改了directory，剩下的都要重新分组
+        inserted += SplitInsert(transaction, entries[pending[i]].first, entries[pending[i]].second) ? 1 : 0;
+        retry.insert(retry.end(), pending.begin() + i + 1, pending.begin() + end);
+      }
+    }
+    pending = std::move(retry);
+  }
+  UnpinPage(header_page_id_, false);
+  return inserted;
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page);
-  uint32_t bucket_index = KeyToDirectoryIndex(key, dir_page);
-  Page *bucket_page = FetchBucketPage(bucket_page_id);
-  bucket_page->WLatch();
+  uint32_t hash = Hash(key);
+  Page *bucket_page = LatchBucketPage(hash, true);
+  page_id_t bucket_page_id = bucket_page->GetPageId();
   HASH_TABLE_BUCKET_TYPE *bucket = GetBucketPageData(bucket_page);
 
   // 删除Key-value
-  bool ret = bucket->Remove(key, value, comparator_);
+  bool ret = bucket->Remove(key, value, hash, comparator_);
+  bool empty = bucket->IsEmpty();
+  bucket_page->WUnlatch();
+  // Unpin
+  UnpinPage(bucket_page_id, ret);
 
   // 为空则合并
-  if (bucket->IsEmpty()) {
-    bucket_page->WUnlatch();
-    // Unpin
-    assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.RUnlock();
-    Merge(transaction, bucket_index);
-    return ret;
+  if (empty) {
+    Merge(transaction, key);
   }
-  bucket_page->WUnlatch();
-  // Unpin
-  assert(buffer_pool_manager_->UnpinPage(bucket_page_id, true));
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-  table_latch_.RUnlock();
   return ret;
 }
 
@@ -332,67 +671,85 @@ bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
  * MERGE
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void HASH_TABLE_TYPE::Merge(Transaction *transaction, uint32_t target_bucket_index) {
-  table_latch_.WLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  page_id_t target_bucket_page_id = dir_page->GetBucketPageId(target_bucket_index);
-  uint32_t image_bucket_index = dir_page->GetSplitImageIndex(target_bucket_index);
+void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key) {
+  // 合并要独占directory，同时也让乐观读的版本号失效。放锁之后directory可能变了，bucket要重新定位
+  Page *header_page = FetchHeaderPage();
+  header_page->WLatch();
+  // 和SplitInsert一样，顺便重试之前没删掉的页面
+  DeletePages({});
+  HashTableDirectory directory(buffer_pool_manager_, header_page);
+  uint32_t target_bucket_index = KeyToDirectoryIndex(key, &directory);
+  page_id_t target_bucket_page_id = directory.GetBucketPageId(target_bucket_index);
 
   // local depth为0说明已经最小了，不收缩
-  uint32_t local_depth = dir_page->GetLocalDepth(target_bucket_index);
+  uint32_t local_depth = directory.GetLocalDepth(target_bucket_index);
   if (local_depth == 0) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
+    header_page->WUnlatch();
+    UnpinPage(header_page_id_, false);
     return;
   }
 
   // 如果该bucket与其split image深度不同，也不收缩
-  if (local_depth != dir_page->GetLocalDepth(image_bucket_index)) {
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
+  uint32_t image_bucket_index = directory.GetSplitImageIndex(target_bucket_index);
+  if (local_depth != directory.GetLocalDepth(image_bucket_index)) {
+    header_page->WUnlatch();
+    UnpinPage(header_page_id_, false);
     return;
   }
 
-  // 如果target bucket不为空，则不收缩
+  // 如果target bucket不为空，则不收缩。拿到它的锁之后，之前拿到它的插入都已经结束了，
+  // 之后的插入拿不到directory，不会再找到它
   Page *target_bucket_page = FetchBucketPage(target_bucket_page_id);
   target_bucket_page->RLatch();
   HASH_TABLE_BUCKET_TYPE *target_bucket = GetBucketPageData(target_bucket_page);
   if (!target_bucket->IsEmpty()) {
     target_bucket_page->RUnlatch();
-    assert(buffer_pool_manager_->UnpinPage(target_bucket_page_id, false));
-    assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), false));
-    table_latch_.WUnlock();
+    header_page->WUnlatch();
+    UnpinPage(target_bucket_page_id, false);
+    UnpinPage(header_page_id_, false);
     return;
   }
 
   target_bucket_page->RUnlatch();
-  // 删除target bucket，此时该bucket已经为空
-  assert(buffer_pool_manager_->UnpinPage(target_bucket_page_id, false));
-  assert(buffer_pool_manager_->DeletePage(target_bucket_page_id));
-
-  // 设置target bucket的page为split image的page，即合并target和split
-  page_id_t image_bucket_page_id = dir_page->GetBucketPageId(image_bucket_index);
-  dir_page->SetBucketPageId(target_bucket_index, image_bucket_page_id);
-  dir_page->DecrLocalDepth(target_bucket_index);
-  dir_page->DecrLocalDepth(image_bucket_index);
-  assert(dir_page->GetLocalDepth(target_bucket_index) == dir_page->GetLocalDepth(image_bucket_index));
-
-  // 遍历整个directory，将所有指向target bucket page的bucket全部重新指向split image bucket的page
-  for (uint32_t i = 0; i < dir_page->Size(); i++) {
-    if (dir_page->GetBucketPageId(i) == target_bucket_page_id || dir_page->GetBucketPageId(i) == image_bucket_page_id) {
-      dir_page->SetBucketPageId(i, image_bucket_page_id);
-      dir_page->SetLocalDepth(i, dir_page->GetLocalDepth(target_bucket_index));
-    }
+  // target bucket此时已经为空，从directory中去掉之后删除
+  UnpinPage(target_bucket_page_id, false);
+  std::vector<page_id_t> removed_page_ids{target_bucket_page_id};
+
+  // 合并之后，低local_depth - 1位和target相同的下标都指向split image bucket的page
+  // 按步长遍历，不用扫整个directory
+  page_id_t image_bucket_page_id = directory.GetBucketPageId(image_bucket_index);
+  uint32_t diff = 1 << (local_depth - 1);
+  for (uint32_t i = target_bucket_index & (diff - 1); i < directory.Size(); i += diff) {
+    directory.SetBucketPageId(i, image_bucket_page_id);
+    directory.SetLocalDepth(i, local_depth - 1);
   }
 
   // 尝试收缩Directory
   // 这里要循环，不能只收缩一次
-  while (dir_page->CanShrink()) {
-    dir_page->DecrGlobalDepth();
+  while (directory.CanShrink()) {
+    std::vector<page_id_t> directory_page_ids = directory.DecrGlobalDepth();
+    removed_page_ids.insert(removed_page_ids.end(), directory_page_ids.begin(), directory_page_ids.end());
   }
+  DeletePages(removed_page_ids);
 
-  assert(buffer_pool_manager_->UnpinPage(dir_page->GetPageId(), true));
-  table_latch_.WUnlock();
+  header_page->WUnlatch();
+  UnpinPage(header_page_id_, true);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::DeletePages(const std::vector<page_id_t> &page_ids) {
+  // 乐观读和放掉directory之后的读者可能正pin着这些页，这时删不掉，留到下次分裂或合并时再删
+  deferred_deletes_.insert(deferred_deletes_.end(), page_ids.begin(), page_ids.end());
+  auto iter = std::remove_if(deferred_deletes_.begin(), deferred_deletes_.end(),
+                             [this](page_id_t page_id) { return buffer_pool_manager_->DeletePage(page_id); });
+  deferred_deletes_.erase(iter, deferred_deletes_.end());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::UnpinPage(page_id_t page_id, bool is_dirty) {
+  // 调用要放在assert外面，否则NDEBUG下整个调用都没了，页面永远pin着
+  [[maybe_unused]] bool unpinned = buffer_pool_manager_->UnpinPage(page_id, is_dirty);
+  assert(unpinned);
 }
 
 /*****************************************************************************
@@ -400,11 +757,11 @@ void HASH_TABLE_TYPE::Merge(Transaction *transaction, uint32_t target_bucket_ind
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 uint32_t HASH_TABLE_TYPE::GetGlobalDepth() {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  uint32_t global_depth = dir_page->GetGlobalDepth();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
+  Page *header_page = FetchHeaderPage();
+  header_page->RLatch();
+  uint32_t global_depth = GetHeaderPageData(header_page)->GetGlobalDepth();
+  header_page->RUnlatch();
+  UnpinPage(header_page_id_, false);
   return global_depth;
 }
 
@@ -413,11 +770,14 @@ uint32_t HASH_TABLE_TYPE::GetGlobalDepth() {
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_TYPE::VerifyIntegrity() {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
-  dir_page->VerifyIntegrity();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
+  Page *header_page = FetchHeaderPage();
+  header_page->RLatch();
+  {
+    HashTableDirectory directory(buffer_pool_manager_, header_page);
+    directory.VerifyIntegrity();
+  }
+  header_page->RUnlatch();
+  UnpinPage(header_page_id_, false);
 }
 
 /*****************************************************************************
@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory.cpp
+//
+// Identification: src/container/hash/hash_table_directory.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "container/hash/hash_table_directory.h"
+
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+HashTableDirectory::HashTableDirectory(BufferPoolManager *buffer_pool_manager, Page *header_page)
+    : buffer_pool_manager_(buffer_pool_manager),
+      header_(reinterpret_cast<HashTableDirectoryHeaderPage *>(header_page->GetData())) {}
+
+HashTableDirectory::~HashTableDirectory() { ReleaseDirectoryPage(); }
+
+uint32_t HashTableDirectory::GetGlobalDepth() const { return header_->GetGlobalDepth(); }
+
+uint32_t HashTableDirectory::GetGlobalDepthMask() const { return (1 << header_->GetGlobalDepth()) - 1; }
+
+uint32_t HashTableDirectory::Size() const { return 1 << header_->GetGlobalDepth(); }
+
+page_id_t HashTableDirectory::GetBucketPageId(uint32_t bucket_idx) {
+  return DirectoryPageOf(bucket_idx, false)->GetBucketPageId(SlotOf(bucket_idx));
+}
+
+void HashTableDirectory::SetBucketPageId(uint32_t bucket_idx, page_id_t bucket_page_id) {
+  DirectoryPageOf(bucket_idx, true)->SetBucketPageId(SlotOf(bucket_idx), bucket_page_id);
+}
+
+uint32_t HashTableDirectory::GetLocalDepth(uint32_t bucket_idx) {
+  return DirectoryPageOf(bucket_idx, false)->GetLocalDepth(SlotOf(bucket_idx));
+}
+
+void HashTableDirectory::SetLocalDepth(uint32_t bucket_idx, uint8_t local_depth) {
+  DirectoryPageOf(bucket_idx, true)->SetLocalDepth(SlotOf(bucket_idx), local_depth);
+}
+
+void HashTableDirectory::IncrLocalDepth(uint32_t bucket_idx) {
+  DirectoryPageOf(bucket_idx, true)->IncrLocalDepth(SlotOf(bucket_idx));
+}
+
+void HashTableDirectory::DecrLocalDepth(uint32_t bucket_idx) {
+  DirectoryPageOf(bucket_idx, true)->DecrLocalDepth(SlotOf(bucket_idx));
+}
+
+uint32_t HashTableDirectory::GetLocalDepthMask(uint32_t bucket_idx) { return (1 << GetLocalDepth(bucket_idx)) - 1; }
+
+uint32_t HashTableDirectory::GetSplitImageIndex(uint32_t bucket_idx) {
+  return bucket_idx ^ (1 << (GetLocalDepth(bucket_idx) - 1));
+}
+
+void HashTableDirectory::IncrGlobalDepth() {
+  uint32_t global_depth = header_->GetGlobalDepth();
+  assert(global_depth < MAX_GLOBAL_DEPTH);
+  // 一个directory page还装得下，在页内复制一份即可
+  if (global_depth < MAX_BUCKET_DEPTH) {
+    DirectoryPageOf(0, true)->IncrGlobalDepth();
+    header_->SetGlobalDepth(global_depth + 1);
+    return;
+  }
+
+  // 否则directory page的数量翻倍：第i页复制到第i + n页，下标j + 2^global_depth正好落在新页的同一个位置
+  ReleaseDirectoryPage();
+  uint32_t num_pages = header_->NumDirectoryPages();
+  for (uint32_t i = 0; i < num_pages; i++) {
+    page_id_t page_id = header_->GetDirectoryPageId(i);
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    assert(page != nullptr);
+    page_id_t image_page_id;
+    Page *image_page = buffer_pool_manager_->NewPage(&image_page_id);
+    assert(image_page != nullptr);
+    memcpy(image_page->GetData(), page->GetData(), PAGE_SIZE);
+    auto *directory_page = reinterpret_cast<HashTableDirectoryPage *>(page->GetData());
+    auto *image_directory_page = reinterpret_cast<HashTableDirectoryPage *>(image_page->GetData());
+    image_directory_page->SetPageId(image_page_id);
+    directory_page->SetGlobalDepth(global_depth + 1);
+    image_directory_page->SetGlobalDepth(global_depth + 1);
+    header_->SetDirectoryPageId(num_pages + i, image_page_id);
+    [[maybe_unused]] bool unpinned = buffer_pool_manager_->UnpinPages({{page_id, true}, {image_page_id, true}});
+    assert(unpinned);
+  }
+  header_->SetGlobalDepth(global_depth + 1);
+}
+
+std::vector<page_id_t> HashTableDirectory::DecrGlobalDepth() {
+  uint32_t global_depth = header_->GetGlobalDepth();
+  assert(global_depth > 0);
+  if (global_depth <= MAX_BUCKET_DEPTH) {
+    DirectoryPageOf(0, true)->DecrGlobalDepth();
+    header_->SetGlobalDepth(global_depth - 1);
+    return {};
+  }
+
+  // 后一半directory page和前一半完全相同，从header page中去掉，交给调用者删除
+  // 乐观读者可能正pin着其中的页，这时删不掉，调用者要能之后再删
+  ReleaseDirectoryPage();
+  uint32_t num_pages = header_->NumDirectoryPages();
+  std::vector<page_id_t> removed_page_ids;
+  for (uint32_t i = num_pages / 2; i < num_pages; i++) {
+    removed_page_ids.push_back(header_->GetDirectoryPageId(i));
+    header_->SetDirectoryPageId(i, INVALID_PAGE_ID);
+  }
+  for (uint32_t i = 0; i < num_pages / 2; i++) {
+    page_id_t page_id = header_->GetDirectoryPageId(i);
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    assert(page != nullptr);
+    reinterpret_cast<HashTableDirectoryPage *>(page->GetData())->SetGlobalDepth(global_depth - 1);
+    [[maybe_unused]] bool unpinned = buffer_pool_manager_->UnpinPage(page_id, true);
+    assert(unpinned);
+  }
+  header_->SetGlobalDepth(global_depth - 1);
+  return removed_page_ids;
+}
+
+bool HashTableDirectory::CanShrink() {
+  // 和HashTableDirectoryPage::CanShrink一样，只是要按顺序跨页遍历
+  uint32_t global_depth = header_->GetGlobalDepth();
+  for (uint32_t i = 0; i < Size(); i++) {
+    if (GetLocalDepth(i) == global_depth) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HashTableDirectory::VerifyIntegrity() {
+  std::unordered_map<page_id_t, uint32_t> page_id_to_count;
+  std::unordered_map<page_id_t, uint32_t> page_id_to_ld;
+  uint32_t global_depth = header_->GetGlobalDepth();
+
+  for (uint32_t curr_idx = 0; curr_idx < Size(); curr_idx++) {
+    page_id_t curr_page_id = GetBucketPageId(curr_idx);
+    uint32_t curr_ld = GetLocalDepth(curr_idx);
+    assert(curr_ld <= global_depth);
+    ++page_id_to_count[curr_page_id];
+
+    if (page_id_to_ld.count(curr_page_id) > 0 && curr_ld != page_id_to_ld[curr_page_id]) {
+      LOG_WARN("Verify Integrity: curr_local_depth: %u, old_local_depth %u, for page_id: %u", curr_ld,
+               page_id_to_ld[curr_page_id], curr_page_id);
+      assert(curr_ld == page_id_to_ld[curr_page_id]);
+    } else {
+      page_id_to_ld[curr_page_id] = curr_ld;
+    }
+  }
+
+  for (const auto &[curr_page_id, curr_count] : page_id_to_count) {
+    uint32_t required_count = 0x1 << (global_depth - page_id_to_ld[curr_page_id]);
+    if (curr_count != required_count) {
+      LOG_WARN("Verify Integrity: curr_count: %u, required_count %u, for page_id: %u", curr_count, required_count,
+               curr_page_id);
+      assert(curr_count == required_count);
+    }
+  }
+}
+
+HashTableDirectoryPage *HashTableDirectory::DirectoryPageOf(uint32_t bucket_idx, bool for_write) {
+  assert(bucket_idx < Size());
+  uint32_t directory_idx = bucket_idx >> MAX_BUCKET_DEPTH;
+  if (directory_page_ == nullptr || directory_idx != directory_idx_) {
+    ReleaseDirectoryPage();
+    directory_page_ = buffer_pool_manager_->FetchPage(header_->GetDirectoryPageId(directory_idx));
+    assert(directory_page_ != nullptr);
+    directory_idx_ = directory_idx;
+  }
+  is_dirty_ = is_dirty_ || for_write;
+  return reinterpret_cast<HashTableDirectoryPage *>(directory_page_->GetData());
+}
+
+void HashTableDirectory::ReleaseDirectoryPage() {
+  if (directory_page_ == nullptr) {
+    return;
+  }
+  // 调用不能放在assert里，NDEBUG下会被整个去掉
+  [[maybe_unused]] bool unpinned = buffer_pool_manager_->UnpinPage(directory_page_->GetPageId(), is_dirty_);
+  assert(unpinned);
+  directory_page_ = nullptr;
+  is_dirty_ = false;
+}
+
+}  // namespace bustub
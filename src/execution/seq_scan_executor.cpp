@@ -12,6 +12,8 @@
 
 #include "execution/executors/seq_scan_executor.h"
 
+#include <algorithm>
+
 namespace bustub {
 
 SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNode *plan)
@@ -26,7 +28,13 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 
 void SeqScanExecutor::Init() {
   table_heap_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid())->table_.get();
-  iter_ = table_heap_->Begin(exec_ctx_->GetTransaction());
+  // 环最多占缓冲池的1/8。迭代器取下一页时当前页还被pin着，环至少要有两帧，否则直接走共享缓冲池
+  BufferPoolManager *bpm = exec_ctx_->GetBufferPoolManager();
+  size_t ring_size = std::min(static_cast<size_t>(SCAN_RING_SIZE), bpm->GetPoolSize() / 8);
+  if (strategy_ == nullptr && ring_size >= 2) {
+    strategy_ = std::make_unique<BufferAccessStrategy>(bpm, ring_size);
+  }
+  iter_ = table_heap_->Begin(exec_ctx_->GetTransaction(), strategy_.get());
 }
 
 bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
@@ -0,0 +1,61 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.h
+//
+// Identification: src/include/buffer/buffer_access_strategy.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <deque>
+
+#include "common/config.h"
+
+namespace bustub {
+
+class BufferPoolManager;
+
+/**
+ * BufferAccessStrategy is a small private ring of frames used by bulk readers such as sequential scans.
+ *
+ * Every page the reader has to load from disk is remembered in the ring. Once the ring is full, the oldest page is
+ * discarded from the pool again if it is unpinned and clean, and its frame goes back to the free list where the
+ * reader's next miss picks it up. A scan over a table of any size therefore occupies at most ring_size frames of the
+ * shared pool and leaves everyone else's working set alone. Pages that were already resident, or that someone else is
+ * still using, are never taken away from the shared pool.
+ *
+ * A strategy belongs to a single reader and is not thread-safe.
+ */
+class BufferAccessStrategy {
+ public:
+  /**
+   * Create a new BufferAccessStrategy.
+   * @param bpm the buffer pool the reader fetches its pages from
+   * @param ring_size the maximum number of frames the reader may occupy
+   */
+  BufferAccessStrategy(BufferPoolManager *bpm, size_t ring_size);
+
+  /**
+   * Called by the buffer pool after it has read a page from disk on behalf of the reader.
+   * @param page_id id of the page that was loaded into the pool
+   */
+  void RecordLoad(page_id_t page_id);
+
+  /** @return the maximum number of frames the reader may occupy */
+  size_t GetRingSize() const { return ring_size_; }
+
+ private:
+  /** 扫描所使用的缓冲池，一定是最外层的BPM，这样换出的页面才能被正确路由 */
+  BufferPoolManager *bpm_;
+  /** 环的大小 */
+  size_t ring_size_;
+  /** 由本次扫描读入缓冲池的页面，队头最老 */
+  std::deque<page_id_t> ring_;
+};
+
+}  // namespace bustub
@@ -15,14 +15,20 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "buffer/buffer_pool_stats.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
+#include "storage/page/page_guard.h"
 
 namespace bustub {
 
+class BufferAccessStrategy;
+
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
  */
@@ -84,9 +90,118 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Fetch the requested page on behalf of a bulk reader. Pages that have to be read from disk are recycled through
+   * the reader's ring instead of filling up the shared pool.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of the reader, nullptr behaves exactly like FetchPage
+   * @return the requested page
+   */
+  Page *FetchPageWithStrategy(page_id_t page_id, BufferAccessStrategy *strategy) {
+    return FetchPgImp(page_id, strategy);
+  }
+
+  /**
+   * Drop an unpinned, clean page from the buffer pool right away and return its frame to the free list.
+   * @param page_id id of page to be discarded
+   * @return false if the page is not resident, pinned or dirty, true otherwise
+   */
+  bool DiscardPage(page_id_t page_id) { return DiscardPgImp(page_id); }
+
+  /**
+   * Start reading a page into the buffer pool in the background. The page is not pinned for the caller; a later
+   * FetchPage finds it resident, waiting for the read to finish if it is still in flight.
+   * @param page_id id of page to be prefetched
+   * @param strategy the ring of a bulk reader the page is read for, may be nullptr
+   * @return false if no frame could be found for the page, true if it is resident or being read
+   */
+  bool PrefetchPage(page_id_t page_id, BufferAccessStrategy *strategy = nullptr) {
+    return PrefetchPgImp(page_id, strategy);
+  }
+
+  /**
+   * Start reading a range of consecutive pages into the buffer pool in the background.
+   * @param first_page_id id of the first page to be prefetched
+   * @param num_pages number of pages to be prefetched
+   * @return the number of pages that are resident or being read
+   */
+  size_t PrefetchRange(page_id_t first_page_id, size_t num_pages) {
+    size_t num_issued = 0;
+    for (size_t i = 0; i < num_pages; i++) {
+      if (PrefetchPgImp(first_page_id + static_cast<page_id_t>(i), nullptr)) {
+        num_issued++;
+      }
+    }
+    return num_issued;
+  }
+
+  /**
+   * Pin the requested page only if it is resident and fully read, never waiting for disk I/O. This is meant for
+   * peeking at a page, e.g. to follow a link while prefetching, and does not count as an access to the replacer.
+   * @param page_id id of page to be fetched
+   * @return the requested page, nullptr if it is not resident or its read is still in flight
+   */
+  Page *FetchPageIfResident(page_id_t page_id) { return FetchResidentPgImp(page_id); }
+
+  /**
+   * Fetch the requested page, pinned until the returned guard is dropped.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of a bulk reader, may be nullptr
+   * @return the guard of the page, invalid if no frame could be found for it
+   */
+  BasicPageGuard FetchPageBasic(page_id_t page_id, BufferAccessStrategy *strategy = nullptr) {
+    return BasicPageGuard(this, FetchPgImp(page_id, strategy));
+  }
+
+  /**
+   * Fetch the requested page, pinned and read latched until the returned guard is dropped.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of a bulk reader, may be nullptr
+   * @return the guard of the page, invalid if no frame could be found for it
+   */
+  ReadPageGuard FetchPageRead(page_id_t page_id, BufferAccessStrategy *strategy = nullptr) {
+    return ReadPageGuard(this, FetchPgImp(page_id, strategy));
+  }
+
+  /**
+   * Fetch the requested page, pinned and write latched until the returned guard is dropped.
+   * @param page_id id of page to be fetched
+   * @return the guard of the page, invalid if no frame could be found for it
+   */
+  WritePageGuard FetchPageWrite(page_id_t page_id) { return WritePageGuard(this, FetchPgImp(page_id, nullptr)); }
+
+  /**
+   * Create a new page, pinned until the returned guard is dropped.
+   * @param[out] page_id id of created page
+   * @return the guard of the page, invalid if no new page could be created
+   */
+  BasicPageGuard NewPageGuarded(page_id_t *page_id) { return BasicPageGuard(this, NewPgImp(page_id)); }
+
+  /**
+   * Fetch several pages at once, latching each part of the buffer pool only once for the whole batch. Pages that have
+   * to be read from disk are all installed before any of them is read, and runs of consecutive page ids are read with
+   * a single vectored read.
+   * @param page_ids ids of pages to be fetched
+   * @return the requested pages in the order of page_ids, nullptr for each page no frame could be found for
+   */
+  std::vector<Page *> FetchPages(const std::vector<page_id_t> &page_ids) { return FetchPgsImp(page_ids); }
+
+  /**
+   * Unpin several pages at once, latching each part of the buffer pool only once for the whole batch.
+   * @param pages (page id, is dirty) pairs of the pages to be unpinned
+   * @return false if the pin count of any of the pages is <= 0 before this call, true otherwise
+   */
+  bool UnpinPages(const std::vector<std::pair<page_id_t, bool>> &pages) { return UnpinPgsImp(pages); }
+
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /** @return the counters and latency histograms of the whole buffer pool */
+  virtual BufferPoolStats GetStats() const = 0;
+
+  /** @return the counters and latency histograms of every buffer pool instance, in instance order */
+  virtual std::vector<BufferPoolStats> GetInstanceStats() const { return {GetStats()}; }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -108,6 +223,14 @@ class BufferPoolManager {
    */
   virtual Page *FetchPgImp(page_id_t page_id) = 0;
 
+  /**
+   * Fetch the requested page from the buffer pool, reporting a read from disk to the access strategy.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of a bulk reader, may be nullptr
+   * @return the requested page
+   */
+  virtual Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) = 0;
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -141,5 +264,41 @@ class BufferPoolManager {
    * Flushes all the pages in the buffer pool to disk.
    */
   virtual void FlushAllPgsImp() = 0;
+
+  /**
+   * Drop an unpinned, clean page from the buffer pool and return its frame to the free list.
+   * @param page_id id of page to be discarded
+   * @return false if the page is not resident, pinned or dirty, true otherwise
+   */
+  virtual bool DiscardPgImp(page_id_t page_id) = 0;
+
+  /**
+   * Start reading a page into the buffer pool in the background.
+   * @param page_id id of page to be prefetched
+   * @param strategy the ring of a bulk reader the page is read for, may be nullptr
+   * @return false if no frame could be found for the page, true if it is resident or being read
+   */
+  virtual bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) = 0;
+
+  /**
+   * Pin the requested page only if it is resident and fully read.
+   * @param page_id id of page to be fetched
+   * @return the requested page, nullptr if it is not resident or its read is still in flight
+   */
+  virtual Page *FetchResidentPgImp(page_id_t page_id) = 0;
+
+  /**
+   * Fetch several pages from the buffer pool.
+   * @param page_ids ids of pages to be fetched
+   * @return the requested pages in the order of page_ids, nullptr for each page no frame could be found for
+   */
+  virtual std::vector<Page *> FetchPgsImp(const std::vector<page_id_t> &page_ids) = 0;
+
+  /**
+   * Unpin several pages from the buffer pool.
+   * @param pages (page id, is dirty) pairs of the pages to be unpinned
+   * @return false if the pin count of any of the pages is <= 0 before this call, true otherwise
+   */
+  virtual bool UnpinPgsImp(const std::vector<std::pair<page_id_t, bool>> &pages) = 0;
 };
 }  // namespace bustub
@@ -12,11 +12,26 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <future>  // NOLINT
 #include <list>
-#include <mutex>  // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "buffer/buffer_access_strategy.h"
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_allocator.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
@@ -26,16 +41,32 @@ namespace bustub {
 
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
+ *
+ * The page table is split into PAGE_TABLE_SHARD_NUM independently latched shards, so threads hitting resident pages
+ * only contend when their pages hash to the same shard. Disk I/O is never performed while holding a shard latch: a
+ * page being read in stays in the page table marked as I/O pending, and concurrent fetches of the same page wait for
+ * that single read instead of issuing their own.
+ *
+ * Prefetches install their page the same way and hand the read over to a prefetch thread, which is started on the
+ * first prefetch and holds a pin on the frame until the read completes.
  */
 class BufferPoolManagerInstance : public BufferPoolManager {
  public:
+  /** Number of independently latched shards of the page table. */
+  static constexpr size_t PAGE_TABLE_SHARD_NUM = 16;
+
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy used to pick victim frames
+   * @param numa_node the NUMA node the frames should live on, -1 to leave it to the kernel
+   * @param max_pool_size the size the pool can be grown to with Resize, the pool cannot grow if it is <= pool_size
    */
-  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU, int numa_node = -1,
+                            size_t max_pool_size = 0);
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
@@ -43,9 +74,14 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param instance_index index of this BPI in the parallel BPM
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy used to pick victim frames
+   * @param numa_node the NUMA node the frames should live on, -1 to leave it to the kernel
+   * @param max_pool_size the size the pool can be grown to with Resize, the pool cannot grow if it is <= pool_size
    */
   BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                            DiskManager *disk_manager, LogManager *log_manager = nullptr);
+                            DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU, int numa_node = -1,
+                            size_t max_pool_size = 0);
 
   /**
    * Destroys an existing BufferPoolManagerInstance.
@@ -55,17 +91,89 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override { return pool_size_; }
 
+  /** @return the size the buffer pool can be grown to */
+  size_t GetMaxPoolSize() const { return max_pool_size_; }
+
+  /**
+   * Grow or shrink the buffer pool while it is in use. Growing hands the added frames to the free list right away.
+   * Shrinking evicts the pages held by the removed frames, writing dirty ones back, and returns their memory to the
+   * operating system. It waits for pinned pages in the removed frames to be unpinned, for at most resize_timeout;
+   * after that the shrink is undone and the pool keeps its old size. Concurrent calls are serialized.
+   * @param pool_size the new size of the buffer pool, between 1 and the maximum pool size
+   * @return false if the size is out of range or a shrink timed out, true otherwise
+   */
+  bool Resize(size_t pool_size);
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
+  /** @return the NUMA node the frames are bound to, -1 if they are not bound */
+  int GetNumaNode() const { return frames_.GetNumaNode(); }
+
+  /**
+   * Creates a new page with an id chosen by the caller instead of this instance's own page id counter. Used by a
+   * parallel BPM that hands out page ids itself.
+   * @param page_id id of the new page, must not be in use
+   * @return nullptr if no new page could be created, otherwise pointer to new page
+   */
+  Page *NewPageWithId(page_id_t page_id);
+
+  /**
+   * Start a background thread that writes back dirty frames at the tail of the replacer ahead of demand, so that
+   * foreground evictions find clean victims. The thread wakes up every background_flush_interval, or earlier when a
+   * foreground eviction had to write a dirty page. Does nothing if the thread is already running.
+   * @param clean_ratio fraction of the pool, taken from the replacer's victim end, that the thread keeps clean
+   */
+  void RunBackgroundFlushThread(double clean_ratio = BACKGROUND_FLUSH_CLEAN_RATIO);
+
+  /**
+   * Stop and join the background flush thread, if it is running.
+   */
+  void StopBackgroundFlushThread();
+
+  /** @return the number of fetches that found their page resident */
+  uint64_t GetNumHits() const { return num_hits_; }
+
+  /** @return the number of fetches that had to read their page from disk */
+  uint64_t GetNumMisses() const { return num_misses_; }
+
+  /** @return the number of frames evicted to make room for another page */
+  uint64_t GetNumEvictions() const { return num_evictions_; }
+
+  /** @return the number of dirty pages that a foreground eviction had to write back itself */
+  uint64_t GetNumForegroundWrites() const { return num_foreground_writes_; }
+
+  /** @return the number of dirty pages written back by the background flush thread */
+  uint64_t GetNumBackgroundWrites() const { return num_background_writes_; }
+
+  /** @return the number of background reads issued by prefetches */
+  uint64_t GetNumPrefetches() const { return num_prefetches_; }
+
+  /** @return the number of times a thread had to wait for a latch held by another thread */
+  uint64_t GetNumLatchContentions() const { return num_latch_contentions_; }
+
+  /** @return the counters and latency histograms of this instance */
+  BufferPoolStats GetStats() const override;
+
  protected:
   /**
-   * Fetch the requested page from the buffer pool.
+   * Fetch the requested page from the buffer pool. If the read from disk throws (a checksum mismatch under
+   * ChecksumPolicy::ENFORCE), the page is taken out of the buffer pool again and the exception is passed on. Fetches
+   * of the same page that were waiting for the read then read the page themselves.
    * @param page_id id of page to be fetched
    * @return the requested page
    */
   Page *FetchPgImp(page_id_t page_id) override;
 
+  /**
+   * Fetch the requested page from the buffer pool, reporting a read from disk to the access strategy.
+   * A failed read is handled as in FetchPgImp(page_id_t).
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of a bulk reader, may be nullptr
+   * @return the requested page
+   */
+  Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -75,7 +183,7 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   bool UnpinPgImp(page_id_t page_id, bool is_dirty) override;
 
   /**
-   * Flushes the target page to disk.
+   * Flushes the target page to disk. With a read-only database file (DiskIOBackend::MMAP) nothing is written.
    * @param page_id id of page to be flushed, cannot be INVALID_PAGE_ID
    * @return false if the page could not be found in the page table, true otherwise
    */
@@ -91,28 +199,67 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /**
    * Deletes a page from the buffer pool.
    * @param page_id id of page to be deleted
-   * @return false if the page exists but could not be deleted, true if the page didn't exist or deletion succeeded
+   * @return false if the page exists but could not be deleted or was never allocated, true if the page didn't exist
+   * in the buffer pool or deletion succeeded
    */
   bool DeletePgImp(page_id_t page_id) override;
 
   /**
-   * Flushes all the pages in the buffer pool to disk.
+   * Flushes all the dirty pages in the buffer pool to disk, in batches of WRITE_BATCH_SIZE pages sorted by page id.
+   * Each batch is written with DiskManager::WritePages, so adjacent pages share one write and the batch one sync.
+   * Clean pages are skipped, and with a read-only database file (DiskIOBackend::MMAP) nothing is written at all.
    */
   void FlushAllPgsImp() override;
 
   /**
-   * Allocate a page on disk.∂
+   * Drop an unpinned, clean page from the buffer pool and return its frame to the free list.
+   * @param page_id id of page to be discarded
+   * @return false if the page is not resident, pinned or dirty, true otherwise
+   */
+  bool DiscardPgImp(page_id_t page_id) override;
+
+  /**
+   * Start reading a page into the buffer pool in the background.
+   * @param page_id id of page to be prefetched
+   * @param strategy the ring of a bulk reader the page is read for, may be nullptr
+   * @return false if no frame could be found for the page, true if it is resident or being read
+   */
+  bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Pin the requested page only if it is resident and fully read.
+   * @param page_id id of page to be fetched
+   * @return the requested page, nullptr if it is not resident or its read is still in flight
+   */
+  Page *FetchResidentPgImp(page_id_t page_id) override;
+
+  /**
+   * Fetch several pages from the buffer pool. If a read from disk throws, the pages that failed are taken out of the
+   * buffer pool again, the pages pinned by this call are unpinned, and the exception is passed on.
+   * @param page_ids ids of pages to be fetched
+   * @return the requested pages in the order of page_ids, nullptr for each page no frame could be found for
+   */
+  std::vector<Page *> FetchPgsImp(const std::vector<page_id_t> &page_ids) override;
+
+  /**
+   * Unpin several pages from the buffer pool.
+   * @param pages (page id, is dirty) pairs of the pages to be unpinned
+   * @return false if the pin count of any of the pages is <= 0 before this call, true otherwise
+   */
+  bool UnpinPgsImp(const std::vector<std::pair<page_id_t, bool>> &pages) override;
+
+  /**
+   * Allocate a page on disk, reusing a page of this instance from the free space map if there is one.
    * @return the id of the allocated page
    */
   page_id_t AllocatePage();
 
   /**
-   * Deallocate a page on disk.
+   * Deallocate a page on disk, handing it to the free space map of the disk manager for reuse.
    * @param page_id id of the page to deallocate
+   * @return false if the page was never allocated, true otherwise
    */
-  void DeallocatePage(__attribute__((unused)) page_id_t page_id) {
-    // This is a no-nop right now without a more complex data structure to track deallocated pages
-  }
+  bool DeallocatePage(page_id_t page_id) { return disk_manager_->DeallocatePage(page_id); }
 
   /**
    * Validate that the page_id being used is accessible to this BPI. This can be used in all of the functions to
@@ -121,8 +268,175 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void ValidatePageId(page_id_t page_id) const;
 
-  /** Number of pages in the buffer pool. */
-  const size_t pool_size_;
+  /**
+   * One shard of the page table.
+   */
+  struct PageTableShard {
+    /**
+     * Protects page_table_, io_pending_ and writebacks_, as well as the pin count and dirty flag of every page mapped
+     * here.
+     */
+    std::mutex latch_;
+    /** Notified whenever a pending read of a page in this shard completes. */
+    std::condition_variable io_done_;
+    /** Maps the resident pages of this shard to their frames. */
+    std::unordered_map<page_id_t, frame_id_t> page_table_;
+    /** Frames of this shard whose content is still being read from disk. */
+    std::unordered_set<frame_id_t> io_pending_;
+    /** Writebacks of evicted dirty pages of this shard that have not completed yet. */
+    std::unordered_map<page_id_t, std::shared_future<void>> writebacks_;
+  };
+
+  /**
+   * @param page_id id of page
+   * @return the page table shard responsible for the given page id
+   */
+  PageTableShard &GetShard(page_id_t page_id);
+
+  /**
+   * @param page_id id of page
+   * @return the index of the page table shard responsible for the given page id
+   */
+  size_t GetShardIndex(page_id_t page_id) const;
+
+  /**
+   * Acquire the latch of a page table shard, counting it as a contention if another thread holds it.
+   * @param shard the shard to latch
+   * @return the held latch
+   */
+  std::unique_lock<std::mutex> LockShard(PageTableShard *shard);
+
+  /**
+   * Acquire the latch of the free list, counting it as a contention if another thread holds it.
+   * @return the held latch
+   */
+  std::unique_lock<std::mutex> LockFreeList();
+
+  /**
+   * Acquire a latch, counting it as a contention and timing the wait if another thread holds it.
+   * @param latch the latch to acquire
+   * @return the held latch
+   */
+  std::unique_lock<std::mutex> LockLatch(std::mutex *latch);
+
+  /**
+   * @param start the start of a measured interval
+   * @return the nanoseconds passed since start
+   */
+  static uint64_t ElapsedNanos(std::chrono::steady_clock::time_point start);
+
+  /**
+   * Point a frame that is about to be filled with a page at the page in the read-only mapping of the database file,
+   * if the disk manager has one (DiskIOBackend::MMAP), or back at its own memory otherwise. A borrowed page must not
+   * be written to.
+   * @param frame_id the frame being filled, owned by the caller
+   * @param page_id id of the page
+   * @return true if the page was borrowed and does not need to be read
+   */
+  bool BorrowPageData(frame_id_t frame_id, page_id_t page_id);
+
+  /**
+   * Map a freshly created page into a frame owned exclusively by the caller and pin it.
+   * @param frame_id the frame acquired for the page
+   * @param page_id id of the new page
+   * @return the pinned, zeroed page
+   */
+  Page *InstallNewPage(frame_id_t frame_id, page_id_t page_id);
+
+  /**
+   * Pin a resident page whose frame was found in the page table, waiting for its pending read (if any) to finish.
+   * @param shard the shard mapping the page, its latch must be held through lock
+   * @param lock the held shard latch
+   * @param frame_id the frame holding the page
+   * @return the pinned page, nullptr if the pending read failed and the page was taken out of the buffer pool
+   */
+  Page *PinResidentPage(PageTableShard *shard, std::unique_lock<std::mutex> *lock, frame_id_t frame_id);
+
+  /**
+   * Back out of a read that threw: take the page out of the page table, wake the fetches waiting for the read, and
+   * drop the pin of the reader. The frame goes back to the free list once the waiting fetches dropped theirs too.
+   * @param page_id id of the page that could not be read
+   * @param frame_id the frame the page was being read into
+   */
+  void AbortRead(page_id_t page_id, frame_id_t frame_id);
+
+  /**
+   * Drop a pin on a frame whose read failed, returning the frame to the free list with the last one. The latch of
+   * the shard that mapped the page must be held.
+   * @param frame_id the frame the page was being read into
+   */
+  void ReleaseAbortedPin(frame_id_t frame_id);
+
+  /**
+   * Unpin a page mapped by a shard whose latch is held by the caller.
+   * @param shard the shard mapping the page
+   * @param page_id id of page to be unpinned
+   * @param is_dirty true if the page should be marked as dirty, false otherwise
+   * @return false if the page is not resident or its pin count is <= 0 before this call, true otherwise
+   */
+  bool UnpinResidentPage(PageTableShard *shard, page_id_t page_id, bool is_dirty);
+
+  /**
+   * Take a frame for exclusive use by the caller, from the free list first and otherwise by evicting a victim from the
+   * replacer. The returned frame is not in the page table, the free list or the replacer.
+   * @param[out] frame_id the acquired frame
+   * @return false if all frames are pinned, true otherwise
+   */
+  bool AcquireFrame(frame_id_t *frame_id);
+
+  /**
+   * Give back a frame owned exclusively by the caller, to the free list, or to nobody if the pool has shrunk below it.
+   * @param frame_id the frame to release
+   */
+  void ReleaseFrame(frame_id_t frame_id);
+
+  /**
+   * Retire a frame owned exclusively by the caller if the pool has shrunk below it. latch_ must be held.
+   * @param frame_id the frame
+   * @return true if the frame was retired and must not be used
+   */
+  bool RetireFrameIfRemoved(frame_id_t frame_id);
+
+  /**
+   * Try to evict the page held by a frame that was just returned by the replacer. A dirty page is copied and written
+   * back on an I/O thread of the disk manager, so that the caller can read another page into the frame meanwhile.
+   * @param frame_id the victim frame
+   * @return true if the frame is now owned exclusively by the caller, false if it could not be evicted
+   */
+  bool EvictFrame(frame_id_t frame_id);
+
+  /**
+   * Wait until the writeback started by evicting a dirty page has completed, so that the page can be read from disk.
+   * @param page_id id of the page about to be read
+   */
+  void WaitForWriteBack(page_id_t page_id);
+
+  /**
+   * Write back the page held by a frame if it is dirty and unpinned, leaving it resident and in the replacer.
+   * @param frame_id the frame to clean
+   * @return true if the page was written back
+   */
+  bool CleanFrame(frame_id_t frame_id);
+
+  /**
+   * Main loop of the background flush thread.
+   */
+  void BackgroundFlush();
+
+  /**
+   * Main loop of the prefetch thread. Exits once it has been asked to stop and every queued read is done.
+   */
+  void BackgroundPrefetch();
+
+  /**
+   * Stop and join the prefetch thread, if it is running, after it has finished every queued read.
+   */
+  void StopPrefetchThread();
+
+  /** Number of frames currently in use by the buffer pool. Only changed by Resize while holding latch_. */
+  std::atomic<size_t> pool_size_;
+  /** Number of frames reserved for the buffer pool. Frames at pool_size_ and beyond are retired. */
+  const size_t max_pool_size_;
   /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
   const uint32_t num_instances_ = 1;
   /** Index of this BPI in the parallel BPM (if present, otherwise just 0) */
@@ -132,17 +446,68 @@ class BufferPoolManagerInstance : public BufferPoolManager {
 
   /** Array of buffer pool pages. */
   Page *pages_;
+  /** Data of the buffer pool pages, one contiguous region separate from the page metadata. */
+  FrameAllocator frames_;
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
   LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  std::unordered_map<page_id_t, frame_id_t> page_table_;
+  /** Page table for keeping track of buffer pool pages, split into independently latched shards. */
+  std::array<PageTableShard, PAGE_TABLE_SHARD_NUM> page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
+  /** This latch protects free_list_. It may be acquired while holding a shard latch, never the other way round. */
   std::mutex latch_;
+  /** Frames taken out of service by shrinking the pool, protected by latch_. */
+  std::vector<bool> frame_retired_;
+  /** Serializes Resize calls. */
+  std::mutex resize_latch_;
+
+  /** Background flush thread, nullptr if it is not running. */
+  std::thread *flush_thread_ = nullptr;
+  /** Protects flush_thread_ and flush_thread_running_. */
+  std::mutex flush_latch_;
+  /** Wakes the background flush thread up early. */
+  std::condition_variable flush_cv_;
+  /** True while the background flush thread should keep running. */
+  bool flush_thread_running_ = false;
+  /** Fraction of the pool the background flush thread keeps clean. */
+  double flush_clean_ratio_ = BACKGROUND_FLUSH_CLEAN_RATIO;
+
+  /** Prefetch thread, nullptr until the first prefetch is issued. */
+  std::thread *prefetch_thread_ = nullptr;
+  /** Protects prefetch_thread_, prefetch_thread_running_ and prefetch_queue_. */
+  std::mutex prefetch_latch_;
+  /** Wakes the prefetch thread up when a read is queued or it should stop. */
+  std::condition_variable prefetch_cv_;
+  /** Reads waiting for the prefetch thread, as (page, frame) pairs. The frames are pinned and marked I/O pending. */
+  std::deque<std::pair<page_id_t, frame_id_t>> prefetch_queue_;
+  /** True while the prefetch thread should keep running. */
+  bool prefetch_thread_running_ = false;
+
+  /** Number of fetches that found their page resident. */
+  std::atomic<uint64_t> num_hits_ = 0;
+  /** Number of fetches that had to read their page from disk. */
+  std::atomic<uint64_t> num_misses_ = 0;
+  /** Number of frames evicted to make room for another page. */
+  std::atomic<uint64_t> num_evictions_ = 0;
+  /** Number of dirty pages written back by foreground evictions. */
+  std::atomic<uint64_t> num_foreground_writes_ = 0;
+  /** Number of writebacks of evicted dirty pages that have not completed yet. */
+  std::atomic<int> num_inflight_writebacks_ = 0;
+  /** Number of dirty pages written back by the background flush thread. */
+  std::atomic<uint64_t> num_background_writes_ = 0;
+  /** Number of background reads issued by prefetches. */
+  std::atomic<uint64_t> num_prefetches_ = 0;
+  /** Number of times a thread had to wait for a page table shard latch or the free list latch. */
+  std::atomic<uint64_t> num_latch_contentions_ = 0;
+  /** Time spent waiting for contended latches, in nanoseconds. */
+  std::atomic<uint64_t> latch_wait_ns_ = 0;
+  /** Time from a fetch missing the pool until its page has been read. */
+  LatencyHistogram miss_latency_;
+  /** Time spent finding a victim frame when the free list is empty. */
+  LatencyHistogram victim_latency_;
 };
 }  // namespace bustub
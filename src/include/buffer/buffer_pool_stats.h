@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.h
+//
+// Identification: src/include/buffer/buffer_pool_stats.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bustub {
+
+/**
+ * LatencyHistogram counts latencies in nanoseconds in power-of-two buckets: bucket i holds the values in
+ * (2^(i-1), 2^i], bucket 0 holds 0 and 1, and the last bucket also holds everything larger. Recording is a couple of
+ * relaxed atomic increments, so it can be done on hot paths by many threads at once; readers take a snapshot.
+ */
+class LatencyHistogram {
+ public:
+  /** Number of buckets. The last regular bucket ends at 2^30 ns, about one second. */
+  static constexpr size_t NUM_BUCKETS = 32;
+
+  /** A copy of the histogram at one point in time. Snapshots of several histograms can be added up. */
+  struct Snapshot {
+    std::array<uint64_t, NUM_BUCKETS> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+
+    Snapshot &operator+=(const Snapshot &other);
+
+    /** @return the mean of the recorded values, 0 if there are none */
+    double Mean() const;
+
+    /**
+     * @param percentile the percentile, between 0 and 100
+     * @return the upper bound of the bucket holding the given percentile, 0 if no values were recorded
+     */
+    uint64_t Percentile(double percentile) const;
+  };
+
+  /** @return the upper bound of the values held by a bucket */
+  static uint64_t BucketUpperBound(size_t bucket) { return uint64_t{1} << bucket; }
+
+  /**
+   * Record one value.
+   * @param value the latency in nanoseconds
+   */
+  void Record(uint64_t value);
+
+  /** @return a copy of the histogram. Concurrent Record calls may or may not be included. */
+  Snapshot GetSnapshot() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> sum_ = 0;
+};
+
+/**
+ * Counters and latency histograms of a buffer pool, read out of the live atomics of one BufferPoolManagerInstance.
+ * The stats of several instances can be added up into the stats of a whole parallel buffer pool.
+ */
+struct BufferPoolStats {
+  /** Number of fetches that found their page resident. */
+  uint64_t num_hits_ = 0;
+  /** Number of fetches that had to read their page from disk. */
+  uint64_t num_misses_ = 0;
+  /** Number of frames evicted to make room for another page. */
+  uint64_t num_evictions_ = 0;
+  /** Number of dirty pages that a foreground eviction had to write back itself. */
+  uint64_t num_foreground_writes_ = 0;
+  /** Number of dirty pages written back by the background flush thread. */
+  uint64_t num_background_writes_ = 0;
+  /** Number of background reads issued by prefetches. */
+  uint64_t num_prefetches_ = 0;
+  /** Number of times a thread had to wait for a latch held by another thread. */
+  uint64_t num_latch_contentions_ = 0;
+  /** Total time threads spent waiting for latches held by other threads, in nanoseconds. */
+  uint64_t latch_wait_ns_ = 0;
+  /** Time from a fetch missing the pool until its page has been read. */
+  LatencyHistogram::Snapshot miss_latency_;
+  /** Time spent finding a victim frame when the free list is empty, including writing back a dirty victim. */
+  LatencyHistogram::Snapshot victim_latency_;
+
+  BufferPoolStats &operator+=(const BufferPoolStats &other);
+
+  /** @return the fraction of fetches that found their page resident, 0 if there were no fetches */
+  double HitRatio() const;
+};
+
+/**
+ * Render the stats of buffer pool instances in the Prometheus text exposition format, one series per instance
+ * labelled with its index, so that a monitoring scraper can pick them up as they are.
+ * @param stats the stats of every instance, in instance order
+ * @return the rendered stats
+ */
+std::string DumpBufferPoolStats(const std::vector<BufferPoolStats> &stats);
+
+}  // namespace bustub
@@ -12,8 +12,7 @@
 
 #pragma once
 
-#include <list>
-#include <mutex>  // NOLINT
+#include <atomic>
 #include <vector>
 
 #include "buffer/replacer.h"
@@ -23,6 +22,11 @@ namespace bustub {
 
 /**
  * ClockReplacer implements the clock replacement policy, which approximates the Least Recently Used policy.
+ *
+ * The replacer is lock-free. Each frame's state is one atomic byte holding an in-replacer bit and a reference bit,
+ * so Pin and Unpin are a single atomic read-modify-write on that byte. Victim advances a shared clock hand with CAS
+ * and claims a frame by CAS on its state, so concurrent Victim calls never hand out the same frame and never block
+ * Pin or Unpin from other threads.
  */
 class ClockReplacer : public Replacer {
  public:
@@ -45,8 +49,24 @@ class ClockReplacer : public Replacer {
 
   size_t Size() override;
 
+  std::vector<frame_id_t> PeekVictims(size_t max_frames) override;
+
  private:
-  // TODO(student): implement me!
+  /** The frame can be victimized. */
+  static constexpr uint8_t IN_REPLACER = 0x1;
+  /** The frame was unpinned since the clock hand last passed it. */
+  static constexpr uint8_t REFERENCED = 0x2;
+
+  /**
+   * Move the clock hand forward by one frame.
+   * @return the frame the hand pointed to before it moved
+   */
+  size_t AdvanceHand();
+
+  size_t num_pages_;                        // 最大容量
+  std::vector<std::atomic<uint8_t>> state_;  // 每一帧的状态位，IN_REPLACER | REFERENCED
+  std::atomic<size_t> hand_;                // 时钟指针
+  std::atomic<size_t> size_;                // 可以被换出的帧的数量
 };
 
 }  // namespace bustub
@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_allocator.h
+//
+// Identification: src/include/buffer/frame_allocator.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * FrameAllocator owns the memory holding the data of every frame of a buffer pool.
+ *
+ * The frames are one contiguous anonymous mapping, kept apart from the Page metadata so that scanning pin counts and
+ * latches does not drag page data through the cache. Regions of at least HUGE_PAGE_SIZE are aligned to it and advised
+ * to be backed by transparent huge pages, which cuts the TLB misses of lookups into a large pool. On a NUMA machine
+ * the region can be bound to one node, and threads working on it can be pinned to that node's CPUs. Huge pages and
+ * NUMA binding are hints: where the platform does not support them the frames are still allocated normally.
+ */
+class FrameAllocator {
+ public:
+  /**
+   * Map the data of a buffer pool. The memory is zeroed.
+   * @param num_frames the number of frames in the buffer pool
+   * @param numa_node the NUMA node the memory should live on, -1 to leave it to the kernel
+   */
+  explicit FrameAllocator(size_t num_frames, int numa_node = -1);
+
+  /**
+   * Unmap the data of the buffer pool.
+   */
+  ~FrameAllocator();
+
+  FrameAllocator(const FrameAllocator &) = delete;
+  FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+  /**
+   * @param frame_id id of a frame
+   * @return the PAGE_SIZE bytes holding the data of the frame
+   */
+  inline char *GetFrameData(frame_id_t frame_id) { return data_ + static_cast<size_t>(frame_id) * PAGE_SIZE; }
+
+  /**
+   * Give the memory of frames that are no longer in use back to the operating system. The frames stay mapped and read
+   * as zeroes the next time they are touched.
+   * @param first the first frame to release
+   * @param num_frames the number of frames to release
+   */
+  void ReleaseFrames(frame_id_t first, size_t num_frames);
+
+  /** @return true if the kernel was asked to back the frames with huge pages */
+  inline bool IsHugePageAdvised() const { return huge_page_advised_; }
+
+  /** @return the NUMA node the frames are bound to, -1 if they are not bound */
+  inline int GetNumaNode() const { return numa_node_; }
+
+  /** @return the number of NUMA nodes of this machine, 1 if it cannot be determined */
+  static int GetNumNumaNodes();
+
+  /**
+   * Restrict the calling thread to the CPUs of a NUMA node. Does nothing for node -1 or if the platform does not
+   * support it.
+   * @param numa_node the NUMA node to run on
+   */
+  static void BindThreadToNumaNode(int numa_node);
+
+ private:
+  /** 所有帧的数据，连续的一段内存 */
+  char *data_ = nullptr;
+  /** 映射的长度 */
+  size_t size_ = 0;
+  /** 是否已经建议内核用大页 */
+  bool huge_page_advised_ = false;
+  /** 内存绑定的NUMA节点，-1表示没有绑定 */
+  int numa_node_ = -1;
+};
+
+}  // namespace bustub
@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.h
+//
+// Identification: src/include/buffer/lru_k_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <list>
+#include <mutex>  // NOLINT
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy.
+ *
+ * The backward k-distance of a frame is the difference between the current timestamp and the timestamp of its k-th
+ * most recent access. The victim is the evictable frame with the largest backward k-distance. Frames with fewer than k
+ * recorded accesses have an infinite distance and are victimized first, in the order of their earliest access. Pages
+ * touched once by a sequential scan therefore leave the pool before pages that are accessed repeatedly.
+ */
+class LRUKReplacer : public Replacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_pages the maximum number of pages the LRUKReplacer will be required to store
+   * @param k the number of most recent accesses taken into account
+   */
+  explicit LRUKReplacer(size_t num_pages, size_t k = LRUK_REPLACER_K);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  bool Victim(frame_id_t *frame_id) override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  size_t Size() override;
+
+  std::vector<frame_id_t> PeekVictims(size_t max_frames) override;
+
+  void RecordAccess(frame_id_t frame_id) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+ private:
+  /** (timestamp of the k-th most recent access, or of the earliest access if there are fewer than k, frame id) */
+  using EvictionKey = std::pair<size_t, frame_id_t>;
+
+  /** @return the set an evictable frame is kept in, depending on how many accesses it has */
+  std::set<EvictionKey> *EvictableSet(frame_id_t frame_id);
+
+  /** @return the eviction key of a frame */
+  EvictionKey GetEvictionKey(frame_id_t frame_id) const;
+
+  std::mutex mutex_;
+  size_t k_;                                   // 记录最近的k次访问
+  size_t current_timestamp_{0};                // 逻辑时钟，每次访问加一
+  std::vector<std::list<size_t>> history_;     // 每个frame最近k次访问的时间戳，表头最旧
+  std::vector<bool> evictable_;                // frame是否可以被victim
+  std::set<EvictionKey> infinite_distance_;    // 访问次数不足k次的可victim的frame
+  std::set<EvictionKey> finite_distance_;      // 访问次数达到k次的可victim的frame
+};
+
+}  // namespace bustub
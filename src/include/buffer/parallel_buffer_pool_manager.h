@@ -12,8 +12,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <utility>
 #include <vector>
 
+#include "buffer/buffer_access_strategy.h"
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/buffer_pool_manager_instance.h"
 #include "recovery/log_manager.h"
@@ -22,6 +26,14 @@
 
 namespace bustub {
 
+/**
+ * How a ParallelBufferPoolManager maps a page id to the instance responsible for it.
+ * MODULO: page_id % num_instances, page ids are handed out by the instances themselves in round-robin order.
+ * HASH: a mixing hash of the page id, so that runs of hot page ids (a hash directory and its first buckets, the
+ * upper levels of a tree) are spread over the instances; page ids are handed out by the parallel BPM.
+ */
+enum class InstanceRouting { MODULO, HASH };
+
 class ParallelBufferPoolManager : public BufferPoolManager {
  public:
   /**
@@ -30,9 +42,15 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * @param pool_size the pool size of each BufferPoolManagerInstance
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_type the replacement policy of every BufferPoolManagerInstance
+   * @param routing how page ids are mapped to instances
+   * @param max_pool_size the pool size each BufferPoolManagerInstance can be grown to with Resize
+   *
+   * On a NUMA machine the frames of the instances are spread over the nodes round-robin.
    */
   ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                            LogManager *log_manager = nullptr);
+                            LogManager *log_manager = nullptr, ReplacerType replacer_type = ReplacerType::LRU,
+                            InstanceRouting routing = InstanceRouting::MODULO, size_t max_pool_size = 0);
 
   /**
    * Destroys an existing ParallelBufferPoolManager.
@@ -42,20 +60,75 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  /**
+   * Resize every BufferPoolManagerInstance, see BufferPoolManagerInstance::Resize. The number of instances stays the
+   * same, since every page id is bound to its instance. Concurrent calls are serialized. If an instance cannot be
+   * shrunk in time, the instances already shrunk are grown back to the old size and the pool size is left unchanged.
+   * @param pool_size the new pool size of each BufferPoolManagerInstance
+   * @return false if the size is out of range or an instance could not be shrunk in time, true otherwise
+   */
+  bool Resize(size_t pool_size);
+
+  /**
+   * Start the background flush thread of every BufferPoolManagerInstance.
+   * @param clean_ratio fraction of each instance that its flush thread keeps clean
+   */
+  void RunBackgroundFlushThread(double clean_ratio = BACKGROUND_FLUSH_CLEAN_RATIO);
+
+  /**
+   * Stop the background flush thread of every BufferPoolManagerInstance.
+   */
+  void StopBackgroundFlushThread();
+
+  /**
+   * Affinity hint for threads that mostly work on one page, e.g. together with FrameAllocator::BindThreadToNumaNode.
+   * @param page_id id of page
+   * @return the NUMA node holding the frames of the instance responsible for the page, -1 if they are not bound
+   */
+  int GetNumaNode(page_id_t page_id) const;
+
+  /** @return the number of fetch hits summed over all instances */
+  uint64_t GetNumHits() const;
+
+  /** @return the number of fetch misses summed over all instances */
+  uint64_t GetNumMisses() const;
+
+  /** @return the number of evictions summed over all instances */
+  uint64_t GetNumEvictions() const;
+
+  /** @return the number of dirty pages written back by foreground evictions, summed over all instances */
+  uint64_t GetNumForegroundWrites() const;
+
+  /** @return the number of dirty pages written back by background flush threads, summed over all instances */
+  uint64_t GetNumBackgroundWrites() const;
+
+  /** @return the number of background reads issued by prefetches, summed over all instances */
+  uint64_t GetNumPrefetches() const;
+
+  /** @return the counters and latency histograms summed over all instances */
+  BufferPoolStats GetStats() const override;
+
+  /** @return the counters and latency histograms of every instance, in instance order, to spot imbalance */
+  std::vector<BufferPoolStats> GetInstanceStats() const override;
+
  protected:
   /** 实例的数量 */
   size_t num_instances_;
-  /** 每个实例的容量 */
-  size_t pool_size_;
-  /** RR法插入页面时，下一个要插入的位置*/
-  size_t next_instance_;
-  /** 锁 */
-  std::mutex latch_;
+  /** 每个实例的容量，Resize时会改变 */
+  std::atomic<size_t> pool_size_;
+  /** 串行化Resize */
+  std::mutex resize_latch_;
+  /** 页面到实例的映射方式 */
+  InstanceRouting routing_;
+  /** RR法插入页面时，下一个要插入的位置，用原子变量代替全局锁 */
+  std::atomic<size_t> next_instance_;
+  /** HASH模式下由并行BPM统一分配page id */
+  std::atomic<page_id_t> next_page_id_;
   /** 实例s */
   std::vector<BufferPoolManagerInstance *> managers_;
   // BufferPoolManager **managers_;
   /** Pointer to the disk manager. */
-  // DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
   /** Pointer to the log manager. */
   // LogManager *log_manager_ __attribute__((__unused__));
 
@@ -65,6 +138,12 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    */
   BufferPoolManager *GetBufferPoolManager(page_id_t page_id);
 
+  /**
+   * @param page_id id of page
+   * @return index of the BufferPoolManagerInstance responsible for the page
+   */
+  size_t GetInstanceIndex(page_id_t page_id) const;
+
   /**
    * Fetch the requested page from the buffer pool.
    * @param page_id id of page to be fetched
@@ -72,6 +151,14 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    */
   Page *FetchPgImp(page_id_t page_id) override;
 
+  /**
+   * Fetch the requested page from the buffer pool, reporting a read from disk to the access strategy.
+   * @param page_id id of page to be fetched
+   * @param strategy the ring of a bulk reader, may be nullptr
+   * @return the requested page
+   */
+  Page *FetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
   /**
    * Unpin the target page from the buffer pool.
    * @param page_id id of page to be unpinned
@@ -105,5 +192,41 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * Flushes all the pages in the buffer pool to disk.
    */
   void FlushAllPgsImp() override;
+
+  /**
+   * Drop an unpinned, clean page from the buffer pool and return its frame to the free list.
+   * @param page_id id of page to be discarded
+   * @return false if the page is not resident, pinned or dirty, true otherwise
+   */
+  bool DiscardPgImp(page_id_t page_id) override;
+
+  /**
+   * Start reading a page into the buffer pool in the background.
+   * @param page_id id of page to be prefetched
+   * @param strategy the ring of a bulk reader the page is read for, may be nullptr
+   * @return false if no frame could be found for the page, true if it is resident or being read
+   */
+  bool PrefetchPgImp(page_id_t page_id, BufferAccessStrategy *strategy) override;
+
+  /**
+   * Pin the requested page only if it is resident and fully read.
+   * @param page_id id of page to be fetched
+   * @return the requested page, nullptr if it is not resident or its read is still in flight
+   */
+  Page *FetchResidentPgImp(page_id_t page_id) override;
+
+  /**
+   * Fetch several pages from the buffer pool.
+   * @param page_ids ids of pages to be fetched
+   * @return the requested pages in the order of page_ids, nullptr for each page no frame could be found for
+   */
+  std::vector<Page *> FetchPgsImp(const std::vector<page_id_t> &page_ids) override;
+
+  /**
+   * Unpin several pages from the buffer pool.
+   * @param pages (page id, is dirty) pairs of the pages to be unpinned
+   * @return false if the pin count of any of the pages is <= 0 before this call, true otherwise
+   */
+  bool UnpinPgsImp(const std::vector<std::pair<page_id_t, bool>> &pages) override;
 };
 }  // namespace bustub
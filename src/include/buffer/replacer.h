@@ -12,10 +12,17 @@
 
 #pragma once
 
+#include <vector>
+
 #include "common/config.h"
 
 namespace bustub {
 
+/**
+ * Replacement policies a BufferPoolManagerInstance can be constructed with.
+ */
+enum class ReplacerType { LRU, LRU_K, CLOCK };
+
 /**
  * Replacer is an abstract class that tracks page usage.
  */
@@ -45,6 +52,26 @@ class Replacer {
 
   /** @return the number of elements in the replacer that can be victimized */
   virtual size_t Size() = 0;
+
+  /**
+   * Collect the frames that would be victimized next, without removing them from the replacer.
+   * @param max_frames the maximum number of frames to collect
+   * @return up to max_frames frame ids, in the order they would be victimized
+   */
+  virtual std::vector<frame_id_t> PeekVictims(size_t max_frames) = 0;
+
+  /**
+   * Record that the page held by a frame was just accessed. Policies that only look at the order in which frames get
+   * unpinned can ignore this.
+   * @param frame_id the id of the accessed frame
+   */
+  virtual void RecordAccess(frame_id_t frame_id) {}
+
+  /**
+   * Forget a frame whose page is leaving the buffer pool, dropping any access history kept for it.
+   * @param frame_id the id of the frame to remove
+   */
+  virtual void Remove(frame_id_t frame_id) { Pin(frame_id); }
 };
 
 }  // namespace bustub
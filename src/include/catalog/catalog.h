@@ -210,19 +210,36 @@ class Catalog {
     // Construct index metdata
     auto meta = std::make_unique<IndexMetadata>(index_name, table_name, &schema, key_attrs);
 
-    // Construct the index, take ownership of metadata
+    // Collect the index keys of the first tuples in table heap, up to INDEX_BULK_LOAD_SIZE of them
+    auto *table_meta = GetTable(table_name);
+    auto *heap = table_meta->table_.get();
+    auto tuple = heap->Begin(txn);
+    std::vector<std::pair<KeyType, ValueType>> entries;
+    for (; tuple != heap->End() && entries.size() < static_cast<size_t>(INDEX_BULK_LOAD_SIZE); ++tuple) {
+      KeyType index_key;
+      index_key.SetFromKey(tuple->KeyFromTuple(schema, key_schema, key_attrs));
+      entries.emplace_back(index_key, tuple->GetRid());
+    }
+
+    // Construct the index bulk loaded with them, take ownership of metadata
     // TODO(Kyle): We should update the API for CreateIndex
     // to allow specification of the index type itself, not
     // just the key, value, and comparator types
     auto index = std::make_unique<ExtendibleHashTableIndex<KeyType, ValueType, KeyComparator>>(std::move(meta), bpm_,
-                                                                                               hash_function);
-
-    // Populate the index with all tuples in table heap
-    auto *table_meta = GetTable(table_name);
-    auto *heap = table_meta->table_.get();
-    for (auto tuple = heap->Begin(txn); tuple != heap->End(); ++tuple) {
-      index->InsertEntry(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid(), txn);
+                                                                                               hash_function, entries);
+    entries.clear();
+    entries.shrink_to_fit();
+
+    // Insert the rest of the tuples a batch at a time, so a large table is never held in memory as a whole
+    std::vector<std::pair<Tuple, RID>> batch;
+    for (; tuple != heap->End(); ++tuple) {
+      batch.emplace_back(tuple->KeyFromTuple(schema, key_schema, key_attrs), tuple->GetRid());
+      if (batch.size() == static_cast<size_t>(INDEX_BUILD_BATCH_SIZE)) {
+        index->InsertEntries(batch, txn);
+        batch.clear();
+      }
     }
+    index->InsertEntries(batch, txn);
 
     // Get the next OID for the new index
     const auto index_oid = next_index_oid_.fetch_add(1);
@@ -13,6 +13,7 @@
 #include <string>
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/buffer_pool_stats.h"
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "recovery/checkpoint_manager.h"
@@ -54,6 +55,12 @@ class BustubInstance {
     delete disk_manager_;
   }
 
+  /** @return the counters and latency histograms of the buffer pool */
+  BufferPoolStats GetBufferPoolStats() const { return buffer_pool_manager_->GetStats(); }
+
+  /** @return the stats of every buffer pool instance in the Prometheus text format, for a monitoring scraper */
+  std::string DumpBufferPoolStatsText() const { return DumpBufferPoolStats(buffer_pool_manager_->GetInstanceStats()); }
+
   DiskManager *disk_manager_;
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
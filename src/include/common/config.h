@@ -27,6 +27,12 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** The background flusher of a buffer pool cleans the tail of its replacer every BACKGROUND_FLUSH_INTERVAL. */
+extern std::chrono::milliseconds background_flush_interval;
+
+/** Shrinking a buffer pool is undone if the pages pinned in the removed frames stay pinned for RESIZE_TIMEOUT. */
+extern std::chrono::milliseconds resize_timeout;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
@@ -35,6 +41,18 @@ static constexpr int PAGE_SIZE = 4096;                                        //
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LRUK_REPLACER_K = 2;                                     // lookback window of the LRU-K replacer
+static constexpr double BACKGROUND_FLUSH_CLEAN_RATIO = 0.25;                  // pool share kept clean by flusher
+static constexpr int SCAN_RING_SIZE = 32;                                     // max frames a sequential scan occupies
+static constexpr int SCAN_PREFETCH_DEPTH = 4;                                 // pages a scan reads ahead of its cursor
+static constexpr int HUGE_PAGE_SIZE = 2 * 1024 * 1024;                        // size of a transparent huge page in byte
+static constexpr int OPTIMISTIC_READ_RETRIES = 3;                             // optimistic attempts before latching
+static constexpr int DIRECT_IO_ALIGNMENT = 4096;                              // buffer alignment required by O_DIRECT
+static constexpr int DISK_IO_QUEUE_DEPTH = 4;                                 // async disk I/Os running at once
+static constexpr int WRITE_BATCH_SIZE = 64;                                   // pages per synced batch of FlushAllPages
+static constexpr int COMPRESSED_SECTOR_SIZE = 512;                            // allocation unit of compressed pages
+static constexpr int INDEX_BULK_LOAD_SIZE = 65536;                            // entries an index build bulk loads
+static constexpr int INDEX_BUILD_BATCH_SIZE = 4096;                           // entries per batch of an index build
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
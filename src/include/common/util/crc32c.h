@@ -0,0 +1,46 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// crc32c.h
+//
+// Identification: src/include/common/util/crc32c.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * Crc32c computes the CRC-32C (Castagnoli) checksum used to detect corrupted and torn pages. It uses the SSE4.2 crc32
+ * instruction when the CPU has it, picked once at runtime, and a lookup table otherwise.
+ */
+class Crc32c {
+ public:
+  /**
+   * @param data the bytes to checksum
+   * @param size the number of bytes
+   * @return the CRC-32C of the bytes
+   */
+  static uint32_t Compute(const char *data, size_t size) { return Extend(0, data, size); }
+
+  /**
+   * Continue a checksum over more bytes, so that Extend(Compute(a), b) equals the checksum of a followed by b.
+   * @param crc the checksum of the bytes so far
+   * @param data the following bytes
+   * @param size the number of following bytes
+   * @return the checksum of all the bytes
+   */
+  static uint32_t Extend(uint32_t crc, const char *data, size_t size);
+
+  /** @return true if the checksum is computed with the crc32 instruction */
+  static bool IsHardwareAccelerated();
+};
+
+}  // namespace bustub
@@ -0,0 +1,54 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lz_compressor.h
+//
+// Identification: src/include/common/util/lz_compressor.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+namespace bustub {
+
+/**
+ * LzCompressor is a small LZ77 compressor in the spirit of the LZ4 block format, used to compress pages on disk.
+ * The input is a sequence of tokens, each a run of literal bytes followed by a copy of earlier output:
+ *
+ *  | token (1) | literal length extension (0+) | literals | offset (2) | match length extension (0+) |
+ *
+ * The high nibble of the token is the literal length and the low nibble the match length minus MIN_MATCH; a nibble
+ * of 15 is extended by bytes that are added to it up to and including the first one below 255. The offset is little
+ * endian and counts back from the current output position. The last token has literals only and ends the input.
+ * It is tuned for speed over ratio: one hash table probe per position and greedy matching.
+ */
+class LzCompressor {
+ public:
+  /** The shortest match worth encoding. */
+  static constexpr size_t MIN_MATCH = 4;
+
+  /**
+   * @param src the bytes to compress
+   * @param size the number of bytes, at most 64 KB apart from one another can be matched
+   * @param[out] dst the compressed bytes
+   * @param capacity the size of dst
+   * @return the number of compressed bytes, 0 if they do not fit into capacity
+   */
+  static size_t Compress(const char *src, size_t size, char *dst, size_t capacity);
+
+  /**
+   * @param src the compressed bytes
+   * @param size the number of compressed bytes
+   * @param[out] dst the decompressed bytes
+   * @param dst_size the exact number of decompressed bytes expected
+   * @return false if the input is malformed or does not decompress to dst_size bytes
+   */
+  static bool Decompress(const char *src, size_t size, char *dst, size_t dst_size);
+};
+
+}  // namespace bustub
@@ -12,14 +12,18 @@
 
 #pragma once
 
+#include <mutex>  // NOLINT
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
+#include "container/hash/hash_table_directory.h"
 #include "storage/page/hash_table_bucket_page.h"
+#include "storage/page/hash_table_directory_header_page.h"
 #include "storage/page/hash_table_directory_page.h"
 
 namespace bustub {
@@ -30,6 +34,10 @@ namespace bustub {
  * Implementation of extendible hash table that is backed by a buffer pool
  * manager. Non-unique keys are supported. Supports insert and delete. The
  * table grows/shrinks dynamically as buckets become full/empty.
+ *
+ * The directory is a header page listing up to DIRECTORY_HEADER_ARRAY_SIZE
+ * directory pages, so the global depth can grow to MAX_GLOBAL_DEPTH. A lookup
+ * reads the header, one directory page and the bucket page.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTable {
@@ -44,6 +52,21 @@ class ExtendibleHashTable {
   explicit ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                const KeyComparator &comparator, HashFunction<KeyType> hash_fn);
 
+  /**
+   * Creates a new ExtendibleHashTable holding the given key-value pairs. Instead of inserting and splitting one pair
+   * at a time, the pairs are partitioned by hash in memory, the final local depths are computed from the partitions,
+   * and the bucket pages, directory pages and header page are written once each, in page id order.
+   *
+   * @param buffer_pool_manager buffer pool manager to be used
+   * @param comparator comparator for keys
+   * @param hash_fn the hash function
+   * @param entries the key-value pairs to load. Duplicate pairs are loaded once. As with Insert, pairs that do not
+   * fit their bucket, because too many of them share one hash or the bucket is at MAX_GLOBAL_DEPTH, are not loaded;
+   * a warning is logged with their number.
+   */
+  ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
+                      HashFunction<KeyType> hash_fn, const std::vector<std::pair<KeyType, ValueType>> &entries);
+
   /**
    * Inserts a key-value pair into the hash table.
    *
@@ -74,6 +97,28 @@ class ExtendibleHashTable {
    */
   bool GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result);
 
+  /**
+   * Performs point queries for a batch of keys. The keys are hashed up front and grouped by bucket, so that each
+   * bucket is latched once for all of its keys, and the next bucket is prefetched while one is being read.
+   *
+   * @param transaction the current transaction
+   * @param keys the keys to look up
+   * @param[out] results the value(s) associated with each key, results[i] for keys[i]
+   * @return the number of keys that were found
+   */
+  size_t GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                   std::vector<std::vector<ValueType>> *results);
+
+  /**
+   * Inserts a batch of key-value pairs, grouped by bucket like GetValues. A full bucket is split as in Insert and the
+   * pairs that remain are grouped again.
+   *
+   * @param transaction the current transaction
+   * @param entries the key-value pairs to insert
+   * @return the number of pairs inserted, i.e. not counting duplicates and pairs that did not fit
+   */
+  size_t InsertBatch(Transaction *transaction, const std::vector<std::pair<KeyType, ValueType>> &entries);
+
   /**
    * Returns the global depth.  Do not touch.
    */
@@ -107,26 +152,48 @@ class ExtendibleHashTable {
    * representation.
    *
    * @param key the key to use for lookup
-   * @param dir_page to use for lookup of global depth
+   * @param directory to use for lookup of global depth
    * @return the directory index
    */
-  uint32_t KeyToDirectoryIndex(KeyType key, HashTableDirectoryPage *dir_page);
+  uint32_t KeyToDirectoryIndex(KeyType key, HashTableDirectory *directory);
 
   /**
    * Get the bucket page_id corresponding to a key.
    *
    * @param key the key for lookup
-   * @param dir_page a pointer to the hash table's directory page
+   * @param directory the hash table's directory
    * @return the bucket page_id corresponding to the input key
    */
-  page_id_t KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page);
+  page_id_t KeyToPageId(KeyType key, HashTableDirectory *directory);
+
+  /**
+   * Get the bucket page_id corresponding to a key without latching the directory. The header page is read
+   * optimistically and its version is validated before the directory page is fetched and after it has been read.
+   *
+   * @param header_page the pinned header page of the directory
+   * @param header_version the version returned by TryOptimisticRead on the header page
+   * @param hash the hash of the key for lookup
+   * @param[out] bucket_page_id the bucket page_id corresponding to the input key
+   * @return false if a split or merge got in the way, true otherwise
+   */
+  bool OptimisticKeyToPageId(Page *header_page, uint64_t header_version, uint32_t hash,
+                             page_id_t *bucket_page_id);
+
+  /**
+   * Creates the directory and the buckets holding the given key-value pairs. Run once, through directory_init_.
+   *
+   * @param entries the key-value pairs to load
+   */
+  void BulkLoad(const std::vector<std::pair<KeyType, ValueType>> &entries);
 
   /**
-   * Fetches the directory page from the buffer pool manager.
+   * Fetches the header page of the directory from the buffer pool manager, creating the directory if necessary.
    *
-   * @return a pointer to the directory page
+   * @return the pinned header page of the directory
    */
-  HashTableDirectoryPage *FetchDirectoryPage();
+  Page *FetchHeaderPage();
+  HashTableDirectoryHeaderPage *GetHeaderPageData(Page *page);
+  HashTableDirectoryPage *GetDirectoryPageData(Page *page);
 
   /**
    * Fetches the a bucket page from the buffer pool manager using the bucket's page_id.
@@ -137,6 +204,43 @@ class ExtendibleHashTable {
   Page *FetchBucketPage(page_id_t bucket_page_id);
   HASH_TABLE_BUCKET_TYPE *GetBucketPageData(Page *page);
 
+  /**
+   * Finds the bucket of a key and latches it. The directory is read optimistically, or read latched through its
+   * header page if that keeps failing, and is no longer held when this returns: once the bucket is latched, a split
+   * or merge that would move the key elsewhere has to wait for the bucket latch.
+   *
+   * @param hash the hash of the key to look up
+   * @param exclusive true to write latch the bucket, false to read latch it
+   * @return the pinned and latched bucket page
+   */
+  Page *LatchBucketPage(uint32_t hash, bool exclusive);
+
+  /**
+   * Performs a point query without any latch. The directory and the bucket are read
+   * optimistically and their versions are validated afterwards.
+   *
+   * @param key the key to look up
+   * @param hash the hash of the key
+   * @param[out] result the value(s) associated with a given key, only appended to if the read was consistent
+   * @param[out] found true if the key was found
+   * @return false if a concurrent writer got in the way and the query has to be retried, true otherwise
+   */
+  bool OptimisticGetValue(const KeyType &key, uint32_t hash, std::vector<ValueType> *result, bool *found);
+
+  /**
+   * Groups the entries of a batch by bucket page. The bucket pages are looked up under a read latch of the directory,
+   * which is released before returning: before using a group, latch its bucket and validate the returned version.
+   *
+   * @param header_page the pinned header page of the directory
+   * @param hashes the hash of the key of each entry of the batch
+   * @param[in,out] pending the indexes of the entries to group, sorted by bucket page on return. Entries of the same
+   * bucket keep their order.
+   * @param[out] bucket_page_ids the bucket page_id of each pending entry, in the order of pending
+   * @return the version of the header page the grouping is valid for
+   */
+  uint64_t GroupByBucket(Page *header_page, const std::vector<uint32_t> &hashes, std::vector<size_t> *pending,
+                         std::vector<page_id_t> *bucket_page_ids);
+
   /**
    * Performs insertion with an optional bucket splitting.  If the
    * page is still full after the split, then recursively split.
@@ -151,7 +255,8 @@ class ExtendibleHashTable {
 
   /**
    * Optionally merges an empty bucket into it's pair.  This is called by Remove,
-   * if Remove makes a bucket empty.
+   * if Remove makes a bucket empty. The bucket is looked up again by key, the
+   * directory may have changed since.
    *
    * There are three conditions under which we skip the merge:
    * 1. The bucket is no longer empty.
@@ -162,20 +267,40 @@ class ExtendibleHashTable {
    *
    * @param transaction a pointer to the current transaction
    * @param key the key that was removed
-   * @param value the value that was removed
    */
-  void Merge(Transaction *transaction, uint32_t target_bucket_index);
+  void Merge(Transaction *transaction, const KeyType &key);
+
+  /**
+   * Unpins a page pinned by this table. It can only fail on a bug, which is asserted in debug builds; the call itself
+   * is made in every build.
+   *
+   * @param page_id the page to unpin
+   * @param is_dirty true if the page was modified
+   */
+  void UnpinPage(page_id_t page_id, bool is_dirty);
+
+  /**
+   * Deletes pages taken out of the table, and retries the ones whose deletion failed before. A page that a reader
+   * found before it was taken out may still be pinned and cannot be deleted yet; it is kept in deferred_deletes_ and
+   * retried by the next split or merge. The header page must be write latched.
+   *
+   * @param page_ids the pages to delete
+   */
+  void DeletePages(const std::vector<page_id_t> &page_ids);
 
-  // 创建Directory的锁
-  std::mutex driectory_lock_;
+  // 保证Directory只创建一次
+  std::once_flag directory_init_;
+  // 还被读者pin着、暂时删不掉的页面，持有header page写锁时才能访问
+  std::vector<page_id_t> deferred_deletes_;
 
   // member variables
-  page_id_t directory_page_id_;
+  page_id_t header_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
 
-  // Readers includes inserts and removes, writers are splits and merges
-  ReaderWriterLatch table_latch_;
+  // There is no table latch. Splits and merges write latch the header page of the directory, which guards all of its
+  // directory pages; lookups, inserts and removes only latch their bucket page, having found it through an
+  // optimistic or read latched read of the directory.
   HashFunction<KeyType> hash_fn_;
 };
 
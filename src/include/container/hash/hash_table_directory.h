@@ -0,0 +1,139 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory.h
+//
+// Identification: src/include/container/hash/hash_table_directory.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "storage/page/hash_table_directory_header_page.h"
+#include "storage/page/hash_table_directory_page.h"
+
+namespace bustub {
+
+/**
+ * HashTableDirectory presents the directory of an extendible hash table, which is spread over a header page and up to
+ * DIRECTORY_HEADER_ARRAY_SIZE directory pages, as one array of 2^GlobalDepth entries with the interface of a single
+ * HashTableDirectoryPage. Directory pages are fetched when an entry on them is accessed; only the last one stays
+ * pinned, so walking the directory in index order pins at most one directory page at a time.
+ *
+ * The view does not latch anything. The caller holds the latch of the header page, which guards the whole directory:
+ * a read latch to look up entries, a write latch to change them.
+ */
+class HashTableDirectory {
+ public:
+  /**
+   * @param buffer_pool_manager the buffer pool manager holding the directory
+   * @param header_page the pinned header page of the directory. It stays pinned by the caller.
+   */
+  HashTableDirectory(BufferPoolManager *buffer_pool_manager, Page *header_page);
+
+  HashTableDirectory(const HashTableDirectory &) = delete;
+  HashTableDirectory &operator=(const HashTableDirectory &) = delete;
+
+  /** Unpins the directory page still held, as dirty if it was modified. */
+  ~HashTableDirectory();
+
+  /** @return the global depth of the directory */
+  uint32_t GetGlobalDepth() const;
+
+  /** @return mask of global_depth 1's and the rest 0's (with 1's from LSB upwards) */
+  uint32_t GetGlobalDepthMask() const;
+
+  /** @return the current directory size */
+  uint32_t Size() const;
+
+  /**
+   * @param bucket_idx the index in the directory to lookup
+   * @return bucket page_id corresponding to bucket_idx
+   */
+  page_id_t GetBucketPageId(uint32_t bucket_idx);
+
+  /**
+   * @param bucket_idx directory index at which to insert page_id
+   * @param bucket_page_id page_id to insert
+   */
+  void SetBucketPageId(uint32_t bucket_idx, page_id_t bucket_page_id);
+
+  /**
+   * @param bucket_idx the bucket index to lookup
+   * @return the local depth of the bucket at bucket_idx
+   */
+  uint32_t GetLocalDepth(uint32_t bucket_idx);
+
+  /**
+   * @param bucket_idx bucket index to update
+   * @param local_depth new local depth
+   */
+  void SetLocalDepth(uint32_t bucket_idx, uint8_t local_depth);
+
+  /** @param bucket_idx bucket index to increment */
+  void IncrLocalDepth(uint32_t bucket_idx);
+
+  /** @param bucket_idx bucket index to decrement */
+  void DecrLocalDepth(uint32_t bucket_idx);
+
+  /**
+   * @param bucket_idx the index to use for looking up local depth
+   * @return mask of local 1's and the rest 0's (with 1's from LSB upwards)
+   */
+  uint32_t GetLocalDepthMask(uint32_t bucket_idx);
+
+  /**
+   * @param bucket_idx the directory index for which to find the split image
+   * @return the directory index of the split image
+   */
+  uint32_t GetSplitImageIndex(uint32_t bucket_idx);
+
+  /**
+   * Doubles the directory. Past MAX_BUCKET_DEPTH this copies every directory page into a new one.
+   */
+  void IncrGlobalDepth();
+
+  /**
+   * Halves the directory. Past MAX_BUCKET_DEPTH this takes the upper half of the directory pages out of the header
+   * page. They are not deleted here: an optimistic reader may still have one pinned, so the caller has to be able to
+   * retry the deletion.
+   * @return the directory pages taken out of the directory, for the caller to delete
+   */
+  std::vector<page_id_t> DecrGlobalDepth();
+
+  /** @return true if the directory can be shrunk */
+  bool CanShrink();
+
+  /**
+   * Verify the invariants of HashTableDirectoryPage::VerifyIntegrity over the whole directory.
+   */
+  void VerifyIntegrity();
+
+ private:
+  /**
+   * @param bucket_idx an index in the directory
+   * @param for_write true if the entry is going to be modified
+   * @return the directory page holding the entry, pinned until another directory page is needed
+   */
+  HashTableDirectoryPage *DirectoryPageOf(uint32_t bucket_idx, bool for_write);
+
+  /** @return the slot of a directory index in its directory page */
+  static uint32_t SlotOf(uint32_t bucket_idx) { return bucket_idx & (DIRECTORY_ARRAY_SIZE - 1); }
+
+  /** Unpins the directory page held, if any. */
+  void ReleaseDirectoryPage();
+
+  BufferPoolManager *buffer_pool_manager_;
+  HashTableDirectoryHeaderPage *header_;
+  Page *directory_page_ = nullptr;
+  uint32_t directory_idx_ = 0;
+  bool is_dirty_ = false;
+};
+
+}  // namespace bustub
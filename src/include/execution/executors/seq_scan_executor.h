@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
+#include "buffer/buffer_access_strategy.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
@@ -52,5 +54,7 @@ class SeqScanExecutor : public AbstractExecutor {
   const SeqScanPlanNode *plan_;
   TableHeap *table_heap_;
   TableIterator iter_;
+  /** 扫描专用的环形缓冲区，避免大表扫描把共享缓冲池里的热点页面冲掉 */
+  std::unique_ptr<BufferAccessStrategy> strategy_;
 };
 }  // namespace bustub
@@ -12,16 +12,51 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <future>  // NOLINT
+#include <map>
 #include <mutex>   // NOLINT
+#include <set>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "common/rwlatch.h"
 
 namespace bustub {
 
+/**
+ * How DiskManager accesses the database file.
+ * STREAM goes through a std::fstream and serializes all page I/O on one latch.
+ * PREAD uses pread/pwrite on a file descriptor, so reads and writes of different pages run concurrently.
+ * DIRECT is PREAD on a descriptor opened with O_DIRECT, bypassing the page cache. Buffers that are not aligned to
+ * DIRECT_IO_ALIGNMENT are bounced through an aligned one, frames of a buffer pool always are aligned. Falls back to
+ * PREAD if the file system does not support O_DIRECT.
+ * MMAP is for database files that no longer change, such as those of read-only replicas. The file is mapped into
+ * memory as it is at construction, so opening it reads nothing. Pages are copied out of the mapping without any latch,
+ * or handed out in place by BorrowPage, which is how a buffer pool fills its frames. Writes throw, checksums are not
+ * verified and the free space map is not persisted. Not supported with compressed pages.
+ */
+enum class DiskIOBackend { STREAM, PREAD, DIRECT, MMAP };
+
+/**
+ * Whether DiskManager checksums pages.
+ * NONE stores no checksums.
+ * DETECT stamps a CRC-32C on every page write, kept in a file next to the database file, and verifies it on every read.
+ * A mismatch, from corruption or from a write torn by a crash, is counted and logged, and the page is returned as read.
+ * ENFORCE also throws an Exception of type CORRUPTION from the read. A buffer pool backs out of the failed read, so
+ * that the page is not left behind in it, and passes the exception on to the caller of the fetch.
+ * A database file that has checksums must keep being opened with them, writes without them leave stale checksums.
+ */
+enum class ChecksumPolicy { NONE, DETECT, ENFORCE };
+
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
@@ -31,10 +66,20 @@ class DiskManager {
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param backend how pages are read from and written to the database file
+   * @param io_queue_depth the number of asynchronous page reads and writes that are carried out at the same time
+   * @param checksum_policy whether pages are checksummed
+   * @param compress_pages whether pages are stored compressed. Compressed pages take up a variable number of
+   * COMPRESSED_SECTOR_SIZE sectors of the database file, located through a page id to extent map kept in a file next
+   * to it; a page that does not compress by at least a sector is stored as it is. Compressed pages are read and
+   * written with pread/pwrite whatever the backend, and writes are serialized. A database file written compressed must
+   * keep being opened compressed and vice versa.
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, DiskIOBackend backend = DiskIOBackend::STREAM,
+                       size_t io_queue_depth = DISK_IO_QUEUE_DEPTH,
+                       ChecksumPolicy checksum_policy = ChecksumPolicy::NONE, bool compress_pages = false);
 
-  ~DiskManager() = default;
+  ~DiskManager();
 
   /**
    * Shut down the disk manager and close all the file resources.
@@ -55,6 +100,106 @@ class DiskManager {
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
+  /**
+   * Lend out a page of a database file opened with the MMAP backend, without copying it.
+   * @param page_id id of the page
+   * @return the page in the read-only mapping of the database file, valid until ShutDown, nullptr if the backend is
+   * not MMAP or the page lies past the end of the file
+   */
+  const char *BorrowPage(page_id_t page_id) const;
+
+  /**
+   * Read a run of consecutive pages from the database file with a single positioning of the file.
+   * @param first_page_id id of the first page of the run
+   * @param[out] pages_data output buffers, one per page of the run
+   */
+  void ReadPages(page_id_t first_page_id, const std::vector<char *> &pages_data);
+
+  /**
+   * Write a batch of pages to the database file and make it durable. The pages are sorted by offset, runs of
+   * consecutive pages are written with one vectored write each, and the file is synced once for the whole batch.
+   * @param pages (page id, raw page data) pairs, the page ids must be distinct
+   */
+  void WritePages(std::vector<std::pair<page_id_t, const char *>> pages);
+
+  /**
+   * Write a page to the database file on an I/O thread. The page data must stay valid until the write has completed.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   * @param callback called on the I/O thread once the write has completed, before the future becomes ready
+   * @return a future that becomes ready once the write has completed
+   */
+  std::future<void> WritePageAsync(page_id_t page_id, const char *page_data,
+                                   std::function<void()> callback = nullptr);
+
+  /**
+   * Read a page from the database file on an I/O thread.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer, must stay valid until the read has completed
+   * @param callback called on the I/O thread once the read has completed, before the future becomes ready
+   * @return a future that becomes ready once the read has completed
+   */
+  std::future<void> ReadPageAsync(page_id_t page_id, char *page_data, std::function<void()> callback = nullptr);
+
+  /**
+   * Read a run of consecutive pages on an I/O thread, see ReadPages.
+   * @param first_page_id id of the first page of the run
+   * @param[out] pages_data output buffers, one per page of the run, must stay valid until the read has completed
+   * @return a future that becomes ready once the read has completed
+   */
+  std::future<void> ReadPagesAsync(page_id_t first_page_id, std::vector<char *> pages_data);
+
+  /** @return the number of asynchronous reads and writes that are queued or running */
+  inline int GetNumInflightIO() const { return num_inflight_io_; }
+
+  /** @return the number of asynchronous reads and writes submitted so far */
+  inline uint64_t GetNumAsyncIO() const { return num_async_io_; }
+
+  /** @return the number of asynchronous reads and writes that are carried out at the same time */
+  inline size_t GetIOQueueDepth() const { return io_queue_depth_; }
+
+  /**
+   * Return a deleted page to the free space map, so that a later allocation can reuse it. The map is kept in a file
+   * next to the database file and survives restarts. Page ids that were never allocated are rejected, since the
+   * allocator would hand them out again.
+   * @param page_id id of the deleted page
+   * @return false if the page was never allocated, true otherwise
+   */
+  bool DeallocatePage(page_id_t page_id);
+
+  /**
+   * Record that a page id was handed out by an allocator. Writing a page records it as well.
+   * @param page_id id of the allocated page
+   */
+  void MarkPageAllocated(page_id_t page_id);
+
+  /**
+   * @return one past the largest page id allocated so far. After a restart it starts past every page of the database
+   * file and of the free space map, so allocators that start from it do not hand out a page id twice.
+   */
+  inline page_id_t GetNumAllocatedPages() const { return num_allocated_pages_; }
+
+  /**
+   * Take a free page out of the free space map, the smallest one first. Page ids of a parallel buffer pool are
+   * partitioned over its instances, so only pages of the given instance are considered.
+   * @param num_instances the number of instances the page ids are partitioned over
+   * @param instance_index the instance the page has to belong to, by page id modulo num_instances
+   * @return the id of the reused page, INVALID_PAGE_ID if there is none
+   */
+  page_id_t AllocateFreePage(uint32_t num_instances = 1, uint32_t instance_index = 0);
+
+  /** @return the number of pages in the free space map */
+  size_t GetNumFreePages();
+
+  /**
+   * Give the disk space of free pages back to the file system: free pages at the end of the database file are
+   * truncated away, and the ones in the middle, which cannot be moved because page ids are referenced by other pages,
+   * become holes. The pages stay in the free space map and read as zeroes.
+   * With compressed pages, the free extents are truncated away or punched instead.
+   * @return the number of pages whose space was reclaimed, in PAGE_SIZE units with compressed pages
+   */
+  size_t CompactFreePages();
+
   /**
    * Flush the entire log buffer into disk.
    * @param log_data raw log data
@@ -80,6 +225,21 @@ class DiskManager {
   /** @return the number of disk writes */
   int GetNumWrites() const;
 
+  /** @return the number of page reads whose checksum did not match */
+  inline uint64_t GetNumChecksumFailures() const { return num_checksum_failures_; }
+
+  /** @return the number of times the database file was synced to disk */
+  inline int GetNumSyncs() const { return num_syncs_; }
+
+  /**
+   * @return the number of bytes the pages take up in the database file: the sectors of their extents with compressed
+   * pages, the size of the file otherwise
+   */
+  uint64_t GetStoredBytes();
+
+  /** @return how pages are accessed, DIRECT turns into PREAD if the file could not be opened with O_DIRECT */
+  inline DiskIOBackend GetBackend() const { return backend_; }
+
   /**
    * Sets the future which is used to check for non-blocking flushes.
    * @param f the non-blocking flush check
@@ -91,18 +251,157 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
+  /** The page I/O proper, wrapped by the public methods to stamp and verify checksums. */
+  void WritePageUnchecked(page_id_t page_id, const char *page_data);
+  void ReadPageUnchecked(page_id_t page_id, char *page_data);
+  void ReadPagesUnchecked(page_id_t first_page_id, const std::vector<char *> &pages_data);
+  void WritePagesUnchecked(std::vector<std::pair<page_id_t, const char *>> pages);
+
+  /**
+   * Read or write one page through the file descriptor, bouncing it through an aligned buffer if O_DIRECT needs one.
+   * A read past the end of the file is zero filled.
+   */
+  void ReadPageFd(page_id_t page_id, char *page_data);
+  void WritePageFd(page_id_t page_id, const char *page_data);
+
+  /**
+   * Queue an I/O request for the I/O threads, starting them on first use.
+   * @param io the request
+   * @param callback called after the request, may be nullptr
+   * @return a future that becomes ready after the callback
+   */
+  std::future<void> SubmitIO(std::function<void()> io, std::function<void()> callback);
+
+  /** Let the I/O threads finish the queued requests, then join them. */
+  void StopIOThreads();
+
+  /** Body of the I/O threads. */
+  void IOThread();
+
+  /** Open the free space map file and load it, or reset it if the database file is new. */
+  void OpenFreeSpaceMap();
+
+  /** Mark a page free or allocated in the free space map and write the change through. fsm_latch_ must be held. */
+  void SetPageFree(page_id_t page_id, bool is_free);
+
+  /** Open the checksum file and load it, or reset it if the database file is new. */
+  void OpenChecksums();
+
+  /** @return the checksum as stored, 0 is reserved for pages without a checksum */
+  static uint32_t ToStoredChecksum(uint32_t checksum);
+
+  /** Lock the checksum stripes of the pages in a deadlock-free order. */
+  std::vector<std::unique_lock<std::mutex>> LockChecksumStripes(const std::vector<page_id_t> &page_ids);
+
+  /** Record the checksum of a page and write it through, 0 to forget it. Its stripe must be held. */
+  void StampChecksum(page_id_t page_id, uint32_t checksum);
+
+  /** Count, log and with ENFORCE throw a checksum mismatch of a page just read. */
+  void VerifyChecksum(page_id_t page_id, const char *page_data);
+
+  /** Where a compressed page is stored in the database file. Also its layout in the extent map file. */
+  struct PageExtent {
+    /** The first sector of the page, in COMPRESSED_SECTOR_SIZE units. */
+    uint32_t first_sector_;
+    /** The number of stored bytes, PAGE_SIZE if the page is stored uncompressed, 0 if the page has no extent. */
+    uint32_t length_;
+
+    /** @return the number of sectors the page takes up */
+    uint32_t NumSectors() const { return (length_ + COMPRESSED_SECTOR_SIZE - 1) / COMPRESSED_SECTOR_SIZE; }
+  };
+
+  /** Set the allocation high-water mark from the pages already in the database file and the free space map. */
+  void InitNumAllocatedPages();
+
+  /** Open the extent map file and load it, or reset it if the database file is new. */
+  void OpenExtentMap();
+
+  /** Map the database file read-only for the MMAP backend. */
+  void OpenMapping();
+
+  /** Unmap the database file. */
+  void CloseMapping();
+
+  /** Read, write or drop a compressed page. */
+  void ReadPageCompressed(page_id_t page_id, char *page_data);
+  void WritePageCompressed(page_id_t page_id, const char *page_data);
+  void DeallocateExtent(page_id_t page_id);
+
+  /** Find room for an extent of the given number of sectors, first fit. extent_latch_ must be held. */
+  uint32_t AllocateSectors(uint32_t num_sectors);
+
+  /** Give sectors back, merging them with adjacent free ones. extent_latch_ must be held. */
+  void ReleaseSectors(uint32_t first_sector, uint32_t num_sectors);
+
+  /** Set the extent of a page and write it through. extent_latch_ must be held. */
+  void SetExtent(page_id_t page_id, PageExtent extent);
+
+  /** Truncate and punch the free extents, see CompactFreePages. */
+  size_t CompactExtents();
+
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
+  // descriptor of the db file for the PREAD and DIRECT backends, -1 otherwise
+  int db_fd_ = -1;
+  // read-only mapping of the db file for the MMAP backend, nullptr otherwise or if the file is empty
+  char *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  DiskIOBackend backend_;
   int num_flushes_;
-  int num_writes_;
+  std::atomic<int> num_writes_;
+  std::atomic<int> num_syncs_ = 0;
   bool flush_log_;
   std::future<void> *flush_log_f_;
-  // With multiple buffer pool instances, need to protect file access
+  // With multiple buffer pool instances, need to protect file access. Only used by the STREAM backend.
   std::mutex db_io_latch_;
+
+  // free space map: one bit per page, set if the page is free, mirrored in the file fsm_name_
+  std::string fsm_name_;
+  int fsm_fd_ = -1;
+  std::vector<uint8_t> free_map_;
+  std::set<page_id_t> free_pages_;
+  // protects the free space map
+  std::mutex fsm_latch_;
+  // one past the largest page id allocated or written so far
+  std::atomic<page_id_t> num_allocated_pages_ = 0;
+
+  // page checksums, one per page id, mirrored in the file crc_name_
+  ChecksumPolicy checksum_policy_;
+  std::string crc_name_;
+  int crc_fd_ = -1;
+  std::vector<uint32_t> checksums_;
+  // protects checksums_ and crc_fd_
+  std::mutex crc_latch_;
+  // a write or read of a page holds its stripe, so that the page and its checksum always change together
+  static constexpr size_t CHECKSUM_STRIPES = 64;
+  std::array<std::mutex, CHECKSUM_STRIPES> checksum_stripes_;
+  std::atomic<uint64_t> num_checksum_failures_ = 0;
+
+  // compressed pages: the extent of every page, mirrored in the file ext_name_, and the free sectors between them
+  bool compress_pages_;
+  std::string ext_name_;
+  int ext_fd_ = -1;
+  std::vector<PageExtent> extents_;
+  // free runs of sectors below end_sector_, first sector -> number of sectors
+  std::map<uint32_t, uint32_t> free_sectors_;
+  uint32_t end_sector_ = 0;
+  // protects the extents, shared by reads and exclusive for writes, so that a sector is not reused under a read
+  ReaderWriterLatch extent_latch_;
+
+  // asynchronous I/O requests waiting for an I/O thread
+  std::deque<std::function<void()>> io_queue_;
+  // protects io_queue_, io_threads_ and io_stop_
+  std::mutex io_queue_latch_;
+  std::condition_variable io_queue_cv_;
+  std::vector<std::thread> io_threads_;
+  bool io_stop_ = false;
+  size_t io_queue_depth_;
+  std::atomic<int> num_inflight_io_ = 0;
+  std::atomic<uint64_t> num_async_io_ = 0;
 };
 
 }  // namespace bustub
@@ -15,6 +15,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "container/hash/extendible_hash_table.h"
@@ -31,6 +32,11 @@ class ExtendibleHashTableIndex : public Index {
   ExtendibleHashTableIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
                            const HashFunction<KeyType> &hash_fn);
 
+  /** Create the index and bulk load it with the given index keys and the RIDs associated with them. */
+  ExtendibleHashTableIndex(std::unique_ptr<IndexMetadata> &&metadata, BufferPoolManager *buffer_pool_manager,
+                           const HashFunction<KeyType> &hash_fn,
+                           const std::vector<std::pair<KeyType, ValueType>> &entries);
+
   ~ExtendibleHashTableIndex() override = default;
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
@@ -39,6 +45,11 @@ class ExtendibleHashTableIndex : public Index {
 
   void ScanKey(const Tuple &key, std::vector<RID> *result, Transaction *transaction) override;
 
+  void InsertEntries(const std::vector<std::pair<Tuple, RID>> &entries, Transaction *transaction) override;
+
+  void ScanKeys(const std::vector<Tuple> &keys, std::vector<std::vector<RID>> *results,
+                Transaction *transaction) override;
+
  protected:
   // comparator for key
   KeyComparator comparator_;
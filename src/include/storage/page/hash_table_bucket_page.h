@@ -33,6 +33,14 @@ namespace bustub {
  *  The above format omits the space required for the occupied_ and
  *  readable_ arrays. More information is in storage/page/hash_table_page_defs.h.
  *
+ *  Each slot also has a one byte fingerprint, the top byte of the 32-bit hash
+ *  of its key. A lookup compares the fingerprints of 64 slots at a time with
+ *  SIMD instructions and only calls the comparator on the slots that match.
+ *  The hash is passed in by the hash table, which computes it once per key
+ *  with its own hash function; the overloads without a hash use the default
+ *  HashFunction. A bucket must be accessed with the same hash function
+ *  throughout.
+ *
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class HashTableBucketPage {
@@ -47,6 +55,14 @@ class HashTableBucketPage {
    */
   bool GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result);
 
+  /**
+   * Scan the bucket and collect values that have the matching key
+   *
+   * @param hash the hash of the key, the same the directory is indexed with
+   * @return true if at least one key matched
+   */
+  bool GetValue(KeyType key, uint32_t hash, KeyComparator cmp, std::vector<ValueType> *result);
+
   /**
    * Attempts to insert a key and value in the bucket.  Uses the occupied_
    * and readable_ arrays to keep track of each slot's availability.
@@ -58,6 +74,16 @@ class HashTableBucketPage {
    */
   bool Insert(KeyType key, ValueType value, KeyComparator cmp);
 
+  /**
+   * Attempts to insert a key and value in the bucket, see Insert above.
+   *
+   * @param key key to insert
+   * @param value value to insert
+   * @param hash the hash of the key, the same the directory is indexed with
+   * @return true if inserted, false if duplicate KV pair or bucket is full
+   */
+  bool Insert(KeyType key, ValueType value, uint32_t hash, KeyComparator cmp);
+
   /**
    * Removes a key and value.
    *
@@ -65,6 +91,14 @@ class HashTableBucketPage {
    */
   bool Remove(KeyType key, ValueType value, KeyComparator cmp);
 
+  /**
+   * Removes a key and value.
+   *
+   * @param hash the hash of the key, the same the directory is indexed with
+   * @return true if removed, false if not found
+   */
+  bool Remove(KeyType key, ValueType value, uint32_t hash, KeyComparator cmp);
+
   /**
    * Gets the key at an index in the bucket.
    *
@@ -143,10 +177,47 @@ class HashTableBucketPage {
   void Reset();
 
  private:
+  /** Number of 64-bit words covering the readable_ bitmap. */
+  static constexpr uint32_t NUM_BITMAP_WORDS = (BUCKET_ARRAY_SIZE - 1) / 64 + 1;
+
+  /**
+   * @param key the key to hash
+   * @return the hash of the key with the default HashFunction, for the overloads that are not given a hash
+   */
+  static uint32_t DefaultHash(const KeyType &key);
+
+  /**
+   * @param hash the hash of a key
+   * @return the top byte of the hash. The directory is indexed by the low bits of the same hash, at most
+   * MAX_GLOBAL_DEPTH of them, so the two do not overlap.
+   */
+  static uint8_t Fingerprint(uint32_t hash);
+
+  /**
+   * @param word_idx the word to get, covering the slots [64 * word_idx, 64 * word_idx + 64)
+   * @return a mask of the slots of the word that exist in the bucket
+   */
+  static uint64_t SlotMask(uint32_t word_idx);
+
+  /**
+   * @param word_idx the word to get, covering the slots [64 * word_idx, 64 * word_idx + 64)
+   * @return the readable flags of the slots of the word, bit i for slot 64 * word_idx + i
+   */
+  uint64_t ReadableWord(uint32_t word_idx) const;
+
+  /**
+   * @param fingerprint the fingerprint to look for
+   * @param word_idx the word to probe, covering the slots [64 * word_idx, 64 * word_idx + 64)
+   * @return a mask of the readable slots of the word whose fingerprint matches
+   */
+  uint64_t MatchFingerprints(uint8_t fingerprint, uint32_t word_idx) const;
+
   // For more on BUCKET_ARRAY_SIZE see storage/page/hash_table_page_defs.h
   char occupied_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
   // 0 if tombstone/brand new (never occupied), 1 otherwise.
   char readable_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
+  // Fingerprint of the key in each slot, only meaningful for readable slots.
+  uint8_t fingerprints_[BUCKET_ARRAY_SIZE];
   // Do not add any members below array_, as they will overlap.
   MappingType array_[BUCKET_ARRAY_SIZE];
 };
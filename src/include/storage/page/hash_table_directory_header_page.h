@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory_header_page.h
+//
+// Identification: src/include/storage/page/hash_table_directory_header_page.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "common/config.h"
+#include "storage/page/hash_table_directory_page.h"
+#include "storage/page/hash_table_page_defs.h"
+
+namespace bustub {
+
+/** The largest global depth of an extendible hash table: a full directory page for each header slot. */
+#define MAX_GLOBAL_DEPTH (MAX_BUCKET_DEPTH + 9)
+
+/**
+ * Header page of the directory of an extendible hash table. The directory is one logical array of 2^GlobalDepth
+ * entries, cut into slices of DIRECTORY_ARRAY_SIZE entries that are stored in directory pages; the header lists them.
+ * Directory index i lives in slot i % DIRECTORY_ARRAY_SIZE of directory page i / DIRECTORY_ARRAY_SIZE, and every
+ * directory page has the global depth of the header.
+ *
+ * Header format (size in byte):
+ * ------------------------------------------------------------------------
+ * | LSN (4) | PageId(4) | GlobalDepth(4) | DirectoryPageIds(2048) | Free(2036)
+ * ------------------------------------------------------------------------
+ */
+class HashTableDirectoryHeaderPage {
+ public:
+  /** @return the page ID of this page */
+  page_id_t GetPageId() const;
+
+  /**
+   * Sets the page ID of this page
+   *
+   * @param page_id the page id to which to set the page_id_ field
+   */
+  void SetPageId(page_id_t page_id);
+
+  /** @return the lsn of this page */
+  lsn_t GetLSN() const;
+
+  /**
+   * Sets the LSN of this page
+   *
+   * @param lsn the log sequence number to which to set the lsn field
+   */
+  void SetLSN(lsn_t lsn);
+
+  /** @return the global depth of the whole directory */
+  uint32_t GetGlobalDepth() const;
+
+  /**
+   * Sets the global depth of the whole directory
+   *
+   * @param global_depth the new global depth, at most MAX_GLOBAL_DEPTH
+   */
+  void SetGlobalDepth(uint32_t global_depth);
+
+  /** @return the number of directory pages the directory takes up at its global depth */
+  uint32_t NumDirectoryPages() const;
+
+  /**
+   * @param directory_idx the index of the directory page, i.e. directory index / DIRECTORY_ARRAY_SIZE
+   * @return the page id of the directory page
+   */
+  page_id_t GetDirectoryPageId(uint32_t directory_idx) const;
+
+  /**
+   * @param directory_idx the index of the directory page
+   * @param directory_page_id the page id of the directory page
+   */
+  void SetDirectoryPageId(uint32_t directory_idx, page_id_t directory_page_id);
+
+ private:
+  page_id_t page_id_;
+  lsn_t lsn_;
+  uint32_t global_depth_{0};
+  page_id_t directory_page_ids_[DIRECTORY_HEADER_ARRAY_SIZE];
+};
+
+static_assert(1 << (MAX_GLOBAL_DEPTH - MAX_BUCKET_DEPTH) == DIRECTORY_HEADER_ARRAY_SIZE);
+static_assert(1 << MAX_BUCKET_DEPTH == DIRECTORY_ARRAY_SIZE);
+static_assert(sizeof(HashTableDirectoryHeaderPage) <= PAGE_SIZE);
+
+}  // namespace bustub
@@ -115,6 +115,14 @@ class HashTableDirectoryPage {
    */
   uint32_t GetGlobalDepth();
 
+  /**
+   * Set the global depth of the directory. Used when the directory spans several pages: every page then carries the
+   * global depth of the whole directory and only holds DIRECTORY_ARRAY_SIZE of its entries.
+   *
+   * @param global_depth the new global depth
+   */
+  void SetGlobalDepth(uint32_t global_depth);
+
   /**
    * Increment the global depth of the directory
    */
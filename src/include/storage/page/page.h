@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -23,15 +24,16 @@ namespace bustub {
 /**
  * Page is the basic unit of storage within the database system. Page provides a wrapper for actual data pages being
  * held in main memory. Page also contains book-keeping information that is used by the buffer pool manager, e.g.
- * pin count, dirty flag, page id, etc.
+ * pin count, dirty flag, page id, etc. The page data itself is not part of this object, it lives in the frame memory
+ * that the buffer pool allocates separately.
  */
 class Page {
   // There is book-keeping information inside the page that should only be relevant to the buffer pool manager.
   friend class BufferPoolManagerInstance;
 
  public:
-  /** Constructor. Zeros out the page data. */
-  Page() { ResetMemory(); }
+  /** Constructor. The buffer pool points the page at the data of its frame. */
+  Page() = default;
 
   /** Default destructor. */
   ~Page() = default;
@@ -48,11 +50,18 @@ class Page {
   /** @return true if the page in memory has been modified from the page on disk, false otherwise */
   inline bool IsDirty() { return is_dirty_; }
 
-  /** Acquire the page write latch. */
-  inline void WLatch() { rwlatch_.WLock(); }
+  /** Acquire the page write latch. The version of the page becomes odd while the latch is held. */
+  inline void WLatch() {
+    rwlatch_.WLock();
+    version_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
 
   /** Release the page write latch. */
-  inline void WUnlatch() { rwlatch_.WUnlock(); }
+  inline void WUnlatch() {
+    version_.fetch_add(1, std::memory_order_release);
+    rwlatch_.WUnlock();
+  }
 
   /** Acquire the page read latch. */
   inline void RLatch() { rwlatch_.RLock(); }
@@ -60,6 +69,27 @@ class Page {
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /**
+   * Start an optimistic read of the page, i.e. a read without any latch. Whatever is read from the page may be torn
+   * and must not be trusted until ValidateOptimisticRead succeeds. The page must stay pinned throughout.
+   * @param[out] version the version of the page to validate against
+   * @return false if a writer currently holds the page, true otherwise
+   */
+  inline bool TryOptimisticRead(uint64_t *version) {
+    *version = version_.load(std::memory_order_acquire);
+    return (*version & 1) == 0;
+  }
+
+  /**
+   * Finish an optimistic read of the page.
+   * @param version the version returned by TryOptimisticRead
+   * @return true if no writer latched the page since TryOptimisticRead, i.e. everything read in between is consistent
+   */
+  inline bool ValidateOptimisticRead(uint64_t version) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+  }
+
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
@@ -78,16 +108,18 @@ class Page {
   /** Zeroes out the data that is held within the page. */
   inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }
 
-  /** The actual data that is stored within a page. */
-  char data_[PAGE_SIZE]{};
-  /** The ID of this page. */
-  page_id_t page_id_ = INVALID_PAGE_ID;
+  /** The actual data that is stored within a page. It lives in the frame memory of the buffer pool. */
+  char *data_ = nullptr;
+  /** The ID of this page. Atomic so that the buffer pool can peek at the page held by a frame it does not own. */
+  std::atomic<page_id_t> page_id_ = INVALID_PAGE_ID;
   /** The pin count of this page. */
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
+  /** Bumped by every WLatch and WUnlatch, odd while a writer holds the latch. Used to validate optimistic reads. */
+  std::atomic<uint64_t> version_ = 0;
 };
 
 }  // namespace bustub
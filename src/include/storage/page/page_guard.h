@@ -0,0 +1,221 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_guard.h
+//
+// Identification: src/include/storage/page/page_guard.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "storage/page/page.h"
+
+namespace bustub {
+
+class BufferPoolManager;
+class ReadPageGuard;
+class WritePageGuard;
+
+/**
+ * BasicPageGuard keeps a page pinned for as long as it lives and unpins it when it is destroyed, dropped or
+ * overwritten, so that every fetch is paired with exactly one unpin. It does not latch the page.
+ *
+ * Guards are move-only. A moved-from guard is invalid and releases nothing.
+ */
+class BasicPageGuard {
+  friend class ReadPageGuard;
+  friend class WritePageGuard;
+
+ public:
+  BasicPageGuard() = default;
+
+  /**
+   * Take over the pin of a page.
+   * @param bpm the buffer pool manager the page was fetched from
+   * @param page the pinned page, nullptr makes an invalid guard
+   */
+  BasicPageGuard(BufferPoolManager *bpm, Page *page) : bpm_(bpm), page_(page) {}
+
+  BasicPageGuard(const BasicPageGuard &) = delete;
+  BasicPageGuard &operator=(const BasicPageGuard &) = delete;
+
+  BasicPageGuard(BasicPageGuard &&that) noexcept;
+
+  /** Release the page held so far, then take over the page of that. */
+  BasicPageGuard &operator=(BasicPageGuard &&that) noexcept;
+
+  ~BasicPageGuard() { Drop(); }
+
+  /** Unpin the page, marking it dirty if it was written through this guard. The guard becomes invalid. */
+  void Drop();
+
+  /**
+   * Read latch the page and hand the pin over to a read guard. This guard becomes invalid.
+   * @return the read guard of the page
+   */
+  ReadPageGuard UpgradeRead();
+
+  /**
+   * Write latch the page and hand the pin over to a write guard. This guard becomes invalid.
+   * @return the write guard of the page
+   */
+  WritePageGuard UpgradeWrite();
+
+  /** @return true if the guard holds a page */
+  bool IsValid() const { return page_ != nullptr; }
+
+  /** @return the page id of the guarded page */
+  page_id_t PageId() const { return page_->GetPageId(); }
+
+  /** @return the data of the guarded page, for reading */
+  const char *GetData() const { return page_->GetData(); }
+
+  /** @return the data of the guarded page, for writing. The page is unpinned as dirty. */
+  char *GetDataMut() {
+    is_dirty_ = true;
+    return page_->GetData();
+  }
+
+  /** @return the guarded page viewed as a page type derived from Page, for reading */
+  template <class T>
+  T *As() const {
+    return static_cast<T *>(page_);
+  }
+
+  /** @return the guarded page viewed as a page type derived from Page, for writing. The page is unpinned as dirty. */
+  template <class T>
+  T *AsMut() {
+    is_dirty_ = true;
+    return static_cast<T *>(page_);
+  }
+
+  /**
+   * Unpin the page as dirty. Meant for writes that went through As() because it was not known upfront whether they
+   * would modify the page.
+   */
+  void SetDirty() { is_dirty_ = true; }
+
+ private:
+  BufferPoolManager *bpm_ = nullptr;
+  Page *page_ = nullptr;
+  bool is_dirty_ = false;
+};
+
+/**
+ * ReadPageGuard keeps a page pinned and read latched for as long as it lives, and releases both when it is destroyed,
+ * dropped or overwritten.
+ */
+class ReadPageGuard {
+  friend class BasicPageGuard;
+
+ public:
+  ReadPageGuard() = default;
+
+  /**
+   * Take over the pin of a page and read latch it.
+   * @param bpm the buffer pool manager the page was fetched from
+   * @param page the pinned page, nullptr makes an invalid guard
+   */
+  ReadPageGuard(BufferPoolManager *bpm, Page *page);
+
+  ReadPageGuard(const ReadPageGuard &) = delete;
+  ReadPageGuard &operator=(const ReadPageGuard &) = delete;
+
+  ReadPageGuard(ReadPageGuard &&that) noexcept = default;
+
+  /** Release the page held so far, then take over the page of that. */
+  ReadPageGuard &operator=(ReadPageGuard &&that) noexcept;
+
+  ~ReadPageGuard() { Drop(); }
+
+  /** Unlatch and unpin the page. The guard becomes invalid. */
+  void Drop();
+
+  /** @return true if the guard holds a page */
+  bool IsValid() const { return guard_.IsValid(); }
+
+  /** @return the page id of the guarded page */
+  page_id_t PageId() const { return guard_.PageId(); }
+
+  /** @return the data of the guarded page */
+  const char *GetData() const { return guard_.GetData(); }
+
+  /** @return the guarded page viewed as a page type derived from Page */
+  template <class T>
+  T *As() const {
+    return guard_.As<T>();
+  }
+
+ private:
+  BasicPageGuard guard_;
+};
+
+/**
+ * WritePageGuard keeps a page pinned and write latched for as long as it lives, and releases both when it is
+ * destroyed, dropped or overwritten. The page is unpinned as dirty once it has been accessed for writing.
+ */
+class WritePageGuard {
+  friend class BasicPageGuard;
+
+ public:
+  WritePageGuard() = default;
+
+  /**
+   * Take over the pin of a page and write latch it.
+   * @param bpm the buffer pool manager the page was fetched from
+   * @param page the pinned page, nullptr makes an invalid guard
+   */
+  WritePageGuard(BufferPoolManager *bpm, Page *page);
+
+  WritePageGuard(const WritePageGuard &) = delete;
+  WritePageGuard &operator=(const WritePageGuard &) = delete;
+
+  WritePageGuard(WritePageGuard &&that) noexcept = default;
+
+  /** Release the page held so far, then take over the page of that. */
+  WritePageGuard &operator=(WritePageGuard &&that) noexcept;
+
+  ~WritePageGuard() { Drop(); }
+
+  /** Unlatch and unpin the page, marking it dirty if it was written. The guard becomes invalid. */
+  void Drop();
+
+  /** @return true if the guard holds a page */
+  bool IsValid() const { return guard_.IsValid(); }
+
+  /** @return the page id of the guarded page */
+  page_id_t PageId() const { return guard_.PageId(); }
+
+  /** @return the data of the guarded page, for reading */
+  const char *GetData() const { return guard_.GetData(); }
+
+  /** @return the data of the guarded page, for writing. The page is unpinned as dirty. */
+  char *GetDataMut() { return guard_.GetDataMut(); }
+
+  /** @return the guarded page viewed as a page type derived from Page, for reading */
+  template <class T>
+  T *As() const {
+    return guard_.As<T>();
+  }
+
+  /** @return the guarded page viewed as a page type derived from Page, for writing. The page is unpinned as dirty. */
+  template <class T>
+  T *AsMut() {
+    return guard_.AsMut<T>();
+  }
+
+  /**
+   * Unpin the page as dirty. Meant for writes that went through As() because it was not known upfront whether they
+   * would modify the page.
+   */
+  void SetDirty() { guard_.SetDirty(); }
+
+ private:
+  BasicPageGuard guard_;
+};
+
+}  // namespace bustub
@@ -13,14 +13,18 @@
 #pragma once
 
 #include <cassert>
+#include <deque>
 
 #include "common/rid.h"
 #include "concurrency/transaction.h"
+#include "storage/page/page_guard.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
 
+class BufferAccessStrategy;
 class TableHeap;
+class TablePage;
 
 /**
  * TableIterator enables the sequential scan of a TableHeap.
@@ -29,10 +33,9 @@ class TableIterator {
   friend class Cursor;
 
  public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
-  TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+  TableIterator(const TableIterator &other);
 
   ~TableIterator() { delete tuple_; }
 
@@ -48,17 +51,27 @@ class TableIterator {
 
   TableIterator operator++(int);
 
-  TableIterator &operator=(const TableIterator &other) {
-    table_heap_ = other.table_heap_;
-    *tuple_ = *other.tuple_;
-    txn_ = other.txn_;
-    return *this;
-  }
+  TableIterator &operator=(const TableIterator &other);
 
  private:
+  /**
+   * Keep up to SCAN_PREFETCH_DEPTH pages after the current one being read in the background. Links of pages that are
+   * still being read are followed on a later call, so the window only grows as fast as the disk delivers.
+   * @param cur_page the page the iterator is on, read latched by the caller
+   */
+  void Prefetch(TablePage *cur_page);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** 批量读取的环形缓冲区，为空时使用共享的缓冲池 */
+  BufferAccessStrategy *strategy_;
+  /** 当前tuple所在的页面，在两次++之间一直pin着（但不加锁），走到末尾时放掉 */
+  BasicPageGuard page_guard_;
+  /** 预读窗口对应的当前页 */
+  page_id_t prefetch_page_id_ = INVALID_PAGE_ID;
+  /** 已经发起预读的后续页面，按链表顺序排列 */
+  std::deque<page_id_t> prefetched_;
 };
 
 }  // namespace bustub
@@ -10,34 +10,131 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>  // NOLINT
 #include <string>
 #include <thread>  // NOLINT
+#include <utility>
 
 #include "common/exception.h"
 #include "common/logger.h"
+#include "common/util/crc32c.h"
+#include "common/util/lz_compressor.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
 static char *buffer_used;
 
+namespace {
+
+/** @return true if a buffer can be handed to an O_DIRECT read or write as it is */
+bool IsAligned(const void *data) { return reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0; }
+
+/**
+ * 每个线程一个对齐的缓冲区，O_DIRECT读写没有对齐的数据时先复制到这里
+ */
+char *GetBounceBuffer() {
+  struct BounceBuffer {
+    char *data_ = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, PAGE_SIZE));
+    ~BounceBuffer() { std::free(data_); }  // NOLINT
+  };
+  thread_local BounceBuffer buffer;
+  return buffer.data_;
+}
+
+/**
+ * pread可能只读了一部分，读满size或者读到文件末尾为止
+ * @return the number of bytes read, -1 on error
+ */
+ssize_t PreadFull(int fd, char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+/**
+ * 写满size为止
+ * @return false on error
+ */
+bool PwriteFull(int fd, const char *data, size_t size, off_t offset) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pwrite(fd, data + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+}  // namespace
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, DiskIOBackend backend, size_t io_queue_depth,
+                         ChecksumPolicy checksum_policy, bool compress_pages)
+    : file_name_(db_file),
+      backend_(backend),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr),
+      checksum_policy_(checksum_policy),
+      compress_pages_(compress_pages),
+      io_queue_depth_(std::max<size_t>(io_queue_depth, 1)) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  fsm_name_ = file_name_.substr(0, n) + ".fsm";
+  if (checksum_policy_ != ChecksumPolicy::NONE) {
+    crc_name_ = file_name_.substr(0, n) + ".crc";
+  }
+  if (compress_pages_ && backend_ == DiskIOBackend::MMAP) {
+    throw Exception("compressed pages can't be mapped");
+  }
+  if (compress_pages_) {
+    ext_name_ = file_name_.substr(0, n) + ".ext";
+    // 压缩页面长度不定，不能按O_DIRECT的要求对齐，也没法用fstream按页定位
+    backend_ = DiskIOBackend::PREAD;
+  }
 
   log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
   // directory or file does not exist
@@ -53,6 +150,39 @@ DiskManager::DiskManager(const std::string &db_file)
     }
   }
 
+  if (backend_ == DiskIOBackend::MMAP) {
+    // 只读的文件不打开任何旁路文件，空闲页表只留在内存里，校验和也不检查
+    fsm_name_.clear();
+    checksum_policy_ = ChecksumPolicy::NONE;
+    OpenMapping();
+    InitNumAllocatedPages();
+    buffer_used = nullptr;
+    return;
+  }
+
+  if (backend_ != DiskIOBackend::STREAM) {
+    int flags = O_RDWR | O_CREAT;
+#ifdef O_DIRECT
+    if (backend_ == DiskIOBackend::DIRECT) {
+      db_fd_ = open(db_file.c_str(), flags | O_DIRECT, 0644);
+    }
+#endif
+    // 不支持O_DIRECT的文件系统(比如tmpfs)上打开会失败，退回到普通的pread/pwrite
+    if (db_fd_ < 0) {
+      backend_ = DiskIOBackend::PREAD;
+      db_fd_ = open(db_file.c_str(), flags, 0644);
+    }
+    if (db_fd_ < 0) {
+      throw Exception("can't open db file");
+    }
+    OpenFreeSpaceMap();
+    OpenChecksums();
+    OpenExtentMap();
+    InitNumAllocatedPages();
+    buffer_used = nullptr;
+    return;
+  }
+
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
   // directory or file does not exist
@@ -67,13 +197,59 @@ DiskManager::DiskManager(const std::string &db_file)
       throw Exception("can't open db file");
     }
   }
+  OpenFreeSpaceMap();
+  OpenChecksums();
+  InitNumAllocatedPages();
   buffer_used = nullptr;
 }
 
+DiskManager::~DiskManager() {
+  StopIOThreads();
+  CloseMapping();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+  }
+  if (fsm_fd_ >= 0) {
+    close(fsm_fd_);
+  }
+  if (crc_fd_ >= 0) {
+    close(crc_fd_);
+  }
+  if (ext_fd_ >= 0) {
+    close(ext_fd_);
+  }
+}
+
 /**
  * Close all file streams
  */
 void DiskManager::ShutDown() {
+  StopIOThreads();
+  CloseMapping();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+    db_fd_ = -1;
+  }
+  {
+    std::scoped_lock fsm_lock(fsm_latch_);
+    if (fsm_fd_ >= 0) {
+      close(fsm_fd_);
+      fsm_fd_ = -1;
+    }
+  }
+  {
+    std::scoped_lock crc_lock(crc_latch_);
+    if (crc_fd_ >= 0) {
+      close(crc_fd_);
+      crc_fd_ = -1;
+    }
+  }
+  if (ext_fd_ >= 0) {
+    extent_latch_.WLock();
+    close(ext_fd_);
+    ext_fd_ = -1;
+    extent_latch_.WUnlock();
+  }
   {
     std::scoped_lock scoped_db_io_latch(db_io_latch_);
     db_io_.close();
@@ -85,6 +261,91 @@ void DiskManager::ShutDown() {
  * Write the contents of the specified page into disk file
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  if (checksum_policy_ == ChecksumPolicy::NONE) {
+    WritePageUnchecked(page_id, page_data);
+    return;
+  }
+  // 调用者写盘时不一定持有页面的写锁，先复制一份，保证算校验和的和写下去的是同样的内容
+  char *data = GetBounceBuffer();
+  memcpy(data, page_data, PAGE_SIZE);
+  uint32_t checksum = ToStoredChecksum(Crc32c::Compute(data, PAGE_SIZE));
+  std::scoped_lock stripe_lock(checksum_stripes_[page_id % CHECKSUM_STRIPES]);
+  WritePageUnchecked(page_id, data);
+  StampChecksum(page_id, checksum);
+}
+
+void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  if (checksum_policy_ == ChecksumPolicy::NONE) {
+    ReadPageUnchecked(page_id, page_data);
+    return;
+  }
+  {
+    std::scoped_lock stripe_lock(checksum_stripes_[page_id % CHECKSUM_STRIPES]);
+    ReadPageUnchecked(page_id, page_data);
+  }
+  VerifyChecksum(page_id, page_data);
+}
+
+void DiskManager::ReadPages(page_id_t first_page_id, const std::vector<char *> &pages_data) {
+  if (checksum_policy_ == ChecksumPolicy::NONE) {
+    ReadPagesUnchecked(first_page_id, pages_data);
+    return;
+  }
+  std::vector<page_id_t> page_ids(pages_data.size());
+  for (size_t i = 0; i < pages_data.size(); i++) {
+    page_ids[i] = first_page_id + static_cast<page_id_t>(i);
+  }
+  {
+    auto stripe_locks = LockChecksumStripes(page_ids);
+    ReadPagesUnchecked(first_page_id, pages_data);
+  }
+  for (size_t i = 0; i < pages_data.size(); i++) {
+    VerifyChecksum(page_ids[i], pages_data[i]);
+  }
+}
+
+void DiskManager::WritePages(std::vector<std::pair<page_id_t, const char *>> pages) {
+  if (checksum_policy_ == ChecksumPolicy::NONE) {
+    WritePagesUnchecked(std::move(pages));
+    return;
+  }
+  // 和WritePage一样先复制再算校验和
+  std::unique_ptr<char, decltype(&std::free)> copies(
+      static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, pages.size() * PAGE_SIZE)), std::free);
+  std::vector<page_id_t> page_ids(pages.size());
+  std::vector<uint32_t> checksums(pages.size());
+  for (size_t i = 0; i < pages.size(); i++) {
+    char *copy = copies.get() + i * PAGE_SIZE;
+    memcpy(copy, pages[i].second, PAGE_SIZE);
+    page_ids[i] = pages[i].first;
+    pages[i].second = copy;
+    checksums[i] = ToStoredChecksum(Crc32c::Compute(copy, PAGE_SIZE));
+  }
+  auto stripe_locks = LockChecksumStripes(page_ids);
+  WritePagesUnchecked(std::move(pages));
+  for (size_t i = 0; i < page_ids.size(); i++) {
+    StampChecksum(page_ids[i], checksums[i]);
+  }
+  std::scoped_lock crc_lock(crc_latch_);
+  if (crc_fd_ >= 0 && fdatasync(crc_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing checksums");
+  }
+}
+
+void DiskManager::WritePageUnchecked(page_id_t page_id, const char *page_data) {
+  if (backend_ == DiskIOBackend::MMAP) {
+    throw Exception("can't write to a database file mapped read-only");
+  }
+  MarkPageAllocated(page_id);
+  if (compress_pages_) {
+    WritePageCompressed(page_id, page_data);
+    return;
+  }
+  if (db_fd_ >= 0) {
+    num_writes_ += 1;
+    WritePageFd(page_id, page_data);
+    return;
+  }
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
   // set write cursor to offset
@@ -103,7 +364,25 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
 /**
  * Read the contents of the specified page into the given memory area
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+void DiskManager::ReadPageUnchecked(page_id_t page_id, char *page_data) {
+  if (backend_ == DiskIOBackend::MMAP) {
+    // 文件不会再变，直接从映射里复制，不需要任何锁
+    const char *mapped = BorrowPage(page_id);
+    if (mapped != nullptr) {
+      memcpy(page_data, mapped, PAGE_SIZE);
+    } else {
+      memset(page_data, 0, PAGE_SIZE);
+    }
+    return;
+  }
+  if (compress_pages_) {
+    ReadPageCompressed(page_id, page_data);
+    return;
+  }
+  if (db_fd_ >= 0) {
+    ReadPageFd(page_id, page_data);
+    return;
+  }
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   int offset = page_id * PAGE_SIZE;
   // check if read beyond file length
@@ -129,6 +408,718 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   }
 }
 
+/**
+ * Read the contents of a run of consecutive pages into the given memory areas
+ */
+void DiskManager::ReadPagesUnchecked(page_id_t first_page_id, const std::vector<char *> &pages_data) {
+  if (compress_pages_ || backend_ == DiskIOBackend::MMAP) {
+    // 压缩页面在文件里不一定连续，映射的页面没有定位的开销，都逐页读
+    for (size_t i = 0; i < pages_data.size(); i++) {
+      ReadPageUnchecked(first_page_id + static_cast<page_id_t>(i), pages_data[i]);
+    }
+    return;
+  }
+  if (db_fd_ >= 0) {
+    // 一次preadv读完整段，O_DIRECT下有没对齐的缓冲区时只能逐页读
+    bool aligned = backend_ != DiskIOBackend::DIRECT ||
+                   std::all_of(pages_data.begin(), pages_data.end(), [](char *data) { return IsAligned(data); });
+    size_t num_read = 0;
+    if (aligned && pages_data.size() <= static_cast<size_t>(IOV_MAX)) {
+      std::vector<iovec> iov(pages_data.size());
+      for (size_t i = 0; i < pages_data.size(); i++) {
+        iov[i].iov_base = pages_data[i];
+        iov[i].iov_len = PAGE_SIZE;
+      }
+      auto offset = static_cast<off_t>(first_page_id) * PAGE_SIZE;
+      ssize_t n = preadv(db_fd_, iov.data(), static_cast<int>(iov.size()), offset);
+      num_read = n > 0 ? n / PAGE_SIZE : 0;
+    }
+    // 没读满的页面(文件末尾或者被中断)逐页补读
+    for (size_t i = num_read; i < pages_data.size(); i++) {
+      ReadPageFd(first_page_id + static_cast<page_id_t>(i), pages_data[i]);
+    }
+    return;
+  }
+  std::scoped_lock scoped_db_io_latch(db_io_latch_);
+  int offset = first_page_id * PAGE_SIZE;
+  int file_size = GetFileSize(file_name_);
+  // 连续的页面只定位一次，之后顺序读下去
+  db_io_.seekp(offset);
+  for (char *page_data : pages_data) {
+    // check if read beyond file length
+    if (offset > file_size) {
+      LOG_DEBUG("I/O error reading past end of file");
+      offset += PAGE_SIZE;
+      continue;
+    }
+    db_io_.read(page_data, PAGE_SIZE);
+    if (db_io_.bad()) {
+      LOG_DEBUG("I/O error while reading");
+      return;
+    }
+    // if file ends before reading PAGE_SIZE
+    int read_count = db_io_.gcount();
+    if (read_count < PAGE_SIZE) {
+      LOG_DEBUG("Read less than a page");
+      db_io_.clear();
+      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+    }
+    offset += PAGE_SIZE;
+  }
+}
+
+void DiskManager::ReadPageFd(page_id_t page_id, char *page_data) {
+  bool bounce = backend_ == DiskIOBackend::DIRECT && !IsAligned(page_data);
+  char *data = bounce ? GetBounceBuffer() : page_data;
+  ssize_t read_count = PreadFull(db_fd_, data, PAGE_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE);
+  if (read_count < 0) {
+    LOG_DEBUG("I/O error while reading");
+    return;
+  }
+  if (bounce) {
+    memcpy(page_data, data, read_count);
+  }
+  // if file ends before reading PAGE_SIZE
+  if (read_count < PAGE_SIZE) {
+    memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+  }
+}
+
+void DiskManager::WritePageFd(page_id_t page_id, const char *page_data) {
+  const char *data = page_data;
+  if (backend_ == DiskIOBackend::DIRECT && !IsAligned(page_data)) {
+    char *bounce_buffer = GetBounceBuffer();
+    memcpy(bounce_buffer, page_data, PAGE_SIZE);
+    data = bounce_buffer;
+  }
+  // pwrite直接交给内核，不经过用户态缓冲，不需要flush
+  if (!PwriteFull(db_fd_, data, PAGE_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE)) {
+    LOG_DEBUG("I/O error while writing");
+  }
+}
+
+void DiskManager::WritePagesUnchecked(std::vector<std::pair<page_id_t, const char *>> pages) {
+  if (pages.empty()) {
+    return;
+  }
+  if (backend_ == DiskIOBackend::MMAP) {
+    throw Exception("can't write to a database file mapped read-only");
+  }
+  std::sort(pages.begin(), pages.end());
+  MarkPageAllocated(pages.back().first);
+  if (compress_pages_) {
+    for (const auto &[page_id, page_data] : pages) {
+      WritePageCompressed(page_id, page_data);
+    }
+    // 数据和extent都要落盘，整批各同步一次
+    if (fdatasync(db_fd_) != 0 || fdatasync(ext_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing");
+    }
+    num_syncs_++;
+    return;
+  }
+  num_writes_ += pages.size();
+  if (db_fd_ < 0) {
+    // fstream没法fsync，只能在整批写完之后flush一次
+    std::scoped_lock scoped_db_io_latch(db_io_latch_);
+    for (size_t i = 0; i < pages.size(); i++) {
+      // 连续的页面只定位一次
+      if (i == 0 || pages[i].first != pages[i - 1].first + 1) {
+        db_io_.seekp(static_cast<size_t>(pages[i].first) * PAGE_SIZE);
+      }
+      db_io_.write(pages[i].second, PAGE_SIZE);
+    }
+    if (db_io_.bad()) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    db_io_.flush();
+    return;
+  }
+
+  for (size_t begin = 0, end; begin < pages.size(); begin = end) {
+    // 连续的页面合并成一次pwritev，O_DIRECT下没对齐的缓冲区只能逐页写
+    std::vector<iovec> iov;
+    end = begin;
+    while (end < pages.size() && iov.size() < static_cast<size_t>(IOV_MAX) &&
+           (end == begin || pages[end].first == pages[end - 1].first + 1)) {
+      if (backend_ == DiskIOBackend::DIRECT && !IsAligned(pages[end].second)) {
+        break;
+      }
+      iov.push_back({const_cast<char *>(pages[end].second), PAGE_SIZE});  // NOLINT
+      end++;
+    }
+    if (iov.empty()) {
+      WritePageFd(pages[begin].first, pages[begin].second);
+      end = begin + 1;
+      continue;
+    }
+    auto offset = static_cast<off_t>(pages[begin].first) * PAGE_SIZE;
+    ssize_t n = pwritev(db_fd_, iov.data(), static_cast<int>(iov.size()), offset);
+    size_t num_written = n > 0 ? n / PAGE_SIZE : 0;
+    // 没写完的页面(被中断或者出错)逐页补写
+    for (size_t i = begin + num_written; i < end; i++) {
+      WritePageFd(pages[i].first, pages[i].second);
+    }
+  }
+  // 整批只同步一次
+  if (fdatasync(db_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing");
+  }
+  num_syncs_++;
+}
+
+std::future<void> DiskManager::WritePageAsync(page_id_t page_id, const char *page_data,
+                                              std::function<void()> callback) {
+  return SubmitIO([this, page_id, page_data] { WritePage(page_id, page_data); }, std::move(callback));
+}
+
+std::future<void> DiskManager::ReadPageAsync(page_id_t page_id, char *page_data, std::function<void()> callback) {
+  return SubmitIO([this, page_id, page_data] { ReadPage(page_id, page_data); }, std::move(callback));
+}
+
+std::future<void> DiskManager::ReadPagesAsync(page_id_t first_page_id, std::vector<char *> pages_data) {
+  return SubmitIO([this, first_page_id, pages_data = std::move(pages_data)] { ReadPages(first_page_id, pages_data); },
+                  nullptr);
+}
+
+std::future<void> DiskManager::SubmitIO(std::function<void()> io, std::function<void()> callback) {
+  // std::function要求可复制，promise只能放在shared_ptr里
+  auto promise = std::make_shared<std::promise<void>>();
+  std::future<void> future = promise->get_future();
+  num_inflight_io_++;
+  num_async_io_++;
+  std::function<void()> request = [this, io = std::move(io), callback = std::move(callback), promise] {
+    // 读盘时发现的损坏通过future交给等待的线程，不能让异常杀掉I/O线程
+    std::exception_ptr error;
+    try {
+      io();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    if (callback) {
+      callback();
+    }
+    num_inflight_io_--;
+    if (error != nullptr) {
+      promise->set_exception(error);
+    } else {
+      promise->set_value();
+    }
+  };
+  {
+    std::scoped_lock lock{io_queue_latch_};
+    if (!io_stop_) {
+      // I/O线程在第一次异步读写时才启动，不用异步接口的DiskManager没有额外的线程
+      if (io_threads_.empty()) {
+        for (size_t i = 0; i < io_queue_depth_; i++) {
+          io_threads_.emplace_back(&DiskManager::IOThread, this);
+        }
+      }
+      io_queue_.push_back(std::move(request));
+      request = nullptr;
+    }
+  }
+  // 已经关闭了就在调用线程上同步完成
+  if (request) {
+    request();
+    return future;
+  }
+  io_queue_cv_.notify_one();
+  return future;
+}
+
+void DiskManager::StopIOThreads() {
+  std::vector<std::thread> io_threads;
+  {
+    std::scoped_lock lock{io_queue_latch_};
+    io_stop_ = true;
+    io_threads.swap(io_threads_);
+  }
+  io_queue_cv_.notify_all();
+  for (auto &io_thread : io_threads) {
+    io_thread.join();
+  }
+}
+
+void DiskManager::IOThread() {
+  while (true) {
+    std::function<void()> io;
+    {
+      std::unique_lock lock{io_queue_latch_};
+      io_queue_cv_.wait(lock, [this] { return io_stop_ || !io_queue_.empty(); });
+      // 关闭时先把排队的请求做完再退出
+      if (io_queue_.empty()) {
+        return;
+      }
+      io = std::move(io_queue_.front());
+      io_queue_.pop_front();
+    }
+    io();
+  }
+}
+
+void DiskManager::OpenFreeSpaceMap() {
+  if (fsm_name_.empty()) {
+    return;
+  }
+  fsm_fd_ = open(fsm_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fsm_fd_ < 0) {
+    throw Exception("can't open free space map file");
+  }
+  // 空的数据库文件是新建的，旧的空闲页表属于以前的文件，不能再用
+  if (GetFileSize(file_name_) <= 0) {
+    if (ftruncate(fsm_fd_, 0) != 0) {
+      LOG_DEBUG("I/O error while resetting free space map");
+    }
+    return;
+  }
+  int fsm_size = GetFileSize(fsm_name_);
+  free_map_.resize(std::max(fsm_size, 0));
+  if (PreadFull(fsm_fd_, reinterpret_cast<char *>(free_map_.data()), free_map_.size(), 0) !=
+      static_cast<ssize_t>(free_map_.size())) {
+    LOG_DEBUG("I/O error while reading free space map");
+  }
+  for (size_t byte = 0; byte < free_map_.size(); byte++) {
+    for (size_t bit = 0; bit < 8 && free_map_[byte] != 0; bit++) {
+      if ((free_map_[byte] & (1U << bit)) != 0) {
+        free_pages_.insert(static_cast<page_id_t>(byte * 8 + bit));
+      }
+    }
+  }
+}
+
+void DiskManager::SetPageFree(page_id_t page_id, bool is_free) {
+  size_t byte = page_id / 8;
+  if (byte >= free_map_.size()) {
+    free_map_.resize(byte + 1);
+  }
+  if (is_free) {
+    free_map_[byte] |= 1U << (page_id % 8);
+    free_pages_.insert(page_id);
+  } else {
+    free_map_[byte] &= ~(1U << (page_id % 8));
+    free_pages_.erase(page_id);
+  }
+  // 每次修改都写穿到文件，只写改动的那个字节
+  if (fsm_fd_ >= 0 && !PwriteFull(fsm_fd_, reinterpret_cast<char *>(&free_map_[byte]), 1, byte)) {
+    LOG_DEBUG("I/O error while writing free space map");
+  }
+}
+
+bool DiskManager::DeallocatePage(page_id_t page_id) {
+  // 从没分配过的页不能进空闲页表，否则之后分配新页时同一个page id会被分配两次
+  if (page_id < 0 || page_id >= num_allocated_pages_) {
+    LOG_WARN("can't deallocate page %d, it was never allocated", page_id);
+    return false;
+  }
+  // 空闲页的内容没有意义，可能被CompactFreePages清零，不再校验
+  if (checksum_policy_ != ChecksumPolicy::NONE) {
+    std::scoped_lock stripe_lock(checksum_stripes_[page_id % CHECKSUM_STRIPES]);
+    StampChecksum(page_id, 0);
+  }
+  if (compress_pages_) {
+    DeallocateExtent(page_id);
+  }
+  std::scoped_lock fsm_lock(fsm_latch_);
+  if (free_pages_.count(page_id) == 0) {
+    SetPageFree(page_id, true);
+  }
+  return true;
+}
+
+void DiskManager::MarkPageAllocated(page_id_t page_id) {
+  page_id_t num_allocated_pages = num_allocated_pages_;
+  while (page_id >= num_allocated_pages &&
+         !num_allocated_pages_.compare_exchange_weak(num_allocated_pages, page_id + 1)) {
+  }
+}
+
+void DiskManager::InitNumAllocatedPages() {
+  // 文件里已有的页、空闲页表和extent map中记录的页都是以前分配过的
+  size_t num_pages = 0;
+  if (backend_ == DiskIOBackend::MMAP) {
+    num_pages = mapping_size_ / PAGE_SIZE;
+  } else if (compress_pages_) {
+    num_pages = extents_.size();
+  } else {
+    num_pages = (std::max(GetFileSize(file_name_), 0) + PAGE_SIZE - 1) / PAGE_SIZE;
+  }
+  if (!free_pages_.empty()) {
+    num_pages = std::max(num_pages, static_cast<size_t>(*free_pages_.rbegin()) + 1);
+  }
+  num_allocated_pages_ = static_cast<page_id_t>(num_pages);
+}
+
+page_id_t DiskManager::AllocateFreePage(uint32_t num_instances, uint32_t instance_index) {
+  std::scoped_lock fsm_lock(fsm_latch_);
+  // 优先重用最小的空闲页，这样文件尾部的空闲页更可能被CompactFreePages截掉
+  for (page_id_t page_id : free_pages_) {
+    if (static_cast<uint32_t>(page_id) % num_instances == instance_index) {
+      SetPageFree(page_id, false);
+      return page_id;
+    }
+  }
+  return INVALID_PAGE_ID;
+}
+
+size_t DiskManager::GetNumFreePages() {
+  std::scoped_lock fsm_lock(fsm_latch_);
+  return free_pages_.size();
+}
+
+size_t DiskManager::CompactFreePages() {
+  if (backend_ == DiskIOBackend::MMAP) {
+    return 0;
+  }
+  if (compress_pages_) {
+    return CompactExtents();
+  }
+  std::scoped_lock fsm_lock(fsm_latch_);
+  if (backend_ == DiskIOBackend::STREAM) {
+    std::scoped_lock scoped_db_io_latch(db_io_latch_);
+    db_io_.flush();
+  }
+  int file_size = GetFileSize(file_name_);
+  if (file_size <= 0) {
+    return 0;
+  }
+  auto num_file_pages = static_cast<page_id_t>((file_size + PAGE_SIZE - 1) / PAGE_SIZE);
+  // 截掉文件尾部连续的空闲页
+  page_id_t new_num_file_pages = num_file_pages;
+  while (new_num_file_pages > 0 && free_pages_.count(new_num_file_pages - 1) > 0) {
+    new_num_file_pages--;
+  }
+  size_t num_reclaimed = num_file_pages - new_num_file_pages;
+  if (new_num_file_pages < num_file_pages &&
+      truncate(file_name_.c_str(), static_cast<off_t>(new_num_file_pages) * PAGE_SIZE) != 0) {
+    LOG_DEBUG("I/O error while truncating db file");
+    return 0;
+  }
+  // 中间的空闲页不能挪动(page id被其他页面引用)，在文件中打洞把磁盘空间还给文件系统
+#ifdef FALLOC_FL_PUNCH_HOLE
+  int fd = open(file_name_.c_str(), O_RDWR);
+  if (fd < 0) {
+    return num_reclaimed;
+  }
+  for (page_id_t page_id : free_pages_) {
+    if (page_id >= new_num_file_pages) {
+      break;
+    }
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(page_id) * PAGE_SIZE,
+                  PAGE_SIZE) == 0) {
+      num_reclaimed++;
+    }
+  }
+  close(fd);
+#endif
+  return num_reclaimed;
+}
+
+void DiskManager::OpenChecksums() {
+  if (crc_name_.empty()) {
+    return;
+  }
+  crc_fd_ = open(crc_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (crc_fd_ < 0) {
+    throw Exception("can't open checksum file");
+  }
+  // 和空闲页表一样，新建的数据库文件不能沿用旧的校验和
+  if (GetFileSize(file_name_) <= 0) {
+    if (ftruncate(crc_fd_, 0) != 0) {
+      LOG_DEBUG("I/O error while resetting checksums");
+    }
+    return;
+  }
+  int crc_size = GetFileSize(crc_name_);
+  checksums_.resize(std::max(crc_size, 0) / sizeof(uint32_t));
+  ssize_t size = checksums_.size() * sizeof(uint32_t);
+  if (PreadFull(crc_fd_, reinterpret_cast<char *>(checksums_.data()), size, 0) != size) {
+    LOG_DEBUG("I/O error while reading checksums");
+  }
+}
+
+uint32_t DiskManager::ToStoredChecksum(uint32_t checksum) { return checksum == 0 ? 1 : checksum; }
+
+std::vector<std::unique_lock<std::mutex>> DiskManager::LockChecksumStripes(const std::vector<page_id_t> &page_ids) {
+  // 按顺序加锁，同时锁多个分段的线程之间不会死锁
+  std::array<bool, CHECKSUM_STRIPES> needed{};
+  for (page_id_t page_id : page_ids) {
+    needed[page_id % CHECKSUM_STRIPES] = true;
+  }
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (size_t i = 0; i < CHECKSUM_STRIPES; i++) {
+    if (needed[i]) {
+      locks.emplace_back(checksum_stripes_[i]);
+    }
+  }
+  return locks;
+}
+
+void DiskManager::StampChecksum(page_id_t page_id, uint32_t checksum) {
+  std::scoped_lock crc_lock(crc_latch_);
+  if (static_cast<size_t>(page_id) >= checksums_.size()) {
+    if (checksum == 0) {
+      return;
+    }
+    checksums_.resize(page_id + 1);
+  }
+  checksums_[page_id] = checksum;
+  // 页面写完之后再写校验和，两次写之间崩溃的话读到的就是一个撕裂的页面，会被校验出来
+  if (crc_fd_ >= 0 && !PwriteFull(crc_fd_, reinterpret_cast<char *>(&checksums_[page_id]), sizeof(uint32_t),
+                                  static_cast<off_t>(page_id) * sizeof(uint32_t))) {
+    LOG_DEBUG("I/O error while writing checksum");
+  }
+}
+
+void DiskManager::VerifyChecksum(page_id_t page_id, const char *page_data) {
+  uint32_t expected;
+  {
+    std::scoped_lock crc_lock(crc_latch_);
+    expected = static_cast<size_t>(page_id) < checksums_.size() ? checksums_[page_id] : 0;
+  }
+  // 从没写过的页面(比如文件末尾之后的)没有校验和，不用算
+  if (expected == 0 || ToStoredChecksum(Crc32c::Compute(page_data, PAGE_SIZE)) == expected) {
+    return;
+  }
+  num_checksum_failures_++;
+  LOG_WARN("checksum mismatch on page %d", page_id);
+  if (checksum_policy_ == ChecksumPolicy::ENFORCE) {
+    throw Exception(ExceptionType::CORRUPTION, "checksum mismatch on page " + std::to_string(page_id));
+  }
+}
+
+const char *DiskManager::BorrowPage(page_id_t page_id) const {
+  auto offset = static_cast<size_t>(page_id) * PAGE_SIZE;
+  if (mapping_ == nullptr || page_id < 0 || offset + PAGE_SIZE > mapping_size_) {
+    return nullptr;
+  }
+  return mapping_ + offset;
+}
+
+void DiskManager::OpenMapping() {
+  int fd = open(file_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw Exception("can't open db file");
+  }
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    close(fd);
+    throw Exception("can't open db file");
+  }
+  // 文件末尾不满一页的部分映射不到，当作文件外的页面读成全零
+  mapping_size_ = static_cast<size_t>(stat_buf.st_size) / PAGE_SIZE * PAGE_SIZE;
+  if (mapping_size_ > 0) {
+    // 映射只建立页表，不读盘，多大的文件都能立刻打开。映射建立之后就不再需要描述符
+    void *mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw Exception("can't map db file");
+    }
+    mapping_ = static_cast<char *>(mapping);
+  }
+  close(fd);
+}
+
+void DiskManager::CloseMapping() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+}
+
+void DiskManager::OpenExtentMap() {
+  if (ext_name_.empty()) {
+    return;
+  }
+  ext_fd_ = open(ext_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (ext_fd_ < 0) {
+    throw Exception("can't open extent map file");
+  }
+  // 和空闲页表一样，新建的数据库文件不能沿用旧的extent
+  if (GetFileSize(file_name_) <= 0) {
+    if (ftruncate(ext_fd_, 0) != 0) {
+      LOG_DEBUG("I/O error while resetting extent map");
+    }
+    return;
+  }
+  int ext_size = GetFileSize(ext_name_);
+  extents_.resize(std::max(ext_size, 0) / sizeof(PageExtent));
+  ssize_t size = extents_.size() * sizeof(PageExtent);
+  if (PreadFull(ext_fd_, reinterpret_cast<char *>(extents_.data()), size, 0) != size) {
+    LOG_DEBUG("I/O error while reading extent map");
+  }
+  // 空闲的扇区不单独保存，由已用的extent之间的空隙得出
+  std::vector<std::pair<uint32_t, uint32_t>> used;
+  for (const PageExtent &extent : extents_) {
+    if (extent.length_ != 0) {
+      used.emplace_back(extent.first_sector_, extent.NumSectors());
+    }
+  }
+  std::sort(used.begin(), used.end());
+  for (const auto &[first_sector, num_sectors] : used) {
+    if (first_sector > end_sector_) {
+      free_sectors_[end_sector_] = first_sector - end_sector_;
+    }
+    end_sector_ = std::max(end_sector_, first_sector + num_sectors);
+  }
+}
+
+void DiskManager::ReadPageCompressed(page_id_t page_id, char *page_data) {
+  char buffer[PAGE_SIZE];
+  extent_latch_.RLock();
+  PageExtent extent{0, 0};
+  if (static_cast<size_t>(page_id) < extents_.size()) {
+    extent = extents_[page_id];
+  }
+  // 从没写过的页面读出来是全零，和不压缩时读到文件末尾之后一样
+  if (extent.length_ == 0) {
+    extent_latch_.RUnlock();
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  char *data = extent.length_ == PAGE_SIZE ? page_data : buffer;
+  ssize_t read_count = PreadFull(db_fd_, data, extent.length_,
+                                 static_cast<off_t>(extent.first_sector_) * COMPRESSED_SECTOR_SIZE);
+  extent_latch_.RUnlock();
+  if (read_count != static_cast<ssize_t>(extent.length_)) {
+    LOG_DEBUG("I/O error while reading");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  // 解压放在锁外面，读多个页面的线程可以同时解压
+  if (data == buffer && !LzCompressor::Decompress(buffer, extent.length_, page_data, PAGE_SIZE)) {
+    LOG_WARN("can't decompress page %d", page_id);
+    memset(page_data, 0, PAGE_SIZE);
+  }
+}
+
+void DiskManager::WritePageCompressed(page_id_t page_id, const char *page_data) {
+  // 压缩放在锁外面。至少省下一个扇区才值得压缩，否则原样保存，读的时候也省了解压
+  char buffer[PAGE_SIZE];
+  size_t length = LzCompressor::Compress(page_data, PAGE_SIZE, buffer, PAGE_SIZE - COMPRESSED_SECTOR_SIZE);
+  const char *data = length == 0 ? page_data : buffer;
+  PageExtent extent{0, length == 0 ? static_cast<uint32_t>(PAGE_SIZE) : static_cast<uint32_t>(length)};
+  num_writes_ += 1;
+
+  extent_latch_.WLock();
+  PageExtent old_extent{0, 0};
+  if (static_cast<size_t>(page_id) < extents_.size()) {
+    old_extent = extents_[page_id];
+  }
+  // 原来的extent放得下就原地覆盖，多出来的扇区还回去；放不下就换一个地方，写完新的再还旧的
+  bool in_place = old_extent.length_ != 0 && old_extent.NumSectors() >= extent.NumSectors();
+  extent.first_sector_ = in_place ? old_extent.first_sector_ : AllocateSectors(extent.NumSectors());
+  if (!PwriteFull(db_fd_, data, extent.length_, static_cast<off_t>(extent.first_sector_) * COMPRESSED_SECTOR_SIZE)) {
+    LOG_DEBUG("I/O error while writing");
+  }
+  SetExtent(page_id, extent);
+  if (in_place) {
+    ReleaseSectors(old_extent.first_sector_ + extent.NumSectors(), old_extent.NumSectors() - extent.NumSectors());
+  } else if (old_extent.length_ != 0) {
+    ReleaseSectors(old_extent.first_sector_, old_extent.NumSectors());
+  }
+  extent_latch_.WUnlock();
+}
+
+void DiskManager::DeallocateExtent(page_id_t page_id) {
+  extent_latch_.WLock();
+  if (static_cast<size_t>(page_id) < extents_.size() && extents_[page_id].length_ != 0) {
+    ReleaseSectors(extents_[page_id].first_sector_, extents_[page_id].NumSectors());
+    SetExtent(page_id, PageExtent{0, 0});
+  }
+  extent_latch_.WUnlock();
+}
+
+uint32_t DiskManager::AllocateSectors(uint32_t num_sectors) {
+  for (auto it = free_sectors_.begin(); it != free_sectors_.end(); ++it) {
+    if (it->second < num_sectors) {
+      continue;
+    }
+    uint32_t first_sector = it->first;
+    if (it->second > num_sectors) {
+      free_sectors_[first_sector + num_sectors] = it->second - num_sectors;
+    }
+    free_sectors_.erase(it);
+    return first_sector;
+  }
+  uint32_t first_sector = end_sector_;
+  end_sector_ += num_sectors;
+  return first_sector;
+}
+
+void DiskManager::ReleaseSectors(uint32_t first_sector, uint32_t num_sectors) {
+  if (num_sectors == 0) {
+    return;
+  }
+  // 和后面、前面相邻的空闲段合并
+  auto next = free_sectors_.find(first_sector + num_sectors);
+  if (next != free_sectors_.end()) {
+    num_sectors += next->second;
+    free_sectors_.erase(next);
+  }
+  auto prev = free_sectors_.lower_bound(first_sector);
+  if (prev != free_sectors_.begin() && std::prev(prev)->first + std::prev(prev)->second == first_sector) {
+    --prev;
+    first_sector = prev->first;
+    num_sectors += prev->second;
+    free_sectors_.erase(prev);
+  }
+  // 文件尾部的空闲段直接缩回去，以后从尾部接着分配
+  if (first_sector + num_sectors == end_sector_) {
+    end_sector_ = first_sector;
+    return;
+  }
+  free_sectors_[first_sector] = num_sectors;
+}
+
+void DiskManager::SetExtent(page_id_t page_id, PageExtent extent) {
+  if (static_cast<size_t>(page_id) >= extents_.size()) {
+    extents_.resize(page_id + 1, PageExtent{0, 0});
+  }
+  extents_[page_id] = extent;
+  // 数据写完之后才写extent。换了地方的写在两者之间崩溃只会丢掉这一次写，原地覆盖的会留下撕裂的页面，和不压缩时一样
+  if (ext_fd_ >= 0 && !PwriteFull(ext_fd_, reinterpret_cast<char *>(&extents_[page_id]), sizeof(PageExtent),
+                                  static_cast<off_t>(page_id) * sizeof(PageExtent))) {
+    LOG_DEBUG("I/O error while writing extent map");
+  }
+}
+
+size_t DiskManager::CompactExtents() {
+  extent_latch_.WLock();
+  size_t num_reclaimed = 0;
+  int file_size = GetFileSize(file_name_);
+  auto end_offset = static_cast<off_t>(end_sector_) * COMPRESSED_SECTOR_SIZE;
+  if (file_size > end_offset && truncate(file_name_.c_str(), end_offset) == 0) {
+    num_reclaimed += file_size - end_offset;
+  }
+#ifdef FALLOC_FL_PUNCH_HOLE
+  for (const auto &[first_sector, num_sectors] : free_sectors_) {
+    if (fallocate(db_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  static_cast<off_t>(first_sector) * COMPRESSED_SECTOR_SIZE,
+                  static_cast<off_t>(num_sectors) * COMPRESSED_SECTOR_SIZE) == 0) {
+      num_reclaimed += static_cast<size_t>(num_sectors) * COMPRESSED_SECTOR_SIZE;
+    }
+  }
+#endif
+  extent_latch_.WUnlock();
+  return num_reclaimed / PAGE_SIZE;
+}
+
+uint64_t DiskManager::GetStoredBytes() {
+  if (!compress_pages_) {
+    return std::max(GetFileSize(file_name_), 0);
+  }
+  extent_latch_.RLock();
+  uint64_t num_bytes = 0;
+  for (const PageExtent &extent : extents_) {
+    num_bytes += static_cast<uint64_t>(extent.NumSectors()) * COMPRESSED_SECTOR_SIZE;
+  }
+  extent_latch_.RUnlock();
+  return num_bytes;
+}
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
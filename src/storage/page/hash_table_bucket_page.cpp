@@ -11,14 +11,73 @@
 //===----------------------------------------------------------------------===//
 
 #include "storage/page/hash_table_bucket_page.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include "common/logger.h"
 #include "common/util/hash_util.h"
+#include "container/hash/hash_function.h"
 #include "storage/index/generic_key.h"
 #include "storage/index/hash_comparator.h"
 #include "storage/table/tmp_tuple.h"
 
 namespace bustub {
 
+namespace {
+
+#if defined(__x86_64__)
+/** 只有这个函数用AVX2编译，其余代码仍然可以在没有AVX2的CPU上运行 */
+__attribute__((target("avx2"))) uint64_t MatchBytesAvx2(const uint8_t *bytes, uint8_t needle) {
+  // 一条指令比较32个字节，两次覆盖64个slot
+  __m256i pattern = _mm256_set1_epi8(static_cast<char>(needle));
+  __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes));
+  __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + 32));
+  auto low_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+  auto high_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+  return low_mask | (static_cast<uint64_t>(high_mask) << 32);
+}
+
+uint64_t MatchBytesSse2(const uint8_t *bytes, uint8_t needle) {
+  // x86_64一定有SSE2，一条指令比较16个字节
+  __m128i pattern = _mm_set1_epi8(static_cast<char>(needle));
+  uint64_t mask = 0;
+  for (int i = 0; i < 4; i++) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 16 * i));
+    auto chunk_mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+    mask |= static_cast<uint64_t>(chunk_mask) << (16 * i);
+  }
+  return mask;
+}
+
+bool DetectAvx2() {
+  // 静态初始化时可能还没有初始化CPU特性信息，先手动初始化
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+const bool HAS_AVX2 = DetectAvx2();
+#endif
+
+/** @return a mask of the 64 bytes starting at bytes that are equal to needle, bit i for bytes[i] */
+uint64_t MatchBytes(const uint8_t *bytes, uint8_t needle) {
+#if defined(__x86_64__)
+  return HAS_AVX2 ? MatchBytesAvx2(bytes, needle) : MatchBytesSse2(bytes, needle);
+#else
+  uint64_t mask = 0;
+  for (int i = 0; i < 64; i++) {
+    mask |= static_cast<uint64_t>(bytes[i] == needle) << i;
+  }
+  return mask;
+#endif
+}
+
+}  // namespace
+
 /**
  * Scan the bucket and collect values that have the matching key
  *
@@ -26,12 +85,22 @@ namespace bustub {
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result) {
-  // 将所有key符合的都插入到vector数组中
+  return GetValue(key, DefaultHash(key), cmp, result);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, uint32_t hash, KeyComparator cmp, std::vector<ValueType> *result) {
+  // 将所有key符合的都插入到vector数组中，只有fingerprint相同的slot才需要真正比较key
+  uint8_t fingerprint = Fingerprint(hash);
   bool ret = false;
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i) && cmp(key, array_[i].first) == 0) {
-      result->push_back(array_[i].second);
-      ret = true;
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    for (uint64_t candidates = MatchFingerprints(fingerprint, word_idx); candidates != 0;
+         candidates &= candidates - 1) {
+      uint32_t i = word_idx * 64 + __builtin_ctzll(candidates);
+      if (cmp(key, array_[i].first) == 0) {
+        result->push_back(array_[i].second);
+        ret = true;
+      }
     }
   }
   return ret;
@@ -48,15 +117,25 @@ bool HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vecto
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp) {
+  return Insert(key, value, DefaultHash(key), cmp);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, uint32_t hash, KeyComparator cmp) {
+  uint8_t fingerprint = Fingerprint(hash);
   int64_t available = -1;
-  // 遍历所有位置，找到一个可以插入的位置，并且确定有无完全相同的K/V，有则不插入
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i)) {
+  // 按字遍历，找到第一个可以插入的位置，并且确定有无完全相同的K/V，有则不插入
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    for (uint64_t candidates = MatchFingerprints(fingerprint, word_idx); candidates != 0;
+         candidates &= candidates - 1) {
+      uint32_t i = word_idx * 64 + __builtin_ctzll(candidates);
       if (cmp(key, array_[i].first) == 0 && value == array_[i].second) {
         return false;
       }
-    } else if (available == -1) {
-      available = i;
+    }
+    uint64_t free_slots = ~ReadableWord(word_idx) & SlotMask(word_idx);
+    if (available == -1 && free_slots != 0) {
+      available = word_idx * 64 + __builtin_ctzll(free_slots);
     }
   }
 
@@ -67,6 +146,7 @@ bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator
 
   // 插入数据
   array_[available] = MappingType(key, value);
+  fingerprints_[available] = fingerprint;
   SetOccupied(available);
   SetReadable(available);
   return true;
@@ -79,9 +159,17 @@ bool HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp) {
+  return Remove(key, value, DefaultHash(key), cmp);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, uint32_t hash, KeyComparator cmp) {
   // 直接找，找到了调用RemoveAt即可
-  for (size_t i = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i)) {
+  uint8_t fingerprint = Fingerprint(hash);
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    for (uint64_t candidates = MatchFingerprints(fingerprint, word_idx); candidates != 0;
+         candidates &= candidates - 1) {
+      uint32_t i = word_idx * 64 + __builtin_ctzll(candidates);
       if (cmp(key, array_[i].first) == 0 && value == array_[i].second) {
         RemoveAt(i);
         return true;
@@ -183,27 +271,12 @@ void HASH_TABLE_BUCKET_TYPE::SetReadable(uint32_t bucket_idx) {
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsFull() {
-  u_int8_t mask = 255;
-  // 先以char为单位
-  size_t i_num = BUCKET_ARRAY_SIZE / 8;
-  for (size_t i = 0; i < i_num; i++) {
-    uint8_t c = static_cast<uint8_t>(readable_[i]);
-    if ((c & mask) != mask) {
+  // 以64位的字为单位，有一个空位就不满
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    if (ReadableWord(word_idx) != SlotMask(word_idx)) {
       return false;
     }
   }
-
-  // 最后还要看剩余的
-  size_t i_remain = BUCKET_ARRAY_SIZE % 8;
-  if (i_remain > 0) {
-    uint8_t c = static_cast<uint8_t>(readable_[i_num]);
-    for (size_t j = 0; j < i_remain; j++) {
-      if ((c & 1) != 1) {
-        return false;
-      }
-      c >>= 1;
-    }
-  }
   return true;
 }
 
@@ -212,35 +285,11 @@ bool HASH_TABLE_BUCKET_TYPE::IsFull() {
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 uint32_t HASH_TABLE_BUCKET_TYPE::NumReadable() {
-  // 要分别对每个char中的每位做判断
+  // 以64位的字为单位数1的个数
   uint32_t num = 0;
-
-  // 先以char为单位
-  size_t i_num = BUCKET_ARRAY_SIZE / 8;
-  for (size_t i = 0; i < i_num; i++) {
-    uint8_t c = static_cast<uint8_t>(readable_[i]);
-    for (uint8_t j = 0; j < 8; j++) {
-      // 取最低位判断
-      if ((c & 1) > 0) {
-        num++;
-      }
-      c >>= 1;
-    }
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    num += __builtin_popcountll(ReadableWord(word_idx));
   }
-
-  // 最后还要看剩余的
-  size_t i_remain = BUCKET_ARRAY_SIZE % 8;
-  if (i_remain > 0) {
-    uint8_t c = static_cast<uint8_t>(readable_[i_num]);
-    for (size_t j = 0; j < i_remain; j++) {
-      // 取最低位判断
-      if ((c & 1) == 1) {
-        num++;
-      }
-      c >>= 1;
-    }
-  }
-
   return num;
 }
 
@@ -249,11 +298,9 @@ uint32_t HASH_TABLE_BUCKET_TYPE::NumReadable() {
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BUCKET_TYPE::IsEmpty() {
-  // readable数组使用char存储，但这里不需要挨个判断，只需要有其中一个不符合条件就可以返回false
-  // 直接用sizeof运算获取长度
-  u_int8_t mask = 255;
-  for (size_t i = 0; i < sizeof(readable_) / sizeof(readable_[0]); i++) {
-    if ((readable_[i] & mask) > 0) {
+  // 不需要挨个判断，只需要有其中一个字不为0就可以返回false
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    if (ReadableWord(word_idx) != 0) {
       return false;
     }
   }
@@ -264,9 +311,10 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 MappingType *HASH_TABLE_BUCKET_TYPE::GetArrayCopy() {
   uint32_t num = NumReadable();
   MappingType *copy = new MappingType[num];
-  for (uint32_t i = 0, index = 0; i < BUCKET_ARRAY_SIZE; i++) {
-    if (IsReadable(i)) {
-      copy[index++] = array_[i];
+  uint32_t index = 0;
+  for (uint32_t word_idx = 0; word_idx < NUM_BITMAP_WORDS; word_idx++) {
+    for (uint64_t readable = ReadableWord(word_idx); readable != 0; readable &= readable - 1) {
+      copy[index++] = array_[word_idx * 64 + __builtin_ctzll(readable)];
     }
   }
   return copy;
@@ -276,7 +324,53 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_BUCKET_TYPE::Reset() {
   memset(occupied_, 0, sizeof(occupied_));
   memset(readable_, 0, sizeof(readable_));
-  memset(array_, 0, sizeof(array_));
+  memset(fingerprints_, 0, sizeof(fingerprints_));
+  memset(static_cast<void *>(array_), 0, sizeof(array_));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint32_t HASH_TABLE_BUCKET_TYPE::DefaultHash(const KeyType &key) {
+  // 和ExtendibleHashTable::Hash一样截成32位
+  return static_cast<uint32_t>(HashFunction<KeyType>().GetHash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint8_t HASH_TABLE_BUCKET_TYPE::Fingerprint(uint32_t hash) {
+  // directory最多只用hash的低MAX_GLOBAL_DEPTH位，取最高的一个字节，两者互不相关
+  return static_cast<uint8_t>(hash >> 24);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint64_t HASH_TABLE_BUCKET_TYPE::SlotMask(uint32_t word_idx) {
+  uint32_t num_slots = std::min<uint32_t>(BUCKET_ARRAY_SIZE - word_idx * 64, 64);
+  return num_slots == 64 ? ~uint64_t{0} : (uint64_t{1} << num_slots) - 1;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint64_t HASH_TABLE_BUCKET_TYPE::ReadableWord(uint32_t word_idx) const {
+  // readable_的长度不一定是8的倍数，最后一个字不满的部分补0
+  uint64_t word = 0;
+  size_t offset = word_idx * sizeof(word);
+  memcpy(&word, readable_ + offset, std::min(sizeof(word), sizeof(readable_) - offset));
+  return word & SlotMask(word_idx);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+uint64_t HASH_TABLE_BUCKET_TYPE::MatchFingerprints(uint8_t fingerprint, uint32_t word_idx) const {
+  uint64_t readable = ReadableWord(word_idx);
+  if (readable == 0) {
+    return 0;
+  }
+  // 最后一个字不满64个slot，逐个比较，免得读出fingerprints_的范围
+  uint32_t base = word_idx * 64;
+  if (base + 64 <= BUCKET_ARRAY_SIZE) {
+    return readable & MatchBytes(fingerprints_ + base, fingerprint);
+  }
+  uint64_t matches = 0;
+  for (uint32_t i = base; i < BUCKET_ARRAY_SIZE; i++) {
+    matches |= static_cast<uint64_t>(fingerprints_[i] == fingerprint) << (i - base);
+  }
+  return readable & matches;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -301,6 +395,10 @@ void HASH_TABLE_BUCKET_TYPE::PrintBucket() {
   LOG_INFO("Bucket Capacity: %lu, Size: %u, Taken: %u, Free: %u", BUCKET_ARRAY_SIZE, size, taken, free);
 }
 
+// BUCKET_ARRAY_SIZE只是估算，加上对齐之后仍然要放得进一个页
+static_assert(sizeof(HashTableBucketPage<int, int, IntComparator>) <= PAGE_SIZE);
+static_assert(sizeof(HashTableBucketPage<GenericKey<64>, RID, GenericComparator<64>>) <= PAGE_SIZE);
+
 // DO NOT REMOVE ANYTHING BELOW THIS LINE
 template class HashTableBucketPage<int, int, IntComparator>;
 
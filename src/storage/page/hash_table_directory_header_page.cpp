@@ -0,0 +1,47 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory_header_page.cpp
+//
+// Identification: src/storage/page/hash_table_directory_header_page.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/page/hash_table_directory_header_page.h"
+
+#include <cassert>
+
+namespace bustub {
+
+page_id_t HashTableDirectoryHeaderPage::GetPageId() const { return page_id_; }
+
+void HashTableDirectoryHeaderPage::SetPageId(page_id_t page_id) { page_id_ = page_id; }
+
+lsn_t HashTableDirectoryHeaderPage::GetLSN() const { return lsn_; }
+
+void HashTableDirectoryHeaderPage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
+
+uint32_t HashTableDirectoryHeaderPage::GetGlobalDepth() const { return global_depth_; }
+
+void HashTableDirectoryHeaderPage::SetGlobalDepth(uint32_t global_depth) {
+  assert(global_depth <= MAX_GLOBAL_DEPTH);
+  global_depth_ = global_depth;
+}
+
+uint32_t HashTableDirectoryHeaderPage::NumDirectoryPages() const {
+  // 不满一个directory page的时候只用第一个
+  return global_depth_ <= MAX_BUCKET_DEPTH ? 1 : 1 << (global_depth_ - MAX_BUCKET_DEPTH);
+}
+
+page_id_t HashTableDirectoryHeaderPage::GetDirectoryPageId(uint32_t directory_idx) const {
+  return directory_page_ids_[directory_idx];
+}
+
+void HashTableDirectoryHeaderPage::SetDirectoryPageId(uint32_t directory_idx, page_id_t directory_page_id) {
+  directory_page_ids_[directory_idx] = directory_page_id;
+}
+
+}  // namespace bustub
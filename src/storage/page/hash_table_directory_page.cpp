@@ -70,6 +70,8 @@ void HashTableDirectoryPage::IncrGlobalDepth() {
 
 void HashTableDirectoryPage::DecrGlobalDepth() { global_depth_--; }
 
+void HashTableDirectoryPage::SetGlobalDepth(uint32_t global_depth) { global_depth_ = global_depth; }
+
 /**
  * Lookup a bucket page using a directory index
  *
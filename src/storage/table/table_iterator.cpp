@@ -10,19 +10,57 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <utility>
 
+#include "buffer/buffer_access_strategy.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn), strategy_(strategy) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    page_guard_ = table_heap_->buffer_pool_manager_->FetchPageBasic(rid.GetPageId(), strategy_);
+    auto cur_page = page_guard_.As<TablePage>();
+    cur_page->RLatch();
+    cur_page->GetTuple(tuple_->rid_, tuple_, txn_, table_heap_->lock_manager_);
+    cur_page->RUnlatch();
   }
 }
 
+TableIterator::TableIterator(const TableIterator &other)
+    : table_heap_(other.table_heap_),
+      tuple_(new Tuple(*other.tuple_)),
+      txn_(other.txn_),
+      strategy_(other.strategy_),
+      prefetch_page_id_(other.prefetch_page_id_),
+      prefetched_(other.prefetched_) {
+  // 副本要有自己的pin，该页此时被other pin着，一定能命中
+  if (other.page_guard_.IsValid()) {
+    page_guard_ = table_heap_->buffer_pool_manager_->FetchPageBasic(other.page_guard_.PageId());
+  }
+}
+
+TableIterator &TableIterator::operator=(const TableIterator &other) {
+  if (this == &other) {
+    return *this;
+  }
+  table_heap_ = other.table_heap_;
+  *tuple_ = *other.tuple_;
+  txn_ = other.txn_;
+  strategy_ = other.strategy_;
+  prefetch_page_id_ = other.prefetch_page_id_;
+  prefetched_ = other.prefetched_;
+  if (other.page_guard_.IsValid()) {
+    page_guard_ = table_heap_->buffer_pool_manager_->FetchPageBasic(other.page_guard_.PageId());
+  } else {
+    page_guard_.Drop();
+  }
+  return *this;
+}
+
 const Tuple &TableIterator::operator*() {
   assert(*this != table_heap_->End());
   return *tuple_;
@@ -35,18 +73,19 @@ Tuple *TableIterator::operator->() {
 
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+  // 当前页从上一次调用起一直pin着，不用重新Fetch
+  assert(page_guard_.IsValid());
+  auto cur_page = page_guard_.As<TablePage>();
   cur_page->RLatch();
-  assert(cur_page != nullptr);  // all pages are pinned
 
   RID next_tuple_rid;
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  &next_tuple_rid)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+      BasicPageGuard next_page_guard = buffer_pool_manager->FetchPageBasic(cur_page->GetNextPageId(), strategy_);
       cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
-      cur_page = next_page;
+      page_guard_ = std::move(next_page_guard);
+      cur_page = page_guard_.As<TablePage>();
       cur_page->RLatch();
       if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
         break;
@@ -56,14 +95,55 @@ TableIterator &TableIterator::operator++() {
   tuple_->rid_ = next_tuple_rid;
 
   if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    cur_page->GetTuple(tuple_->rid_, tuple_, txn_, table_heap_->lock_manager_);
   }
+  Prefetch(cur_page);
   // release until copy the tuple
   cur_page->RUnlatch();
-  buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
+  // 走到末尾就不再占着最后一页
+  if (*this == table_heap_->End()) {
+    page_guard_.Drop();
+  }
   return *this;
 }
 
+void TableIterator::Prefetch(TablePage *cur_page) {
+  BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
+  size_t depth = SCAN_PREFETCH_DEPTH;
+  // 预读的页面也会进入环形缓冲区，要给当前页和刚走过的页留出位置，否则它们会被自己的预读挤出环
+  if (strategy_ != nullptr) {
+    size_t ring_size = strategy_->GetRingSize();
+    depth = std::min(depth, ring_size > 2 ? ring_size - 2 : 0);
+  }
+
+  // 走到了新的一页，丢掉窗口中已经走过的页面；当前页不在窗口中说明表被修改过，窗口作废
+  page_id_t page_id = cur_page->GetTablePageId();
+  if (page_id != prefetch_page_id_) {
+    auto iter = std::find(prefetched_.begin(), prefetched_.end(), page_id);
+    prefetched_.erase(prefetched_.begin(), iter == prefetched_.end() ? iter : iter + 1);
+    prefetch_page_id_ = page_id;
+  }
+
+  while (prefetched_.size() < depth) {
+    page_id_t next_page_id;
+    if (prefetched_.empty()) {
+      next_page_id = cur_page->GetNextPageId();
+    } else {
+      // 窗口末尾的页面读完之后才知道它的下一页，还在读的话留到下次再往前推
+      ReadPageGuard last_page_guard(buffer_pool_manager,
+                                    buffer_pool_manager->FetchPageIfResident(prefetched_.back()));
+      if (!last_page_guard.IsValid()) {
+        break;
+      }
+      next_page_id = last_page_guard.As<TablePage>()->GetNextPageId();
+    }
+    if (next_page_id == INVALID_PAGE_ID || !buffer_pool_manager->PrefetchPage(next_page_id, strategy_)) {
+      break;
+    }
+    prefetched_.push_back(next_page_id);
+  }
+}
+
 TableIterator TableIterator::operator++(int) {
   TableIterator clone(*this);
   ++(*this);
@@ -11,10 +11,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager_instance.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <cstring>
 #include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+#include "buffer/buffer_access_strategy.h"
 #include "buffer/buffer_pool_manager.h"
+#include "common/exception.h"
 #include "gtest/gtest.h"
 
 namespace bustub {
@@ -141,4 +151,552 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ConcurrencyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const int num_pages = 64;
+  const int num_threads = 8;
+  const int num_rounds = 2000;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: create more pages than fit into the pool, stamping each one with its own id.
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id_temp;
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: many threads fetching overlapping pages concurrently, forcing misses and dirty evictions, should always
+  // observe the content that belongs to the page they asked for.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid] {
+      std::default_random_engine rng(tid);
+      std::uniform_int_distribution<int> uniform_dist(0, num_pages - 1);
+      char expected[PAGE_SIZE];
+      for (int round = 0; round < num_rounds; ++round) {
+        page_id_t page_id = uniform_dist(rng);
+        auto *page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        snprintf(expected, PAGE_SIZE, "%d", page_id);
+        page->RLatch();
+        EXPECT_EQ(page_id, page->GetPageId());
+        EXPECT_EQ(0, strcmp(page->GetData(), expected));
+        page->RUnlatch();
+        EXPECT_EQ(true, bpm->UnpinPage(page_id, round % 2 == 0));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Scenario: every page is unpinned again, so all of them can be fetched one after another.
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(1, page->GetPinCount());
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, BackgroundFlushTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: fill the pool with dirty pages and unpin them all.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: the flush thread should clean the whole pool ahead of demand.
+  bpm->RunBackgroundFlushThread(1.0);
+  for (int i = 0; i < 500 && bpm->GetNumBackgroundWrites() < buffer_pool_size; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  bpm->StopBackgroundFlushThread();
+  EXPECT_EQ(buffer_pool_size, bpm->GetNumBackgroundWrites());
+
+  // Scenario: creating new pages now evicts only clean pages, so no foreground write is needed.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+  EXPECT_EQ(buffer_pool_size, bpm->GetNumEvictions());
+  EXPECT_EQ(0, bpm->GetNumForegroundWrites());
+
+  // Scenario: the pages written in the background can be read back.
+  for (int i = 0; i < static_cast<int>(buffer_pool_size); ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, AccessStrategyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const int num_hot_pages = 4;
+  const int num_pages = 64;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: create more pages than fit into the pool.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: bring the hot pages into the pool.
+  for (int i = 0; i < num_hot_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: a scan over all the other pages through a small ring reads the right data.
+  BufferAccessStrategy strategy(bpm, 4);
+  for (int i = num_hot_pages; i < num_pages; ++i) {
+    auto *page = bpm->FetchPageWithStrategy(i, &strategy);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: the scan recycled its own frames, so the hot pages are still in the pool.
+  uint64_t num_misses = bpm->GetNumMisses();
+  for (int i = 0; i < num_hot_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+  EXPECT_EQ(num_misses, bpm->GetNumMisses());
+
+  // Scenario: only unpinned, clean pages can be discarded.
+  ASSERT_NE(nullptr, bpm->FetchPage(0));
+  EXPECT_EQ(false, bpm->DiscardPage(0));
+  EXPECT_EQ(true, bpm->UnpinPage(0, true));
+  EXPECT_EQ(false, bpm->DiscardPage(0));
+  EXPECT_EQ(true, bpm->FlushPage(0));
+  EXPECT_EQ(true, bpm->DiscardPage(0));
+  EXPECT_EQ(false, bpm->DiscardPage(0));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PrefetchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const int num_pages = 64;
+  const int num_prefetched_pages = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: create more pages than fit into the pool, so the first pages only live on disk.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: prefetching pages does not pin them, and fetching them afterwards never goes to disk itself.
+  EXPECT_EQ(num_prefetched_pages, bpm->PrefetchRange(0, num_prefetched_pages));
+  EXPECT_EQ(true, bpm->PrefetchPage(0));
+  EXPECT_EQ(num_prefetched_pages, bpm->GetNumPrefetches());
+  uint64_t num_misses = bpm->GetNumMisses();
+  for (int i = 0; i < num_prefetched_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(1, page->GetPinCount());
+    EXPECT_EQ(i, std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+  EXPECT_EQ(num_misses, bpm->GetNumMisses());
+
+  // Scenario: a resident page can be peeked at without waiting, a page on disk cannot.
+  auto *page = bpm->FetchPageIfResident(0);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, std::stoi(page->GetData()));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  EXPECT_EQ(nullptr, bpm->FetchPageIfResident(num_prefetched_pages));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, BatchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const int num_pages = 32;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: create more pages than fit into the pool, so the first pages only live on disk.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: a batch mixing resident pages, a run of pages on disk, a scattered page on disk and a duplicate returns
+  // every page pinned, in the requested order.
+  std::vector<page_id_t> page_ids{num_pages - 1, 0, 1, 2, 10, num_pages - 2, 1};
+  uint64_t num_misses = bpm->GetNumMisses();
+  std::vector<Page *> pages = bpm->FetchPages(page_ids);
+  ASSERT_EQ(page_ids.size(), pages.size());
+  for (size_t i = 0; i < pages.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(page_ids[i], pages[i]->GetPageId());
+    EXPECT_EQ(page_ids[i], std::stoi(pages[i]->GetData()));
+  }
+  EXPECT_EQ(2, pages[2]->GetPinCount());
+  EXPECT_EQ(num_misses + 4, bpm->GetNumMisses());
+
+  // Scenario: the pages are unpinned in one call, which fails if any page was not pinned.
+  std::vector<std::pair<page_id_t, bool>> unpins;
+  for (page_id_t page_id : page_ids) {
+    unpins.emplace_back(page_id, false);
+  }
+  EXPECT_EQ(true, bpm->UnpinPages(unpins));
+  EXPECT_EQ(0, pages[2]->GetPinCount());
+  EXPECT_EQ(false, bpm->UnpinPages({{0, false}}));
+
+  // Scenario: a batch larger than the pool gets nullptr for the pages no frame could be found for.
+  page_ids.clear();
+  for (int i = 0; i < static_cast<int>(buffer_pool_size) + 2; ++i) {
+    page_ids.push_back(i);
+  }
+  pages = bpm->FetchPages(page_ids);
+  unpins.clear();
+  size_t num_fetched = 0;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    if (pages[i] != nullptr) {
+      EXPECT_EQ(page_ids[i], std::stoi(pages[i]->GetData()));
+      unpins.emplace_back(page_ids[i], false);
+      num_fetched++;
+    }
+  }
+  EXPECT_EQ(buffer_pool_size, num_fetched);
+  EXPECT_EQ(true, bpm->UnpinPages(unpins));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ResizeTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t max_pool_size = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU, -1,
+                                            max_pool_size);
+  EXPECT_EQ(max_pool_size, bpm->GetMaxPoolSize());
+
+  // Scenario: a full pool can be grown online, and the added frames take new pages right away.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(false, bpm->Resize(max_pool_size + 1));
+  EXPECT_EQ(false, bpm->Resize(0));
+  EXPECT_EQ(true, bpm->Resize(max_pool_size));
+  EXPECT_EQ(max_pool_size, bpm->GetPoolSize());
+  for (size_t i = buffer_pool_size; i < max_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  for (size_t i = 0; i + 1 < max_pool_size; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // Scenario: shrinking waits until the pages pinned in the removed frames are unpinned.
+  std::atomic<bool> resized = false;
+  std::thread resizer([bpm, &resized] {
+    EXPECT_EQ(true, bpm->Resize(2));
+    resized = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(false, resized.load());
+  EXPECT_EQ(true, bpm->UnpinPage(max_pool_size - 1, true));
+  resizer.join();
+  EXPECT_EQ(2, bpm->GetPoolSize());
+
+  // Scenario: the dirty pages of the removed frames were written back, and only two pages can be pinned at once.
+  auto *page0 = bpm->FetchPage(0);
+  auto *page1 = bpm->FetchPage(1);
+  ASSERT_NE(nullptr, page0);
+  ASSERT_NE(nullptr, page1);
+  EXPECT_EQ(nullptr, bpm->FetchPage(2));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  EXPECT_EQ(true, bpm->UnpinPage(1, false));
+  for (size_t i = 0; i < max_pool_size; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(static_cast<int>(i), std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: a shrunk pool can be grown again.
+  EXPECT_EQ(true, bpm->Resize(max_pool_size));
+
+  // Scenario: a shrink that times out on pinned pages is undone, and the pool keeps all of its frames. Two pages stay
+  // pinned, so at least one of them is in a removed frame.
+  for (size_t i = 0; i < max_pool_size; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+  }
+  for (size_t i = 0; i + 2 < max_pool_size; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+  auto old_resize_timeout = resize_timeout;
+  resize_timeout = std::chrono::milliseconds(10);
+  EXPECT_EQ(false, bpm->Resize(1));
+  resize_timeout = old_resize_timeout;
+  EXPECT_EQ(max_pool_size, bpm->GetPoolSize());
+  EXPECT_EQ(true, bpm->UnpinPage(max_pool_size - 2, false));
+  EXPECT_EQ(true, bpm->UnpinPage(max_pool_size - 1, false));
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < max_pool_size; ++i) {
+    page_ids.push_back(i);
+  }
+  std::vector<Page *> pages = bpm->FetchPages(page_ids);
+  std::vector<std::pair<page_id_t, bool>> unpins;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    unpins.emplace_back(page_ids[i], false);
+  }
+  EXPECT_EQ(true, bpm->UnpinPages(unpins));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, PageReuseTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(i, page_id_temp);
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+  bpm->FlushAllPages();
+
+  // Scenario: a pinned page cannot be deleted and is not handed out again.
+  EXPECT_EQ(false, bpm->DeletePage(4));
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+
+  // Scenario: deleted pages, resident or not, are reused by NewPage before the file grows, and come back zeroed.
+  EXPECT_EQ(true, bpm->DeletePage(2));
+  EXPECT_EQ(true, bpm->DeletePage(1));
+  EXPECT_EQ(2, disk_manager->GetNumFreePages());
+  auto *page = bpm->NewPage(&page_id_temp);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(1, page_id_temp);
+  EXPECT_EQ(0, page->GetData()[0]);
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(2, page_id_temp);
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+  EXPECT_EQ(5, page_id_temp);
+
+  // Scenario: a page id that was never allocated cannot be deleted, and is not handed out twice later on.
+  EXPECT_EQ(false, bpm->DeletePage(7));
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+  for (int i = 6; i < 9; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(i, page_id_temp);
+  }
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, MappedReadOnlyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const int num_pages = 8;
+
+  auto *disk_manager = new DiskManager(db_name, DiskIOBackend::PREAD);
+  char data[PAGE_SIZE];
+  for (int i = 0; i < num_pages; ++i) {
+    std::memset(data, i + 1, PAGE_SIZE);
+    disk_manager->WritePage(i, data);
+  }
+  disk_manager->ShutDown();
+  delete disk_manager;
+
+  disk_manager = new DiskManager(db_name, DiskIOBackend::MMAP);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: fetched pages point into the mapping of the file instead of being copied into their frames.
+  auto *page = bpm->FetchPage(5);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(disk_manager->BorrowPage(5), page->GetData());
+  EXPECT_EQ(6, page->GetData()[0]);
+  EXPECT_EQ(true, bpm->UnpinPage(5, false));
+  std::vector<Page *> pages = bpm->FetchPages({0, 1, 2, 3});
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(disk_manager->BorrowPage(i), pages[i]->GetData());
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: flushing the pages borrowed from the mapping writes nothing.
+  int num_writes = disk_manager->GetNumWrites();
+  EXPECT_NO_THROW(bpm->FlushAllPages());
+  EXPECT_EQ(true, bpm->FlushPage(3));
+  EXPECT_EQ(num_writes, disk_manager->GetNumWrites());
+
+  // Scenario: frames that held borrowed pages get their own memory back for pages past the end of the file.
+  EXPECT_EQ(true, bpm->DeletePage(0));
+  page = bpm->FetchPage(num_pages + 1);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(nullptr, disk_manager->BorrowPage(num_pages + 1));
+  EXPECT_EQ(0, page->GetData()[0]);
+  page->GetData()[0] = 1;
+  EXPECT_EQ(true, bpm->UnpinPage(num_pages + 1, false));
+
+  // Scenario: the file cannot be written through the mapping.
+  EXPECT_THROW(disk_manager->WritePage(1, data), Exception);
+
+  delete bpm;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, ChecksumFailureTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 2;
+  const int num_pages = 4;
+
+  auto *disk_manager = new DiskManager(db_name, DiskIOBackend::PREAD, DISK_IO_QUEUE_DEPTH, ChecksumPolicy::ENFORCE);
+  char data[PAGE_SIZE];
+  for (int i = 0; i < num_pages; ++i) {
+    std::memset(data, i + 1, PAGE_SIZE);
+    disk_manager->WritePage(i, data);
+  }
+  int fd = open(db_name.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(1, pwrite(fd, "x", 1, PAGE_SIZE + 100));
+  close(fd);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  // Scenario: a fetch of the corrupted page fails every time, instead of hanging on the first failed read.
+  EXPECT_THROW(bpm->FetchPage(1), Exception);
+  EXPECT_THROW(bpm->FetchPage(1), Exception);
+  EXPECT_THROW(bpm->FetchPages({0, 1, 2}), Exception);
+  EXPECT_TRUE(bpm->PrefetchPage(1));
+  EXPECT_THROW(bpm->FetchPage(1), Exception);
+
+  // Scenario: the failed reads gave their frames back, and the batch unpinned the pages it did read.
+  std::vector<Page *> pages = bpm->FetchPages({0, 2});
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(2 * i + 1, pages[i]->GetData()[0]);
+    EXPECT_EQ(1, pages[i]->GetPinCount());
+  }
+  EXPECT_EQ(nullptr, bpm->FetchPage(3));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  EXPECT_EQ(true, bpm->UnpinPage(2, false));
+
+  // Scenario: once rewritten, the page can be fetched again.
+  std::memset(data, 2, PAGE_SIZE);
+  disk_manager->WritePage(1, data);
+  auto *page = bpm->FetchPage(1);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(2, page->GetData()[0]);
+  EXPECT_EQ(true, bpm->UnpinPage(1, false));
+
+  delete bpm;
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.crc");
+
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -0,0 +1,119 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats_test.cpp
+//
+// Identification: test/buffer/buffer_pool_stats_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "common/bustub_instance.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(BufferPoolStatsTest, HistogramTest) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.GetSnapshot().Percentile(50));
+
+  // Scenario: values land in the power-of-two bucket whose upper bound is the smallest one not below them.
+  histogram.Record(0);
+  histogram.Record(1);
+  histogram.Record(2);
+  histogram.Record(3);
+  histogram.Record(4);
+  histogram.Record(1000);
+  histogram.Record(uint64_t{1} << 40);
+  LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(7, snapshot.count_);
+  EXPECT_EQ(2, snapshot.buckets_[0]);
+  EXPECT_EQ(1, snapshot.buckets_[1]);
+  EXPECT_EQ(2, snapshot.buckets_[2]);
+  EXPECT_EQ(1, snapshot.buckets_[10]);
+  EXPECT_EQ(1, snapshot.buckets_[LatencyHistogram::NUM_BUCKETS - 1]);
+  EXPECT_EQ(4, snapshot.Percentile(50));
+  EXPECT_EQ(1024, snapshot.Percentile(80));
+
+  // Scenario: snapshots of several histograms add up.
+  snapshot += histogram.GetSnapshot();
+  EXPECT_EQ(14, snapshot.count_);
+  EXPECT_EQ(4, snapshot.buckets_[0]);
+  EXPECT_DOUBLE_EQ(histogram.GetSnapshot().Mean(), snapshot.Mean());
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolStatsTest, BufferPoolTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t num_instances = 2;
+  const int num_pages = 16;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: filling the pool with dirty pages and reading them back counts hits, misses, dirty evictions and the
+  // latency of every miss and victim selection.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  // The newest pages are still resident, walking backwards hits them before missing the older ones.
+  for (int i = num_pages - 1; i >= 0; --i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+  BufferPoolStats stats = bpm->GetStats();
+  EXPECT_EQ(num_pages - num_instances * buffer_pool_size, stats.num_misses_);
+  EXPECT_EQ(num_instances * buffer_pool_size, stats.num_hits_);
+  EXPECT_DOUBLE_EQ(0.5, stats.HitRatio());
+  EXPECT_EQ(stats.num_misses_, stats.miss_latency_.count_);
+  EXPECT_GT(stats.num_evictions_, 0);
+  EXPECT_GT(stats.num_foreground_writes_, 0);
+  EXPECT_EQ(stats.num_evictions_, stats.victim_latency_.count_);
+
+  // Scenario: per-instance stats add up to the stats of the whole pool, and the dump has one series per instance.
+  std::vector<BufferPoolStats> instance_stats = bpm->GetInstanceStats();
+  ASSERT_EQ(num_instances, instance_stats.size());
+  EXPECT_EQ(stats.num_hits_, instance_stats[0].num_hits_ + instance_stats[1].num_hits_);
+  std::string dump = DumpBufferPoolStats(instance_stats);
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_hits_total{instance=\"1\"} "));
+  EXPECT_NE(std::string::npos,
+            dump.find("bustub_buffer_pool_miss_latency_nanoseconds_bucket{instance=\"0\",le=\"+Inf\"} 4\n"));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolStatsTest, BustubInstanceTest) {
+  auto *bustub = new BustubInstance("test.db");
+  page_id_t page_id_temp;
+  ASSERT_NE(nullptr, bustub->buffer_pool_manager_->NewPage(&page_id_temp));
+  EXPECT_EQ(true, bustub->buffer_pool_manager_->UnpinPage(page_id_temp, false));
+  ASSERT_NE(nullptr, bustub->buffer_pool_manager_->FetchPage(page_id_temp));
+  EXPECT_EQ(true, bustub->buffer_pool_manager_->UnpinPage(page_id_temp, false));
+
+  EXPECT_EQ(1, bustub->GetBufferPoolStats().num_hits_);
+  std::string dump = bustub->DumpBufferPoolStatsText();
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_hits_total{instance=\"0\"} 1\n"));
+
+  delete bustub;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
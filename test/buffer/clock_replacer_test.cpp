@@ -10,16 +10,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <memory>
+#include <random>
 #include <thread>  // NOLINT
 #include <vector>
 
 #include "buffer/clock_replacer.h"
+#include "buffer/lru_replacer.h"
 #include "gtest/gtest.h"
 
 namespace bustub {
 
-TEST(ClockReplacerTest, DISABLED_SampleTest) {
+TEST(ClockReplacerTest, SampleTest) {
   ClockReplacer clock_replacer(7);
 
   // Scenario: unpin six elements, i.e. add them to the replacer.
@@ -59,4 +64,128 @@ TEST(ClockReplacerTest, DISABLED_SampleTest) {
   EXPECT_EQ(4, value);
 }
 
+TEST(ClockReplacerTest, ConcurrencyTest) {
+  const size_t num_frames = 64;
+  const int num_threads = 8;
+  const int num_rounds = 10000;
+  ClockReplacer clock_replacer(num_frames);
+
+  // Scenario: every thread owns a disjoint set of frames and keeps pinning and unpinning them, while another thread
+  // keeps victimizing whatever it finds and putting it back.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([&clock_replacer, tid] {
+      std::default_random_engine rng(tid);
+      std::uniform_int_distribution<int> uniform_dist(0, num_frames / num_threads - 1);
+      for (int round = 0; round < num_rounds; ++round) {
+        frame_id_t frame_id = tid * (num_frames / num_threads) + uniform_dist(rng);
+        clock_replacer.Pin(frame_id);
+        clock_replacer.Unpin(frame_id);
+      }
+    });
+  }
+  std::thread victim_thread([&clock_replacer] {
+    int value;
+    for (int round = 0; round < num_rounds; ++round) {
+      if (clock_replacer.Victim(&value)) {
+        clock_replacer.Unpin(value);
+      }
+    }
+  });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  victim_thread.join();
+
+  // Scenario: the size matches the frames in the replacer, and each of them is handed out exactly once.
+  size_t size = clock_replacer.Size();
+  std::vector<bool> victimized(num_frames, false);
+  int value;
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_EQ(true, clock_replacer.Victim(&value));
+    EXPECT_EQ(false, victimized[value]);
+    victimized[value] = true;
+  }
+  EXPECT_EQ(0, clock_replacer.Size());
+  EXPECT_EQ(false, clock_replacer.Victim(&value));
+}
+
+TEST(ClockReplacerTest, UnpinVictimStressTest) {
+  const int num_threads = 8;
+  const size_t num_frames = num_threads;
+  const int num_rounds = 100000;
+  ClockReplacer clock_replacer(num_frames);
+  for (size_t i = 0; i < num_frames; ++i) {
+    clock_replacer.Unpin(i);
+  }
+
+  // Scenario: every thread keeps victimizing a frame and unpinning it again. Each thread holds at most one frame and
+  // none while it calls Victim, so at least one frame is unpinned then and Victim must never fail, even while another
+  // thread's Unpin of that frame is half done.
+  std::atomic<int> num_failures = 0;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([&clock_replacer, &num_failures] {
+      int value;
+      for (int round = 0; round < num_rounds; ++round) {
+        if (!clock_replacer.Victim(&value)) {
+          num_failures++;
+          continue;
+        }
+        clock_replacer.Unpin(value);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(0, num_failures.load());
+  EXPECT_EQ(num_frames, clock_replacer.Size());
+}
+
+// Microbenchmark of the replacers under a point-lookup pattern: every operation pins a random frame and unpins it
+// again, and one in a hundred operations asks for a victim. Run with --gtest_also_run_disabled_tests.
+TEST(ClockReplacerTest, DISABLED_BenchmarkTest) {
+  const size_t num_frames = 4096;
+  const int num_operations = 1 << 20;
+
+  auto run = [](Replacer *replacer, int num_threads) {
+    for (size_t i = 0; i < num_frames; ++i) {
+      replacer->Unpin(i);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; ++tid) {
+      threads.emplace_back([replacer, tid, num_threads] {
+        std::default_random_engine rng(tid);
+        std::uniform_int_distribution<frame_id_t> uniform_dist(0, num_frames - 1);
+        frame_id_t value;
+        for (int i = 0; i < num_operations / num_threads; ++i) {
+          frame_id_t frame_id = uniform_dist(rng);
+          replacer->Pin(frame_id);
+          replacer->Unpin(frame_id);
+          if (i % 100 == 0 && replacer->Victim(&value)) {
+            replacer->Unpin(value);
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return num_operations / elapsed.count();
+  };
+
+  printf("%8s %16s %16s\n", "threads", "lru ops/s", "clock ops/s");
+  for (int num_threads = 1; num_threads <= 64; num_threads *= 2) {
+    auto lru_replacer = std::make_unique<LRUReplacer>(num_frames);
+    auto clock_replacer = std::make_unique<ClockReplacer>(num_frames);
+    double lru_ops = run(lru_replacer.get(), num_threads);
+    double clock_ops = run(clock_replacer.get(), num_threads);
+    printf("%8d %16.0f %16.0f\n", num_threads, lru_ops, clock_ops);
+  }
+}
+
 }  // namespace bustub
@@ -0,0 +1,82 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_allocator_test.cpp
+//
+// Identification: test/buffer/frame_allocator_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/frame_allocator.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(FrameAllocatorTest, LayoutTest) {
+  // Scenario: a pool spanning several huge pages is one zeroed, huge-page aligned region.
+  const size_t num_frames = 3 * HUGE_PAGE_SIZE / PAGE_SIZE + 1;
+  FrameAllocator frames(num_frames, 0);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(frames.GetFrameData(0)) % HUGE_PAGE_SIZE);
+  for (size_t i = 0; i < num_frames; ++i) {
+    char *data = frames.GetFrameData(i);
+    EXPECT_EQ(frames.GetFrameData(0) + i * PAGE_SIZE, data);
+    EXPECT_EQ(0, data[0]);
+    EXPECT_EQ(0, data[PAGE_SIZE - 1]);
+    data[0] = 1;
+    data[PAGE_SIZE - 1] = 1;
+  }
+  EXPECT_GE(FrameAllocator::GetNumNumaNodes(), 1);
+  EXPECT_LT(frames.GetNumaNode(), FrameAllocator::GetNumNumaNodes());
+
+  // Scenario: a small pool still gets zeroed frames.
+  FrameAllocator small_frames(10);
+  EXPECT_EQ(false, small_frames.IsHugePageAdvised());
+  EXPECT_EQ(-1, small_frames.GetNumaNode());
+  EXPECT_EQ(0, small_frames.GetFrameData(9)[PAGE_SIZE - 1]);
+}
+
+// NOLINTNEXTLINE
+TEST(FrameAllocatorTest, BufferPoolTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU, 0);
+
+  // Scenario: the pages of the pool point into one contiguous region.
+  Page *pages = bpm->GetPages();
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    EXPECT_EQ(pages[0].GetData() + i * PAGE_SIZE, pages[i].GetData());
+  }
+
+  // Scenario: the data of a page survives an eviction.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size * 2; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  auto *page = bpm->FetchPage(0);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, std::stoi(page->GetData()));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+}  // namespace bustub
@@ -0,0 +1,153 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer_test.cpp
+//
+// Identification: test/buffer/lru_k_replacer_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/lru_k_replacer.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer lru_k_replacer(7, 2);
+
+  // Scenario: access six frames once, then frame 1 a second time, and unpin them all.
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    lru_k_replacer.RecordAccess(frame_id);
+  }
+  lru_k_replacer.RecordAccess(1);
+  for (frame_id_t frame_id = 1; frame_id <= 6; ++frame_id) {
+    lru_k_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ(6, lru_k_replacer.Size());
+
+  // Scenario: frames with a single access have an infinite backward k-distance and go first, oldest first.
+  int value;
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(3, lru_k_replacer.Size());
+
+  // Scenario: pin 5 and access it again; it now has two accesses, but its 2nd most recent one is younger than 1's.
+  lru_k_replacer.Pin(5);
+  EXPECT_EQ(2, lru_k_replacer.Size());
+  lru_k_replacer.RecordAccess(5);
+  lru_k_replacer.Unpin(5);
+
+  // Scenario: 6 still has a single access, then 1 has the larger backward k-distance, then 5.
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(6, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(5, value);
+  EXPECT_EQ(false, lru_k_replacer.Victim(&value));
+
+  // Scenario: a removed frame forgets its history and is victimized as a never accessed frame.
+  lru_k_replacer.RecordAccess(3);
+  lru_k_replacer.RecordAccess(3);
+  lru_k_replacer.RecordAccess(4);
+  lru_k_replacer.Remove(3);
+  lru_k_replacer.Unpin(3);
+  lru_k_replacer.Unpin(4);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+}
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const int num_hot_pages = 4;
+  const int num_scan_pages = 256;
+  const int scan_stride = 8;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU_K);
+
+  // Scenario: create the hot (index) pages followed by the pages of a large table.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_hot_pages + num_scan_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: warm the hot pages up so that each of them has been accessed more than once.
+  for (int round = 0; round < 2; ++round) {
+    for (page_id_t page_id = 0; page_id < num_hot_pages; ++page_id) {
+      ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+    }
+  }
+
+  // Scenario: a full scan touching every table page once runs concurrently with lookups of the hot pages. The two
+  // threads proceed in lockstep, one lookup per scan_stride scan pages, so that plain LRU would already have pushed a
+  // hot page out of the pool by the time it is looked up again.
+  // A failed fetch stops both threads, so neither waits forever for the other.
+  std::atomic<int> scanned = 0;
+  std::atomic<int> looked_up = 0;
+  std::atomic<bool> failed = false;
+  uint64_t misses_before = bpm->GetNumMisses();
+  std::thread scan_thread([bpm, &scanned, &looked_up, &failed] {
+    for (int i = 0; i < num_scan_pages && !failed; ++i) {
+      while (looked_up < i / scan_stride && !failed) {
+        std::this_thread::yield();
+      }
+      page_id_t page_id = num_hot_pages + i;
+      Page *page = bpm->FetchPage(page_id);
+      EXPECT_NE(nullptr, page);
+      if (page == nullptr) {
+        failed = true;
+        break;
+      }
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+      scanned++;
+    }
+  });
+  for (int round = 0; round < num_scan_pages / scan_stride && !failed; ++round) {
+    while (scanned < round * scan_stride && !failed) {
+      std::this_thread::yield();
+    }
+    page_id_t page_id = round % num_hot_pages;
+    Page *page = bpm->FetchPage(page_id);
+    EXPECT_NE(nullptr, page);
+    if (page == nullptr) {
+      failed = true;
+      break;
+    }
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+    looked_up++;
+  }
+  scan_thread.join();
+  ASSERT_EQ(false, failed.load());
+
+  // Scenario: only the scan itself misses; the hot pages are never evicted by the one-time scan pages.
+  uint64_t hot_misses = bpm->GetNumMisses() - misses_before - num_scan_pages;
+  EXPECT_EQ(0, hot_misses);
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+}  // namespace bustub
@@ -13,7 +13,11 @@
 #include "buffer/parallel_buffer_pool_manager.h"
 #include <cstdio>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
 #include "gtest/gtest.h"
 
@@ -151,4 +155,235 @@ TEST(ParallelBufferPoolManagerTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, HashRoutingTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const size_t num_instances = 5;
+  const int num_pages = 100;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, ReplacerType::LRU,
+                                            InstanceRouting::HASH);
+
+  // Scenario: page ids are handed out consecutively, and pages survive being evicted.
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i, std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: hot pages whose ids are all congruent modulo the number of instances no longer land on one instance.
+  std::vector<BufferPoolStats> before = bpm->GetInstanceStats();
+  for (int round = 0; round < 10; ++round) {
+    for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(num_instances * 4); page_id += num_instances) {
+      ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+      EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+    }
+  }
+  std::vector<BufferPoolStats> after = bpm->GetInstanceStats();
+  ASSERT_EQ(num_instances, after.size());
+  std::set<size_t> busy_instances;
+  uint64_t num_hits = 0;
+  for (size_t i = 0; i < num_instances; ++i) {
+    if (after[i].num_hits_ + after[i].num_misses_ > before[i].num_hits_ + before[i].num_misses_) {
+      busy_instances.insert(i);
+    }
+    num_hits += after[i].num_hits_;
+  }
+  EXPECT_GT(busy_instances.size(), 1);
+  EXPECT_EQ(bpm->GetNumHits(), num_hits);
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, BatchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 4;
+  const size_t num_instances = 3;
+  const int num_pages = 36;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: a batch spanning every instance is split up and returned in the requested order.
+  std::vector<page_id_t> page_ids{7, 0, 1, 2, 35, 3};
+  std::vector<Page *> pages = bpm->FetchPages(page_ids);
+  ASSERT_EQ(page_ids.size(), pages.size());
+  std::vector<std::pair<page_id_t, bool>> unpins;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(page_ids[i], std::stoi(pages[i]->GetData()));
+    unpins.emplace_back(page_ids[i], false);
+  }
+  EXPECT_EQ(true, bpm->UnpinPages(unpins));
+  EXPECT_EQ(false, bpm->UnpinPages(unpins));
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, ResizeTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 2;
+  const size_t num_instances = 3;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr,
+                                            ReplacerType::LRU, InstanceRouting::MODULO, 2 * buffer_pool_size);
+
+  // Scenario: every instance grows, so twice as many pages can be pinned.
+  EXPECT_EQ(false, bpm->Resize(2 * buffer_pool_size + 1));
+  EXPECT_EQ(true, bpm->Resize(2 * buffer_pool_size));
+  EXPECT_EQ(2 * buffer_pool_size * num_instances, bpm->GetPoolSize());
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < 2 * buffer_pool_size * num_instances; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  for (size_t i = 0; i < 2 * buffer_pool_size * num_instances; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // Scenario: every instance shrinks back without losing a page.
+  EXPECT_EQ(true, bpm->Resize(buffer_pool_size));
+  EXPECT_EQ(buffer_pool_size * num_instances, bpm->GetPoolSize());
+  for (size_t i = 0; i < 2 * buffer_pool_size * num_instances; ++i) {
+    auto *page = bpm->FetchPage(i);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(static_cast<int>(i), std::stoi(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: an out-of-range size is rejected.
+  EXPECT_EQ(false, bpm->Resize(0));
+  EXPECT_EQ(buffer_pool_size * num_instances, bpm->GetPoolSize());
+
+  // Scenario: the last instance can't shrink while all of its pages stay pinned. The instances already shrunk are
+  // grown back, so every page can still be pinned at once.
+  EXPECT_EQ(true, bpm->Resize(2 * buffer_pool_size));
+  const size_t num_pages = 2 * buffer_pool_size * num_instances;
+  for (size_t i = 0; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+  }
+  for (size_t i = 0; i < num_pages; ++i) {
+    if (i % num_instances != num_instances - 1) {
+      EXPECT_EQ(true, bpm->UnpinPage(i, false));
+    }
+  }
+  auto old_resize_timeout = resize_timeout;
+  resize_timeout = std::chrono::milliseconds(10);
+  EXPECT_EQ(false, bpm->Resize(buffer_pool_size));
+  resize_timeout = old_resize_timeout;
+  EXPECT_EQ(num_pages, bpm->GetPoolSize());
+  for (size_t i = num_instances - 1; i < num_pages; i += num_instances) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+  for (size_t i = 0; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i));
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  for (size_t i = 0; i < num_pages; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, false));
+  }
+
+  // Scenario: concurrent resizes are serialized, every instance ends up with the size of the last one.
+  std::thread grow([bpm] { EXPECT_EQ(true, bpm->Resize(2 * buffer_pool_size)); });
+  std::thread shrink([bpm] { EXPECT_EQ(true, bpm->Resize(buffer_pool_size)); });
+  grow.join();
+  shrink.join();
+  size_t pool_size = bpm->GetPoolSize() / num_instances;
+  EXPECT_TRUE(pool_size == buffer_pool_size || pool_size == 2 * buffer_pool_size);
+  std::vector<page_id_t> page_ids(pool_size * num_instances);
+  for (auto &page_id : page_ids) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+  for (auto page_id : page_ids) {
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(ParallelBufferPoolManagerTest, FlushAllTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 80;
+  const size_t num_instances = 2;
+
+  auto *disk_manager = new DiskManager(db_name, DiskIOBackend::PREAD);
+  auto *bpm = new ParallelBufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: every dirty page is written, with one sync per batch of each instance.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size * num_instances; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id_temp);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  bpm->FlushAllPages();
+  EXPECT_EQ(buffer_pool_size * num_instances, disk_manager->GetNumWrites());
+  size_t batches_per_instance = (buffer_pool_size + WRITE_BATCH_SIZE - 1) / WRITE_BATCH_SIZE;
+  EXPECT_EQ(batches_per_instance * num_instances, disk_manager->GetNumSyncs());
+  char buf[PAGE_SIZE];
+  for (size_t i = 0; i < buffer_pool_size * num_instances; ++i) {
+    disk_manager->ReadPage(i, buf);
+    EXPECT_EQ(static_cast<int>(i), std::stoi(buf));
+  }
+
+  // Scenario: the pool is still usable and the flushed pages are clean, so evicting them writes nothing, and neither
+  // does flushing the clean pages that replaced them.
+  int num_writes = disk_manager->GetNumWrites();
+  for (size_t i = 0; i < buffer_pool_size * num_instances; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id_temp));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+  }
+  bpm->FlushAllPages();
+  EXPECT_EQ(num_writes, disk_manager->GetNumWrites());
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
@@ -114,4 +114,60 @@ TEST(HashTablePageTest, BucketPageSampleTest) {
   delete bpm;
 }
 
+// NOLINTNEXTLINE
+TEST(HashTablePageTest, BucketPageFullTest) {
+  DiskManager *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(5, disk_manager);
+
+  page_id_t bucket_page_id = INVALID_PAGE_ID;
+  auto bucket_page = reinterpret_cast<HashTableBucketPage<int, int, IntComparator> *>(
+      bpm->NewPage(&bucket_page_id, nullptr)->GetData());
+
+  // fill the bucket with 100 keys that have many values each, so that every 64-slot word holds matches
+  const int num_keys = 100;
+  int num_slots = 0;
+  while (bucket_page->Insert(num_slots % num_keys, num_slots, IntComparator())) {
+    num_slots++;
+  }
+  EXPECT_TRUE(bucket_page->IsFull());
+  EXPECT_EQ(num_slots, bucket_page->NumReadable());
+  EXPECT_FALSE(bucket_page->Insert(num_keys, num_slots, IntComparator()));
+
+  for (int key = 0; key < num_keys; key++) {
+    std::vector<int> values;
+    EXPECT_TRUE(bucket_page->GetValue(key, IntComparator(), &values));
+    EXPECT_EQ((num_slots - key + num_keys - 1) / num_keys, values.size());
+    for (int value : values) {
+      EXPECT_EQ(key, value % num_keys);
+    }
+  }
+  std::vector<int> values;
+  EXPECT_FALSE(bucket_page->GetValue(num_keys, IntComparator(), &values));
+
+  // duplicate pairs are rejected, removed slots are reused first to last
+  EXPECT_TRUE(bucket_page->Remove(7, num_slots - 1 - (num_slots - 1 - 7) % num_keys, IntComparator()));
+  EXPECT_TRUE(bucket_page->Remove(3, 3, IntComparator()));
+  EXPECT_FALSE(bucket_page->Remove(3, 3, IntComparator()));
+  EXPECT_FALSE(bucket_page->IsFull());
+  EXPECT_FALSE(bucket_page->Insert(4, 4, IntComparator()));
+  EXPECT_TRUE(bucket_page->Insert(num_keys, 0, IntComparator()));
+  EXPECT_EQ(num_keys, bucket_page->KeyAt(3));
+  EXPECT_TRUE(bucket_page->Insert(num_keys + 1, 0, IntComparator()));
+  EXPECT_TRUE(bucket_page->IsFull());
+
+  // remove everything
+  for (int slot = 0; slot < num_slots; slot++) {
+    bucket_page->RemoveAt(slot);
+  }
+  EXPECT_TRUE(bucket_page->IsEmpty());
+  EXPECT_EQ(0, bucket_page->NumReadable());
+  EXPECT_FALSE(bucket_page->GetValue(num_keys, IntComparator(), &values));
+
+  bpm->UnpinPage(bucket_page_id, true, nullptr);
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
 }  // namespace bustub
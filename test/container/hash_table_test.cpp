@@ -10,6 +10,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <thread>  // NOLINT
 #include <vector>
 
@@ -18,6 +20,7 @@
 #include "container/hash/extendible_hash_table.h"
 #include "gtest/gtest.h"
 #include "murmur3/MurmurHash3.h"
+#include "test_util.h"  // NOLINT
 
 namespace bustub {
 
@@ -117,4 +120,318 @@ TEST(HashTableTest, SampleTest) {
   delete bpm;
 }
 
+// NOLINTNEXTLINE
+TEST(HashTableTest, DeferredDeleteTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_keys = 2000;
+  for (int i = 0; i < num_keys; i++) {
+    EXPECT_TRUE(ht.Insert(nullptr, i, i));
+  }
+  ASSERT_GT(ht.GetGlobalDepth(), 0);
+
+  // Scenario: merges can't delete the emptied buckets while a reader still has them pinned, nor leak them.
+  auto num_pages = disk_manager->GetNumAllocatedPages();
+  for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+  }
+  for (int i = 0; i < num_keys; i++) {
+    EXPECT_TRUE(ht.Remove(nullptr, i, i));
+  }
+  EXPECT_EQ(0, disk_manager->GetNumFreePages());
+  for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+
+  // Scenario: the next merge deletes them once they are unpinned.
+  EXPECT_TRUE(ht.Insert(nullptr, 0, 0));
+  EXPECT_TRUE(ht.Remove(nullptr, 0, 0));
+  EXPECT_GT(disk_manager->GetNumFreePages(), 0);
+  ht.VerifyIntegrity();
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, OptimisticReadTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_stable_keys = 100;
+  const int num_churn_keys = 2000;
+  const int num_readers = 4;
+
+  for (int i = 0; i < num_stable_keys; i++) {
+    EXPECT_TRUE(ht.Insert(nullptr, i, i));
+  }
+
+  // Scenario: a writer keeps splitting and merging buckets while readers look up keys that never change. Lookups
+  // that race with a split or a merge must retry instead of returning a torn result.
+  std::atomic<bool> done = false;
+  std::thread writer([&ht, &done] {
+    for (int round = 0; round < 3; round++) {
+      for (int i = num_stable_keys; i < num_stable_keys + num_churn_keys; i++) {
+        EXPECT_TRUE(ht.Insert(nullptr, i, i));
+      }
+      for (int i = num_stable_keys; i < num_stable_keys + num_churn_keys; i++) {
+        EXPECT_TRUE(ht.Remove(nullptr, i, i));
+      }
+    }
+    done = true;
+  });
+  std::vector<std::thread> readers;
+  for (int t = 0; t < num_readers; t++) {
+    readers.emplace_back([&ht, &done] {
+      while (!done) {
+        for (int i = 0; i < num_stable_keys; i++) {
+          std::vector<int> res;
+          EXPECT_TRUE(ht.GetValue(nullptr, i, &res));
+          ASSERT_EQ(1, res.size());
+          EXPECT_EQ(i, res[0]);
+        }
+      }
+    });
+  }
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  ht.VerifyIntegrity();
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, ConcurrentInsertRemoveTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_threads = 8;
+  const int num_keys = 3000;
+
+  // Scenario: threads insert disjoint keys, splitting buckets under each other, then remove every other key of theirs,
+  // merging buckets under each other. No insert or remove may be lost.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&ht, t] {
+      for (int i = 0; i < num_keys; i++) {
+        EXPECT_TRUE(ht.Insert(nullptr, t * num_keys + i, i));
+      }
+      for (int i = 0; i < num_keys; i += 2) {
+        EXPECT_TRUE(ht.Remove(nullptr, t * num_keys + i, i));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int key = 0; key < num_threads * num_keys; key++) {
+    std::vector<int> res;
+    int i = key % num_keys;
+    if (i % 2 == 0) {
+      EXPECT_FALSE(ht.GetValue(nullptr, key, &res));
+    } else {
+      ASSERT_TRUE(ht.GetValue(nullptr, key, &res));
+      ASSERT_EQ(1, res.size());
+      EXPECT_EQ(i, res[0]);
+    }
+  }
+  ht.VerifyIntegrity();
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, MultiPageDirectoryTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  auto key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<64> comparator(key_schema.get());
+  ExtendibleHashTable<GenericKey<64>, RID, GenericComparator<64>> ht("blah", bpm, comparator,
+                                                                     HashFunction<GenericKey<64>>());
+
+  // Scenario: insert enough wide keys that the directory outgrows a single directory page, then remove them all.
+  const int64_t num_keys = 50000;
+  GenericKey<64> index_key;
+  for (int64_t key = 0; key < num_keys; key++) {
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(ht.Insert(nullptr, index_key, RID(key)));
+  }
+  EXPECT_GT(ht.GetGlobalDepth(), MAX_BUCKET_DEPTH);
+  ht.VerifyIntegrity();
+
+  for (int64_t key = 0; key < num_keys; key++) {
+    std::vector<RID> res;
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(ht.GetValue(nullptr, index_key, &res));
+    ASSERT_EQ(1, res.size());
+    EXPECT_EQ(RID(key), res[0]);
+  }
+
+  for (int64_t key = 0; key < num_keys; key++) {
+    index_key.SetFromInteger(key);
+    ASSERT_TRUE(ht.Remove(nullptr, index_key, RID(key)));
+  }
+  ht.VerifyIntegrity();
+  for (int64_t key = 0; key < num_keys; key++) {
+    std::vector<RID> res;
+    index_key.SetFromInteger(key);
+    EXPECT_FALSE(ht.GetValue(nullptr, index_key, &res));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, BatchTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>());
+  const int num_threads = 4;
+  const int num_keys = 5000;
+
+  // Scenario: threads insert disjoint batches at once, splitting buckets under each other. Every batch also holds a
+  // duplicate of one of its pairs, which must not be inserted twice.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&ht, t] {
+      std::vector<std::pair<int, int>> entries;
+      for (int i = 0; i < num_keys; i++) {
+        entries.emplace_back(t * num_keys + i, i);
+      }
+      entries.emplace_back(t * num_keys, 0);
+      EXPECT_EQ(static_cast<size_t>(num_keys), ht.InsertBatch(nullptr, entries));
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ht.VerifyIntegrity();
+
+  // look up every key, a second value for some of them and keys that are not in the table
+  for (int key = 0; key < num_threads * num_keys; key += 3) {
+    EXPECT_TRUE(ht.Insert(nullptr, key, -1));
+  }
+  std::vector<int> keys;
+  for (int key = 0; key < num_threads * num_keys + 100; key++) {
+    keys.push_back(key);
+  }
+  std::vector<std::vector<int>> results;
+  EXPECT_EQ(num_threads * num_keys, ht.GetValues(nullptr, keys, &results));
+  ASSERT_EQ(keys.size(), results.size());
+  for (int key = 0; key < num_threads * num_keys + 100; key++) {
+    std::vector<int> res;
+    EXPECT_EQ(key < num_threads * num_keys, ht.GetValue(nullptr, key, &res));
+    std::sort(res.begin(), res.end());
+    std::sort(results[key].begin(), results[key].end());
+    EXPECT_EQ(res, results[key]);
+    EXPECT_EQ(key >= num_threads * num_keys ? 0 : key % 3 == 0 ? 2 : 1, results[key].size());
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, BulkLoadTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+  const int num_keys = 20000;
+
+  // Scenario: bulk load keys with one value each, a second value for every tenth key and a duplicate pair, then
+  // keep using the table as usual.
+  std::vector<std::pair<int, int>> entries;
+  for (int i = 0; i < num_keys; i++) {
+    entries.emplace_back(i, i);
+    if (i % 10 == 0) {
+      entries.emplace_back(i, -i - 1);
+    }
+  }
+  entries.emplace_back(1, 1);
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>(), entries);
+  ht.VerifyIntegrity();
+  EXPECT_GT(ht.GetGlobalDepth(), 0);
+
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<int> res;
+    ASSERT_TRUE(ht.GetValue(nullptr, i, &res));
+    ASSERT_EQ(i % 10 == 0 ? 2 : 1, res.size());
+    std::sort(res.begin(), res.end());
+    EXPECT_EQ(i, res.back());
+  }
+  EXPECT_FALSE(ht.Insert(nullptr, 1, 1));
+
+  for (int i = num_keys; i < 2 * num_keys; i++) {
+    EXPECT_TRUE(ht.Insert(nullptr, i, i));
+  }
+  for (int i = 0; i < 2 * num_keys; i += 2) {
+    EXPECT_TRUE(ht.Remove(nullptr, i, i));
+  }
+  ht.VerifyIntegrity();
+  for (int i = 1; i < 2 * num_keys; i += 2) {
+    std::vector<int> res;
+    ASSERT_TRUE(ht.GetValue(nullptr, i, &res));
+    EXPECT_EQ(i, res[0]);
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, BulkLoadOverflowTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManagerInstance(50, disk_manager);
+
+  // Scenario: one key has more values than a bucket holds. Splitting can't separate them, so the bucket stops short of
+  // MAX_GLOBAL_DEPTH, keeps as many values as fit and the rest are dropped. The other keys are all loaded.
+  const int num_values = 1000;
+  const int num_keys = 1000;
+  std::vector<std::pair<int, int>> entries;
+  for (int i = 0; i < num_values; i++) {
+    entries.emplace_back(0, i);
+  }
+  for (int i = 1; i <= num_keys; i++) {
+    entries.emplace_back(i, i);
+  }
+  ExtendibleHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), HashFunction<int>(), entries);
+  ht.VerifyIntegrity();
+  EXPECT_LT(ht.GetGlobalDepth(), MAX_GLOBAL_DEPTH);
+
+  std::vector<int> res;
+  ASSERT_TRUE(ht.GetValue(nullptr, 0, &res));
+  EXPECT_GT(res.size(), 0);
+  EXPECT_LT(res.size(), num_values);
+  for (int i = 1; i <= num_keys; i++) {
+    res.clear();
+    ASSERT_TRUE(ht.GetValue(nullptr, i, &res));
+    EXPECT_EQ(i, res[0]);
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  delete disk_manager;
+  delete bpm;
+}
+
 }  // namespace bustub
@@ -10,9 +10,23 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "common/exception.h"
+#include "common/util/crc32c.h"
+#include "common/util/lz_compressor.h"
 #include "gtest/gtest.h"
 #include "storage/disk/disk_manager.h"
 
@@ -24,12 +38,18 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
+    remove("test.crc");
+    remove("test.ext");
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    remove("test.fsm");
+    remove("test.crc");
+    remove("test.ext");
   };
 };
 
@@ -75,4 +95,369 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, FileDescriptorBackendTest) {
+  const int num_threads = 4;
+  const int pages_per_thread = 16;
+  std::string db_file("test.db");
+  for (DiskIOBackend backend : {DiskIOBackend::PREAD, DiskIOBackend::DIRECT}) {
+    remove("test.db");
+    DiskManager dm(db_file, backend);
+    EXPECT_NE(DiskIOBackend::STREAM, dm.GetBackend());
+
+    // Scenario: unaligned buffers work as well, and reading past the end of the file gives zeroes.
+    char buf[PAGE_SIZE + 1];
+    char data[PAGE_SIZE + 1] = {0};
+    std::strncpy(data + 1, "A test string.", PAGE_SIZE);
+    std::memset(buf, 1, sizeof(buf));
+    dm.ReadPage(0, buf + 1);
+    EXPECT_EQ(0, buf[1]);
+    EXPECT_EQ(0, buf[PAGE_SIZE]);
+    dm.WritePage(0, data + 1);
+    dm.ReadPage(0, buf + 1);
+    EXPECT_EQ(0, std::memcmp(buf + 1, data + 1, PAGE_SIZE));
+
+    // Scenario: threads write different pages concurrently without a global latch.
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.emplace_back([&dm, tid] {
+        auto *page = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, PAGE_SIZE));
+        for (int i = 0; i < pages_per_thread; i++) {
+          page_id_t page_id = 1 + tid * pages_per_thread + i;
+          std::memset(page, page_id, PAGE_SIZE);
+          dm.WritePage(page_id, page);
+        }
+        std::free(page);  // NOLINT
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(1 + num_threads * pages_per_thread, dm.GetNumWrites());
+
+    // Scenario: a run read at once gets every page, and the pages past the end of the file are zeroed.
+    const int num_pages = num_threads * pages_per_thread + 2;
+    auto *pages = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, num_pages * PAGE_SIZE));
+    std::vector<char *> pages_data;
+    for (int i = 0; i < num_pages; i++) {
+      pages_data.push_back(pages + i * PAGE_SIZE);
+    }
+    dm.ReadPages(1, pages_data);
+    for (int i = 0; i < num_pages; i++) {
+      char expected = i < num_threads * pages_per_thread ? static_cast<char>(1 + i) : 0;
+      EXPECT_EQ(expected, pages_data[i][0]);
+      EXPECT_EQ(expected, pages_data[i][PAGE_SIZE - 1]);
+    }
+    std::free(pages);  // NOLINT
+
+    dm.ShutDown();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, AsyncTest) {
+  const int num_pages = 32;
+  std::string db_file("test.db");
+  DiskManager dm(db_file, DiskIOBackend::PREAD, 2);
+  EXPECT_EQ(2, dm.GetIOQueueDepth());
+  EXPECT_EQ(0, dm.GetNumInflightIO());
+
+  // Scenario: asynchronous writes complete in any order, each one calling back before its future becomes ready.
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::atomic<int> num_callbacks = 0;
+  std::vector<std::future<void>> writes;
+  for (int i = 0; i < num_pages; i++) {
+    std::memset(pages[i].data(), i + 1, PAGE_SIZE);
+    writes.push_back(dm.WritePageAsync(i, pages[i].data(), [&num_callbacks] { num_callbacks++; }));
+  }
+  for (auto &write : writes) {
+    write.wait();
+  }
+  EXPECT_EQ(num_pages, num_callbacks);
+  EXPECT_EQ(num_pages, dm.GetNumWrites());
+  EXPECT_EQ(0, dm.GetNumInflightIO());
+
+  // Scenario: asynchronous reads of single pages and of runs see the written data.
+  char buf[PAGE_SIZE];
+  dm.ReadPageAsync(3, buf).wait();
+  EXPECT_EQ(4, buf[PAGE_SIZE - 1]);
+  std::vector<std::vector<char>> run(4, std::vector<char>(PAGE_SIZE));
+  dm.ReadPagesAsync(10, {run[0].data(), run[1].data(), run[2].data(), run[3].data()}).wait();
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(11 + i, run[i][0]);
+  }
+  EXPECT_EQ(num_pages + 2, dm.GetNumAsyncIO());
+
+  // Scenario: requests submitted after shutdown complete on the calling thread.
+  dm.ShutDown();
+  EXPECT_EQ(std::future_status::ready, dm.ReadPageAsync(0, buf).wait_for(std::chrono::seconds(0)));
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, WritePagesTest) {
+  const int num_pages = 8;
+  std::string db_file("test.db");
+  for (DiskIOBackend backend : {DiskIOBackend::STREAM, DiskIOBackend::PREAD, DiskIOBackend::DIRECT}) {
+    remove("test.db");
+    DiskManager dm(db_file, backend);
+
+    // Scenario: a batch out of order with a gap lands every page at its own offset.
+    auto *data = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, num_pages * PAGE_SIZE));
+    std::vector<std::pair<page_id_t, const char *>> pages;
+    for (int i = num_pages - 1; i >= 0; i--) {
+      page_id_t page_id = i < num_pages / 2 ? i : i + 2;
+      std::memset(data + i * PAGE_SIZE, page_id + 1, PAGE_SIZE);
+      pages.emplace_back(page_id, data + i * PAGE_SIZE);
+    }
+    dm.WritePages(pages);
+    EXPECT_EQ(num_pages, dm.GetNumWrites());
+    EXPECT_EQ(backend == DiskIOBackend::STREAM ? 0 : 1, dm.GetNumSyncs());
+    char buf[PAGE_SIZE];
+    for (const auto &[page_id, page_data] : pages) {
+      dm.ReadPage(page_id, buf);
+      EXPECT_EQ(page_id + 1, buf[0]);
+      EXPECT_EQ(page_id + 1, buf[PAGE_SIZE - 1]);
+    }
+    dm.ReadPage(num_pages / 2, buf);
+    EXPECT_EQ(0, buf[0]);
+    std::free(data);  // NOLINT
+
+    dm.ShutDown();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, FreeSpaceMapTest) {
+  const int num_pages = 10;
+  char data[PAGE_SIZE];
+  std::string db_file("test.db");
+  auto dm = std::make_unique<DiskManager>(db_file);
+  for (int i = 0; i < num_pages; i++) {
+    std::memset(data, i + 1, PAGE_SIZE);
+    dm->WritePage(i, data);
+  }
+
+  // Scenario: freed pages are reused smallest first, only by the instance they belong to.
+  EXPECT_EQ(INVALID_PAGE_ID, dm->AllocateFreePage());
+  dm->DeallocatePage(5);
+  dm->DeallocatePage(3);
+  dm->DeallocatePage(8);
+  dm->DeallocatePage(8);
+  EXPECT_EQ(3, dm->GetNumFreePages());
+  EXPECT_EQ(8, dm->AllocateFreePage(2, 0));
+  EXPECT_EQ(INVALID_PAGE_ID, dm->AllocateFreePage(2, 0));
+  EXPECT_EQ(3, dm->AllocateFreePage());
+  EXPECT_EQ(1, dm->GetNumFreePages());
+
+  // Scenario: page ids that were never allocated are not taken into the free space map.
+  EXPECT_EQ(num_pages, dm->GetNumAllocatedPages());
+  EXPECT_FALSE(dm->DeallocatePage(num_pages));
+  EXPECT_FALSE(dm->DeallocatePage(INVALID_PAGE_ID));
+  EXPECT_EQ(1, dm->GetNumFreePages());
+
+  // Scenario: the free space map survives a restart, and allocation continues past the pages of the file.
+  EXPECT_TRUE(dm->DeallocatePage(9));
+  dm->ShutDown();
+  dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::PREAD);
+  EXPECT_EQ(2, dm->GetNumFreePages());
+  EXPECT_EQ(num_pages, dm->GetNumAllocatedPages());
+
+  // Scenario: compaction truncates the free tail and punches the free pages in the middle, which then read as zeroes.
+  dm->DeallocatePage(7);
+  dm->DeallocatePage(1);
+  EXPECT_GE(dm->CompactFreePages(), 1);
+  struct stat stat_buf;
+  ASSERT_EQ(0, stat(db_file.c_str(), &stat_buf));
+  EXPECT_EQ(9 * PAGE_SIZE, stat_buf.st_size);
+  dm->ReadPage(5, data);
+  EXPECT_EQ(0, data[0]);
+  dm->ReadPage(6, data);
+  EXPECT_EQ(7, data[0]);
+  EXPECT_EQ(4, dm->GetNumFreePages());
+  dm->ShutDown();
+
+  // Scenario: a new database file does not pick up the free space map of an old one.
+  remove("test.db");
+  dm = std::make_unique<DiskManager>(db_file);
+  EXPECT_EQ(0, dm->GetNumFreePages());
+  dm->ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, ChecksumTest) {
+  // The check value of CRC-32C, whichever implementation is in use.
+  EXPECT_EQ(0xE3069283, Crc32c::Compute("123456789", 9));
+  EXPECT_EQ(Crc32c::Compute("123456789", 9), Crc32c::Extend(Crc32c::Compute("1234", 4), "56789", 5));
+
+  const int num_pages = 4;
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  std::string db_file("test.db");
+  auto dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::PREAD, DISK_IO_QUEUE_DEPTH, ChecksumPolicy::DETECT);
+  std::vector<std::pair<page_id_t, const char *>> pages;
+  std::vector<std::unique_ptr<char[]>> pages_data;
+  for (int i = 0; i < num_pages; i++) {
+    pages_data.emplace_back(new char[PAGE_SIZE]);
+    std::memset(pages_data.back().get(), i + 1, PAGE_SIZE);
+    pages.emplace_back(i, pages_data.back().get());
+  }
+  dm->WritePages(pages);
+
+  // Scenario: intact pages and pages never written verify.
+  dm->ReadPage(2, buf);
+  EXPECT_EQ(3, buf[0]);
+  dm->ReadPage(num_pages + 1, buf);
+  EXPECT_EQ(0U, dm->GetNumChecksumFailures());
+
+  // Scenario: a page changed behind the disk manager's back is detected, and the read still returns it.
+  int fd = open(db_file.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(1, pwrite(fd, "x", 1, PAGE_SIZE + 100));
+  close(fd);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ('x', buf[100]);
+  EXPECT_EQ(1U, dm->GetNumChecksumFailures());
+  std::vector<char *> read_data{buf, data};
+  dm->ReadPages(0, read_data);
+  EXPECT_EQ(2U, dm->GetNumChecksumFailures());
+
+  // Scenario: checksums survive a restart, and with ENFORCE a mismatch fails the read.
+  dm->ShutDown();
+  dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::STREAM, DISK_IO_QUEUE_DEPTH, ChecksumPolicy::ENFORCE);
+  EXPECT_THROW(dm->ReadPage(1, buf), Exception);
+  EXPECT_THROW(dm->ReadPageAsync(1, buf).get(), Exception);
+  dm->ReadPage(3, buf);
+  EXPECT_EQ(4, buf[0]);
+
+  // Scenario: rewriting or deallocating the page clears the mismatch.
+  std::memset(data, 9, PAGE_SIZE);
+  dm->WritePage(1, data);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ(0, std::memcmp(buf, data, PAGE_SIZE));
+  fd = open(db_file.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(1, pwrite(fd, "x", 1, 100));
+  close(fd);
+  dm->DeallocatePage(0);
+  dm->ReadPage(0, buf);
+  EXPECT_EQ(2U, dm->GetNumChecksumFailures());
+  dm->ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, CompressionTest) {
+  std::mt19937 rng(15445);
+  char compressible[PAGE_SIZE];
+  char incompressible[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  // Small integers with long runs, like the tuples of a table page.
+  for (int i = 0; i < PAGE_SIZE / 4; i++) {
+    auto value = static_cast<int32_t>(i / 16);
+    std::memcpy(compressible + i * 4, &value, 4);
+  }
+  for (char &c : incompressible) {
+    c = static_cast<char>(rng());
+  }
+
+  // Scenario: the compressor round trips and rejects malformed input.
+  char compressed[PAGE_SIZE];
+  size_t length = LzCompressor::Compress(compressible, PAGE_SIZE, compressed, PAGE_SIZE);
+  ASSERT_GT(length, 0U);
+  EXPECT_LT(length, PAGE_SIZE / 4U);
+  ASSERT_TRUE(LzCompressor::Decompress(compressed, length, buf, PAGE_SIZE));
+  EXPECT_EQ(0, std::memcmp(buf, compressible, PAGE_SIZE));
+  EXPECT_FALSE(LzCompressor::Decompress(compressed, length / 2, buf, PAGE_SIZE));
+  EXPECT_FALSE(LzCompressor::Decompress(compressed, length, buf, PAGE_SIZE - 1));
+  EXPECT_EQ(0U, LzCompressor::Compress(incompressible, PAGE_SIZE, compressed, PAGE_SIZE - 1));
+
+  // Scenario: compressible pages take up less space, and all pages read back as written.
+  const int num_pages = 8;
+  std::string db_file("test.db");
+  auto dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::STREAM, DISK_IO_QUEUE_DEPTH,
+                                          ChecksumPolicy::ENFORCE, true);
+  EXPECT_EQ(DiskIOBackend::PREAD, dm->GetBackend());
+  for (int i = 0; i < num_pages; i++) {
+    compressible[0] = static_cast<char>(i);
+    dm->WritePage(i, i == 3 ? incompressible : compressible);
+  }
+  EXPECT_LT(dm->GetStoredBytes(), 2U * PAGE_SIZE);
+  struct stat stat_buf;
+  ASSERT_EQ(0, stat(db_file.c_str(), &stat_buf));
+  EXPECT_LT(stat_buf.st_size, 2 * PAGE_SIZE);
+  dm->ReadPage(3, buf);
+  EXPECT_EQ(0, std::memcmp(buf, incompressible, PAGE_SIZE));
+  std::vector<char *> read_data{buf};
+  dm->ReadPages(5, read_data);
+  compressible[0] = 5;
+  EXPECT_EQ(0, std::memcmp(buf, compressible, PAGE_SIZE));
+  dm->ReadPage(num_pages, buf);
+  EXPECT_EQ(0, buf[0]);
+
+  // Scenario: a page that stops compressing moves, and the ones around it are untouched.
+  dm->WritePage(1, incompressible);
+  dm->WritePage(3, compressible);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ(0, std::memcmp(buf, incompressible, PAGE_SIZE));
+  dm->ReadPage(2, buf);
+  compressible[0] = 2;
+  EXPECT_EQ(0, std::memcmp(buf, compressible, PAGE_SIZE));
+
+  // Scenario: the extent map survives a restart, and deallocated pages are compacted away.
+  dm->ShutDown();
+  dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::PREAD, DISK_IO_QUEUE_DEPTH, ChecksumPolicy::ENFORCE,
+                                     true);
+  dm->ReadPage(1, buf);
+  EXPECT_EQ(0, std::memcmp(buf, incompressible, PAGE_SIZE));
+  dm->ReadPage(3, buf);
+  compressible[0] = 5;
+  EXPECT_EQ(0, std::memcmp(buf, compressible, PAGE_SIZE));
+  dm->DeallocatePage(1);
+  EXPECT_GE(dm->CompactFreePages(), 1U);
+  ASSERT_EQ(0, stat(db_file.c_str(), &stat_buf));
+  EXPECT_LT(stat_buf.st_size, 2 * PAGE_SIZE);
+  dm->ReadPage(7, buf);
+  compressible[0] = 7;
+  EXPECT_EQ(0, std::memcmp(buf, compressible, PAGE_SIZE));
+  EXPECT_EQ(0U, dm->GetNumChecksumFailures());
+  dm->ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MmapTest) {
+  const int num_pages = 4;
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  std::string db_file("test.db");
+  EXPECT_THROW(DiskManager(db_file, DiskIOBackend::MMAP), Exception);
+  auto dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::PREAD);
+  for (int i = 0; i < num_pages; i++) {
+    std::memset(data, i + 1, PAGE_SIZE);
+    dm->WritePage(i, data);
+  }
+  dm->ShutDown();
+
+  // Scenario: pages are read and borrowed straight from the mapping, pages past the end read as zeroes.
+  dm = std::make_unique<DiskManager>(db_file, DiskIOBackend::MMAP);
+  EXPECT_EQ(DiskIOBackend::MMAP, dm->GetBackend());
+  dm->ReadPage(2, buf);
+  EXPECT_EQ(3, buf[0]);
+  const char *borrowed = dm->BorrowPage(3);
+  ASSERT_NE(nullptr, borrowed);
+  EXPECT_EQ(4, borrowed[PAGE_SIZE - 1]);
+  EXPECT_EQ(nullptr, dm->BorrowPage(num_pages));
+  std::vector<char *> read_data{buf, data};
+  dm->ReadPages(num_pages - 1, read_data);
+  EXPECT_EQ(num_pages, buf[0]);
+  EXPECT_EQ(0, data[0]);
+  dm->ReadPageAsync(1, buf).get();
+  EXPECT_EQ(2, buf[0]);
+
+  // Scenario: the file is read-only.
+  EXPECT_THROW(dm->WritePage(0, buf), Exception);
+  EXPECT_THROW(dm->WritePageAsync(0, buf).get(), Exception);
+  EXPECT_EQ(0U, dm->CompactFreePages());
+  dm->ShutDown();
+  EXPECT_EQ(nullptr, dm->BorrowPage(0));
+}
+
 }  // namespace bustub
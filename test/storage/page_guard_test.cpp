@@ -0,0 +1,99 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_guard_test.cpp
+//
+// Identification: test/storage/page_guard_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "gtest/gtest.h"
+#include "storage/page/page_guard.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(PageGuardTest, SampleTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 5;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  auto *page0 = bpm->NewPage(&page_id_temp);
+  EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, false));
+
+  // Scenario: a basic guard holds exactly one pin and releases it when it goes out of scope.
+  {
+    BasicPageGuard guard = bpm->FetchPageBasic(0);
+    EXPECT_EQ(true, guard.IsValid());
+    EXPECT_EQ(0, guard.PageId());
+    EXPECT_EQ(page0->GetData(), guard.GetData());
+    EXPECT_EQ(1, page0->GetPinCount());
+  }
+  EXPECT_EQ(0, page0->GetPinCount());
+  EXPECT_EQ(false, page0->IsDirty());
+
+  // Scenario: moving a guard transfers the pin instead of duplicating it, and overwriting a guard releases its page.
+  {
+    BasicPageGuard guard = bpm->FetchPageBasic(0);
+    BasicPageGuard moved(std::move(guard));
+    EXPECT_EQ(false, guard.IsValid());  // NOLINT
+    EXPECT_EQ(1, page0->GetPinCount());
+    moved = BasicPageGuard();
+    EXPECT_EQ(0, page0->GetPinCount());
+  }
+  EXPECT_EQ(0, page0->GetPinCount());
+
+  // Scenario: a write guard latches the page and marks it dirty once it is accessed for writing.
+  {
+    WritePageGuard guard = bpm->FetchPageWrite(0);
+    snprintf(guard.GetDataMut(), PAGE_SIZE, "Hello");
+  }
+  EXPECT_EQ(0, page0->GetPinCount());
+  EXPECT_EQ(true, page0->IsDirty());
+
+  // Scenario: read guards share the latch, and a write guard is only handed out after both are dropped.
+  {
+    ReadPageGuard guard1 = bpm->FetchPageRead(0);
+    ReadPageGuard guard2 = bpm->FetchPageRead(0);
+    EXPECT_EQ(2, page0->GetPinCount());
+    EXPECT_EQ(0, strcmp(guard2.GetData(), "Hello"));
+    guard1.Drop();
+    guard2.Drop();
+    WritePageGuard write_guard = bpm->FetchPageBasic(0).UpgradeWrite();
+    EXPECT_EQ(1, page0->GetPinCount());
+  }
+  EXPECT_EQ(0, page0->GetPinCount());
+
+  // Scenario: a new page comes with its pin already guarded, and no frame means an invalid guard.
+  page_id_t page_ids[buffer_pool_size];
+  BasicPageGuard guards[buffer_pool_size];
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    guards[i] = bpm->NewPageGuarded(&page_ids[i]);
+    EXPECT_EQ(true, guards[i].IsValid());
+  }
+  EXPECT_EQ(false, bpm->FetchPageRead(0).IsValid());
+  for (auto &guard : guards) {
+    guard.Drop();
+  }
+  EXPECT_EQ(true, bpm->FetchPageRead(0).IsValid());
+
+  // Shutdown the disk manager and remove the temporary file we created.
+  disk_manager->ShutDown();
+  remove("test.db");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+}  // namespace bustub